@@ -79,27 +79,130 @@ ssize_t Utils::readAll(int fd, void *buf, size_t count)
     return num_read;
 }
 
-/* This function detects if the given page is zero pages or not. There is
- * scope of improving this function using some optimizations.
- *
- * TODO: One can use /proc/self/pagemap to detect if the page is backed by a
- * shared zero page.
- */
-bool Utils::isZeroPage(void *addr)
+// Same as writeAll(), but writes at the given file offset
+ssize_t Utils::pwriteAll(int fd, const void *buf, size_t count, off_t offset)
 {
-    static const size_t page_size = 4096;
-    long long *buf = (long long *)addr;
-    size_t end = page_size / sizeof(*buf);
-    long long res = 0;
-
-    for (size_t i = 0; i + 7 < end; i += 8) {
-        res = buf[i + 0] | buf[i + 1] | buf[i + 2] | buf[i + 3] |
-        buf[i + 4] | buf[i + 5] | buf[i + 6] | buf[i + 7];
-        if (res != 0) {
+    const char *ptr = (const char *)buf;
+    size_t num_written = 0;
+
+    do {
+        ssize_t rc = pwrite(fd, ptr + num_written, count - num_written, offset + num_written);
+        if (rc == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            } else {
+                debuglogstdio(LCF_ERROR, "Pwrite at address %p failed with errno %d", ptr + num_written, errno);
+                return rc;
+            }
+        } else if (rc == 0) {
+            break;
+        } else { // else rc > 0
+            num_written += rc;
+        }
+    } while (num_written < count);
+    MYASSERT(num_written == count);
+    return num_written;
+}
+
+// Same as readAll(), but reads at the given file offset
+ssize_t Utils::preadAll(int fd, void *buf, size_t count, off_t offset)
+{
+    ssize_t rc;
+    char *ptr = (char *)buf;
+    size_t num_read = 0;
+
+    for (num_read = 0; num_read < count;) {
+        rc = pread(fd, ptr + num_read, count - num_read, offset + num_read);
+        if (rc == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            } else {
+                debuglogstdio(LCF_ERROR, "Pread at address %p failed with errno %d", ptr + num_read, errno);
+                return -1;
+            }
+        } else if (rc == 0) {
+            break;
+        } else { // else rc > 0
+            num_read += rc;
+        }
+    }
+    return num_read;
+}
+
+// Fails or does entire write of all buffers at the given file offset
+// (returns total count). The iovec array may be modified to handle partial
+// writes.
+ssize_t Utils::pwritevAll(int fd, struct iovec *iov, int iovcnt, off_t offset)
+{
+    size_t num_written = 0;
+
+    while (iovcnt > 0) {
+        ssize_t rc = pwritev(fd, iov, iovcnt, offset + num_written);
+        if (rc == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            } else {
+                debuglogstdio(LCF_ERROR, "Pwritev at address %p failed with errno %d", iov->iov_base, errno);
+                return rc;
+            }
+        } else if (rc == 0) {
+            break;
+        }
+
+        num_written += rc;
+
+        /* Skip the buffers that were entirely written, and advance inside
+         * the partially written one */
+        size_t remaining = rc;
+        while ((iovcnt > 0) && (remaining >= iov->iov_len)) {
+            remaining -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    MYASSERT(iovcnt == 0);
+    return num_written;
+}
+
+// Same as preadAll(), but reads into several buffers (returns total count).
+// The iovec array may be modified to handle partial reads.
+ssize_t Utils::preadvAll(int fd, struct iovec *iov, int iovcnt, off_t offset)
+{
+    size_t num_read = 0;
+
+    while (iovcnt > 0) {
+        ssize_t rc = preadv(fd, iov, iovcnt, offset + num_read);
+        if (rc == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            } else {
+                debuglogstdio(LCF_ERROR, "Preadv at address %p failed with errno %d", iov->iov_base, errno);
+                return rc;
+            }
+        } else if (rc == 0) {
             break;
         }
+
+        num_read += rc;
+
+        /* Skip the buffers that were entirely read, and advance inside
+         * the partially read one */
+        size_t remaining = rc;
+        while ((iovcnt > 0) && (remaining >= iov->iov_len)) {
+            remaining -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
     }
-    return res == 0;
+    return num_read;
 }
 
 }
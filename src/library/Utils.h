@@ -23,14 +23,27 @@
 #define LIBTAS_UTILS_H
 
 #include <cstddef> // size_t
+#include <cstdint> // uint64_t
 #include <unistd.h> // ssize_t
+#include <sys/uio.h> // struct iovec
 
 namespace libtas {
 namespace Utils
 {
     ssize_t writeAll(int fd, const void *buf, size_t count);
     ssize_t readAll(int fd, void *buf, size_t count);
-    bool isZeroPage(void *addr);
+    ssize_t pwriteAll(int fd, const void *buf, size_t count, off_t offset);
+    ssize_t preadAll(int fd, void *buf, size_t count, off_t offset);
+    ssize_t pwritevAll(int fd, struct iovec *iov, int iovcnt, off_t offset);
+    ssize_t preadvAll(int fd, struct iovec *iov, int iovcnt, off_t offset);
+
+    /* Functions defined in UtilsPages.cpp */
+    bool isZeroPage(const void *addr);
+    uint64_t hashPage(const void *addr);
+
+    /* Check if a page is zero, and compute its hash otherwise. The returned
+     * hash is zero for zero pages. */
+    uint64_t hashPage(const void *addr, bool &zero);
 }
 }
 
@@ -0,0 +1,172 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+
+    Zero page detection taken from DMTCP <http://dmtcp.sourceforge.net/>
+*/
+
+/* Functions of Utils scanning memory pages. They are kept in their own file
+ * without any dependency on the rest of the library, so that they can be
+ * built by the page benchmark in test/.
+ *
+ * These functions are called from the checkpoint code, possibly from
+ * savestate helper threads, so they must not allocate or log anything.
+ */
+
+#include "Utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LIBTAS_PAGES_X86
+#endif
+
+namespace libtas {
+
+static const size_t page_size = 4096;
+
+static bool isZeroPageScalar(const void *addr)
+{
+    const uint64_t *buf = static_cast<const uint64_t*>(addr);
+    size_t end = page_size / sizeof(*buf);
+
+    for (size_t i = 0; i < end; i += 8) {
+        uint64_t res = buf[i + 0] | buf[i + 1] | buf[i + 2] | buf[i + 3] |
+        buf[i + 4] | buf[i + 5] | buf[i + 6] | buf[i + 7];
+        if (res != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef LIBTAS_PAGES_X86
+
+/* Pages are always aligned, so we can use aligned loads. Both versions check
+ * a whole cache line (or two) before testing the result. */
+__attribute__((target("sse2")))
+static bool isZeroPageSSE2(const void *addr)
+{
+    const __m128i *buf = static_cast<const __m128i*>(addr);
+    size_t end = page_size / sizeof(*buf);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (size_t i = 0; i < end; i += 4) {
+        __m128i res = _mm_or_si128(
+            _mm_or_si128(_mm_load_si128(buf + i + 0), _mm_load_si128(buf + i + 1)),
+            _mm_or_si128(_mm_load_si128(buf + i + 2), _mm_load_si128(buf + i + 3)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(res, zero)) != 0xffff) {
+            return false;
+        }
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+static bool isZeroPageAVX2(const void *addr)
+{
+    const __m256i *buf = static_cast<const __m256i*>(addr);
+    size_t end = page_size / sizeof(*buf);
+
+    for (size_t i = 0; i < end; i += 4) {
+        __m256i res = _mm256_or_si256(
+            _mm256_or_si256(_mm256_load_si256(buf + i + 0), _mm256_load_si256(buf + i + 1)),
+            _mm256_or_si256(_mm256_load_si256(buf + i + 2), _mm256_load_si256(buf + i + 3)));
+        if (!_mm256_testz_si256(res, res)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
+
+/* This function detects if the given page is zero pages or not, using the
+ * widest vector instructions supported by the cpu.
+ *
+ * TODO: One can use /proc/self/pagemap to detect if the page is backed by a
+ * shared zero page.
+ */
+bool Utils::isZeroPage(const void *addr)
+{
+#ifdef LIBTAS_PAGES_X86
+    if (__builtin_cpu_supports("avx2"))
+        return isZeroPageAVX2(addr);
+    if (__builtin_cpu_supports("sse2"))
+        return isZeroPageSSE2(addr);
+#endif
+    return isZeroPageScalar(addr);
+}
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* Compute a 64-bit hash of a memory page, using the XXH64 algorithm.
+ * The page being a multiple of 32 bytes, we don't need to process any
+ * remaining input after the main loop.
+ */
+uint64_t Utils::hashPage(const void *addr)
+{
+    static const uint64_t prime1 = 11400714785074694791ULL;
+    static const uint64_t prime2 = 14029467366897019727ULL;
+    static const uint64_t prime3 = 1609587929392839161ULL;
+    static const uint64_t prime4 = 9650029242287828579ULL;
+
+    const uint64_t *buf = static_cast<const uint64_t*>(addr);
+    size_t end = page_size / sizeof(*buf);
+
+    uint64_t acc[4] = {prime1 + prime2, prime2, 0, -prime1};
+
+    for (size_t i = 0; i < end; i += 4) {
+        for (int l = 0; l < 4; l++) {
+            acc[l] = rotl64(acc[l] + buf[i + l] * prime2, 31) * prime1;
+        }
+    }
+
+    uint64_t h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+    for (int l = 0; l < 4; l++) {
+        h ^= rotl64(acc[l] * prime2, 31) * prime1;
+        h = h * prime1 + prime4;
+    }
+
+    h += page_size;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* XXH64 relies on 64-bit multiplications which have no vector equivalent
+ * before AVX-512, so it runs about ten times slower than the zero check.
+ * Accumulating the zero check inside the hash loop would make zero pages
+ * as slow as other pages, so we run the vector zero check first, which
+ * returns early on most non-zero pages, and hash the page while it is still
+ * in cache.
+ */
+uint64_t Utils::hashPage(const void *addr, bool &zero)
+{
+    zero = isZeroPage(addr);
+    if (zero)
+        return 0;
+    return hashPage(addr);
+}
+
+}
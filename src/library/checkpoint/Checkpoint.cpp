@@ -26,6 +26,7 @@
 #include "ProcMapsArea.h"
 #include "ProcSelfMaps.h"
 #include "StateHeader.h"
+#include "StateIndex.h"
 #include "../Utils.h"
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -37,11 +38,26 @@
 #include <X11/Xlib-xcb.h>
 #include <sys/statvfs.h>
 #include <sys/syscall.h>
+#include <sys/uio.h>
+#include <climits> // IOV_MAX
 #include "errno.h"
 #include "../../external/xcbint.h"
 #include "../renderhud/RenderHUD.h"
 #include "ReservedMemory.h"
 #include "SaveState.h"
+#include "HelperThreads.h"
+#include "RawSyscall.h"
+#include "PageStore.h"
+#include "StateSlots.h"
+#include "StateFlusher.h"
+#include "LazyRestore.h"
+#include "StateChain.h"
+#include "CheckpointStats.h"
+#include <new> // placement new
+#include <cstdio> // snprintf
+#ifdef LIBTAS_HAS_LZ4
+#include <lz4.h>
+#endif
 
 #define ONE_MB 1024 * 1024
 
@@ -62,14 +78,108 @@ static int ss_index = -1;
 static int parent_ss_index = -1;
 static int base_ss_index = -1;
 
+/* Was the parent savestate dropped. In that case, we cannot rely on
+ * soft-dirty bits for the next savestate */
+static bool parent_dropped = false;
+
 static bool skipArea(const Area *area);
 
+/* Ancestors of the loading savestate in its delta chain, starting from its
+ * parent, and the index of the parent savestate among them, or -1 */
+struct StateAncestors {
+    SaveState* states[StateChain::MAX_DEPTH];
+    int count;
+    int parent;
+};
+
 static void readAllAreas();
 static int reallocateArea(Area *saved_area, Area *current_area);
-static void readAnArea(SaveState &saved_area, int spmfd, SaveState &parent_state, SaveState &base_state);
+static void readAnArea(SaveState &saved_area, int spmfd, SaveState &parent_state, SaveState &base_state, StateAncestors &ancestors, SavestateStats &stats);
+
+/* State of a savestate writer, which dumps a group of consecutive memory
+ * areas into its own regions of the pagemap and pages files. Writers may run
+ * in parallel inside helper threads, so they must not access any thread-local
+ * variable, and they write at explicit offsets of the shared files.
+ */
+struct AreaWriter {
+    /* File descriptors of the savestate and of /proc/self/pagemap */
+    int pmfd;
+    int pfd;
+    int spmfd;
+
+    /* Position of the next area in the pagemap file and of the next page
+     * in the pages file */
+    off_t pm_offset;
+    off_t pages_offset;
+
+    /* Staging array of iovecs, located in our reserved memory, used to
+     * coalesce page writes into a small number of pwritev calls */
+    struct iovec* iovecs;
+    int iovec_count;
+    int max_iovecs;
+    off_t iovec_offset;
+
+    /* Consider all pages as modified since the parent savestate */
+    bool all_dirty;
+
+    /* Pages not modified since the parent savestate are only referenced,
+     * instead of being stored again */
+    bool chained;
+
+    /* Are pages compressed or stored in the page store, and the buffer in
+     * our reserved memory that receives compressed pages or page ids until
+     * they are written */
+    bool compressed;
+    bool deduplicated;
+    char* buffer;
+    size_t buffer_size;
+    size_t buffer_used;
+
+    /* Parent savestate, for incremental savestates */
+    SaveState* parent_state;
+
+    /* Group of areas to write */
+    ProcSelfMaps* maps;
+    size_t maps_position;
+    int area_count;
+
+    /* Statistics gathered by the writer */
+    size_t size;
+    size_t page_bytes;
+    size_t stored_bytes;
+    int new_pages;
+    int syscalls;
+    int errors;
+
+    /* Number of failed reads and writes, and the error code of the last
+     * one. Writers can't log, so they are reported after all writers are
+     * done. */
+    int io_errors;
+    int io_error;
+
+    /* Time spent in each phase, in timestamp counter ticks, and number of
+     * pages by flag. They are added to the statistics after all writers
+     * are done, so that writers don't share any counter */
+    uint64_t pagemap_ticks;
+    uint64_t scan_ticks;
+    uint64_t write_ticks;
+    uint64_t page_counts[Area::PARENT_PAGE+1];
+};
 
 static size_t writeAllAreas(bool base);
-static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &parent_state);
+static int writeAreaGroup(void* arg);
+static void writeAnArea(AreaWriter &writer, Area &area);
+static uint16_t queuePageWrite(AreaWriter &writer, char* addr, const uint64_t* hash = nullptr);
+static void queueBuffer(AreaWriter &writer, char* buf, size_t size);
+static void flushPageWrites(AreaWriter &writer);
+static void writerPwrite(AreaWriter &writer, int fd, const void* buf, size_t count, off_t offset);
+
+/* Maximum number of iovecs used by each writer */
+static const int max_page_iovecs = (ReservedMemory::IOVEC_SIZE / sizeof(struct iovec) / HelperThreads::MAX_THREADS < IOV_MAX) ?
+    (ReservedMemory::IOVEC_SIZE / sizeof(struct iovec) / HelperThreads::MAX_THREADS) : IOV_MAX;
+
+/* Number of I/O syscalls issued during the last savestate */
+static int savestate_syscalls = 0;
 
 void Checkpoint::setSavestatePath(std::string path)
 {
@@ -106,29 +216,48 @@ void Checkpoint::setCurrentToParent()
     parent_ss_index = ss_index;
 }
 
-static int getPagemapFd(int index)
+void Checkpoint::dropSavestate()
 {
-    if (index < 0) return 0;
-    int* pagemaps = static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGEMAPS_ADDR));
-    return pagemaps[index];
-}
+    /* All incremental savestates depend on the base savestate */
+    if (shared_config.incremental_savestates && (ss_index == base_ss_index)) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Cannot drop the base savestate");
+        return;
+    }
 
-static int getPagesFd(int index)
-{
-    if (index < 0) return 0;
-    int* pages = static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGES_ADDR));
-    return pages[index];
-}
+    /* Pages may still be loaded from the savestate, or the savestate may
+     * still be compacted */
+    LazyRestore::wait();
+    StateChain::wait();
 
-static void setPagemapFd(int index, int fd)
-{
-    int* pagemaps = static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGEMAPS_ADDR));
-    pagemaps[index] = fd;
-}
-static void setPagesFd(int index, int fd)
-{
-    int* pages = static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGES_ADDR));
-    pages[index] = fd;
+    bool is_parent;
+    if (shared_config.savestates_in_ram) {
+        int pmfd = StateSlots::getPagemapFd(ss_index);
+        if (pmfd) {
+            /* The savestate is kept if other savestates depend on it */
+            StateChain::release(pmfd);
+            StateSlots::setPagemapFd(ss_index, 0);
+            StateSlots::setPagesFd(ss_index, 0);
+        }
+        is_parent = (ss_index == parent_ss_index);
+    }
+    else {
+        /* The savestate may still be written in background, so we must
+         * remove the files after it completes. The program removes them too,
+         * but it may be earlier. */
+        StateFlusher::wait();
+        NATIVECALL(unlink(pagemappath));
+        NATIVECALL(unlink(pagespath));
+        is_parent = (strcmp(pagemappath, parentpagemappath) == 0);
+    }
+
+    if (is_parent) {
+        parentpagemappath[0] = '\0';
+        parentpagespath[0] = '\0';
+        parent_ss_index = -1;
+        parent_dropped = true;
+    }
+
+    debuglogstdio(LCF_CHECKPOINT, "Dropped state %d", ss_index);
 }
 
 bool Checkpoint::checkCheckpoint()
@@ -139,14 +268,14 @@ bool Checkpoint::checkCheckpoint()
     /* Get an estimation of the savestate space */
     size_t savestate_size = 0;
 
-    ProcSelfMaps procSelfMaps(ReservedMemory::getAddr(ReservedMemory::PSM_ADDR), ReservedMemory::PSM_SIZE);
+    ProcSelfMaps procSelfMaps(skipArea);
 
     /* Read the first current area */
     Area area;
     bool not_eof = procSelfMaps.getNextArea(&area);
 
     while (not_eof) {
-        if (!skipArea(&area)) {
+        if (!area.skip) {
             savestate_size += area.size;
         }
         not_eof = procSelfMaps.getNextArea(&area);
@@ -176,9 +305,12 @@ bool Checkpoint::checkCheckpoint()
 
 bool Checkpoint::checkRestore()
 {
+    /* The savestate may still be written in background */
+    StateFlusher::wait();
+
     /* Check that the savestate files exist */
     if (shared_config.savestates_in_ram) {
-        if (!getPagemapFd(ss_index)) {
+        if (!StateSlots::getPagemapFd(ss_index)) {
             debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Savestate does not exist");
 #ifdef LIBTAS_ENABLE_HUD
             RenderHUD::insertMessage("Savestate does not exist");
@@ -186,7 +318,7 @@ bool Checkpoint::checkRestore()
             return false;
         }
 
-        if (!getPagesFd(ss_index)) {
+        if (!StateSlots::getPagesFd(ss_index)) {
             debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Savestate does not exist");
 #ifdef LIBTAS_ENABLE_HUD
             RenderHUD::insertMessage("Savestate does not exist");
@@ -214,7 +346,7 @@ bool Checkpoint::checkRestore()
 
     int pmfd;
     if (shared_config.savestates_in_ram) {
-        pmfd = getPagemapFd(ss_index);
+        pmfd = StateSlots::getPagemapFd(ss_index);
         lseek(pmfd, 0, SEEK_SET);
     }
     else {
@@ -230,6 +362,15 @@ bool Checkpoint::checkRestore()
         NATIVECALL(close(pmfd));
     }
 
+    /* Check that the savestate was written in the current format */
+    if ((sh.magic != STATEMAGIC) || (sh.version != STATEVERSION)) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR | LCF_ALERT, "Loading this state is not supported because it was written by another version of libTAS");
+#ifdef LIBTAS_ENABLE_HUD
+        RenderHUD::insertMessage("Loading the savestate not allowed because it was written by another version");
+#endif
+        return false;
+    }
+
     /* Check that the thread list is identical */
     int n=0;
     for (ThreadInfo *thread = ThreadManager::thread_list; thread != nullptr; thread = thread->next) {
@@ -279,6 +420,15 @@ void Checkpoint::handler(int signum)
         return;
     }
 
+    /* Savestate files must not be accessed while a previous savestate is
+     * written or compacted in background, and memory must not be accessed
+     * while pages of the previous loaded savestate are not all loaded */
+    StateFlusher::wait();
+    LazyRestore::wait();
+    StateChain::wait();
+
+    CheckpointStats::setIndex(ss_index);
+
     /* Sync all X server connections */
     for (int i=0; i<GAMEDISPLAYNUM; i++) {
         if (gameDisplays[i])
@@ -313,7 +463,9 @@ void Checkpoint::handler(int signum)
 
         TimeHolder old_time, new_time, delta_time;
         NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &old_time));
+        uint64_t restore_ticks = CheckpointStats::ticks();
         readAllAreas();
+        CheckpointStats::addTicks(CheckpointStats::RESTORE, CheckpointStats::ticks() - restore_ticks);
         NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &new_time));
         delta_time = new_time - old_time;
         debuglogstdio(LCF_CHECKPOINT | LCF_INFO, "Loaded state %d in %f seconds", ss_index, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0);
@@ -345,14 +497,14 @@ void Checkpoint::handler(int signum)
         /* Check that base savestate exists, otherwise save it */
         if (shared_config.incremental_savestates) {
             if (shared_config.savestates_in_ram) {
-                int fd = getPagemapFd(base_ss_index);
+                int fd = StateSlots::getPagemapFd(base_ss_index);
                 if (!fd) {
                     TimeHolder old_time, new_time, delta_time;
                     NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &old_time));
                     size_t savestate_size = writeAllAreas(true);
                     NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &new_time));
                     delta_time = new_time - old_time;
-                    debuglogstdio(LCF_INFO, "Saved base state of size %lld in %f seconds", savestate_size, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0);
+                    debuglogstdio(LCF_INFO, "Saved base state of size %lld in %f seconds with %d syscalls", savestate_size, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0, savestate_syscalls);
                 }
             }
             else {
@@ -363,7 +515,7 @@ void Checkpoint::handler(int signum)
                     size_t savestate_size = writeAllAreas(true);
                     NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &new_time));
                     delta_time = new_time - old_time;
-                    debuglogstdio(LCF_INFO, "Saved base state of size %lld in %f seconds", savestate_size, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0);
+                    debuglogstdio(LCF_INFO, "Saved base state of size %lld in %f seconds with %d syscalls", savestate_size, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0, savestate_syscalls);
                 }
             }
         }
@@ -375,8 +527,13 @@ void Checkpoint::handler(int signum)
         NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &old_time));
         size_t savestate_size = writeAllAreas(false);
         NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &new_time));
+        CheckpointStats::get().size = savestate_size;
         delta_time = new_time - old_time;
-        debuglogstdio(LCF_CHECKPOINT | LCF_INFO, "Saved state %d of size %lld in %f seconds", ss_index, savestate_size, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0);
+        debuglogstdio(LCF_CHECKPOINT | LCF_INFO, "Saved state %d of size %lld in %f seconds with %d syscalls", ss_index, savestate_size, delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0, savestate_syscalls);
+
+        /* Fold the delta chain of the savestate if it became too long */
+        if (shared_config.savestates_in_ram)
+            StateChain::startCompaction(ss_index);
     }
 }
 
@@ -417,6 +574,12 @@ static bool skipArea(const Area *area)
         return true;
     }
 
+    /* Don't save the region of the page store table, the savestate table,
+     * the lazy restore table and the delta chain table */
+    if (ReservedMemory::isTableArea(area)) {
+        return true;
+    }
+
     /* Save area if write permission */
     if (area->prot & PROT_WRITE) {
         return false;
@@ -434,7 +597,7 @@ static bool skipArea(const Area *area)
 
 static void readAllAreas()
 {
-    SaveState saved_state(pagemappath, pagespath, getPagemapFd(ss_index), getPagesFd(ss_index));
+    SaveState saved_state(pagemappath, pagespath, StateSlots::getPagemapFd(ss_index), StateSlots::getPagesFd(ss_index));
 
     int spmfd, crfd;
     if (shared_config.incremental_savestates) {
@@ -455,7 +618,9 @@ static void readAllAreas()
     debuglogstdio(LCF_CHECKPOINT, "Performing restore.");
 
     /* Read the memory mapping */
-    ProcSelfMaps procSelfMaps(ReservedMemory::getAddr(ReservedMemory::PSM_ADDR), ReservedMemory::PSM_SIZE);
+    uint64_t maps_ticks = CheckpointStats::ticks();
+    ProcSelfMaps procSelfMaps(skipArea);
+    CheckpointStats::addTicks(CheckpointStats::MAPS, CheckpointStats::ticks() - maps_ticks);
 
     /* Read the first current area */
     bool not_eof = procSelfMaps.getNextArea(&current_area);
@@ -483,24 +648,53 @@ static void readAllAreas()
     /* Now that the memory layout matches the savestate, we load savestate into memory */
     saved_state.restart();
 
+    /* Pages of some areas can be loaded on first access */
+    LazyRestore::init();
+
     /* Load base and parent savestates */
-    SaveState parent_state(parentpagemappath, parentpagespath, getPagemapFd(parent_ss_index), getPagesFd(parent_ss_index));
-    SaveState base_state(basepagemappath, basepagespath, getPagemapFd(base_ss_index), getPagesFd(base_ss_index));
+    SaveState parent_state(parentpagemappath, parentpagespath, StateSlots::getPagemapFd(parent_ss_index), StateSlots::getPagesFd(parent_ss_index));
+    SaveState base_state(basepagemappath, basepagespath, StateSlots::getPagemapFd(base_ss_index), StateSlots::getPagesFd(base_ss_index));
+
+    /* Load the ancestors of the savestate in its delta chain, and look for
+     * the parent savestate among them */
+    StateAncestors ancestors;
+    ancestors.count = 0;
+    ancestors.parent = -1;
+    if (shared_config.savestates_in_ram) {
+        int pmfds[StateChain::MAX_DEPTH];
+        ancestors.count = StateChain::openAncestors(StateSlots::getPagemapFd(ss_index), ancestors.states, pmfds);
+        for (int d = 0; d < ancestors.count; d++) {
+            if (pmfds[d] == StateSlots::getPagemapFd(parent_ss_index))
+                ancestors.parent = d;
+        }
+    }
 
     /* If the loading savestate and the parent savestate are the same, pass the
      * same SaveState object to readAnArea because two SaveState objects
      * handling the same file descriptor will mess up the file offset. */
     bool same_state = (ss_index == parent_ss_index);
+    SavestateStats& stats = CheckpointStats::get();
     while (saved_area.addr != nullptr) {
-        readAnArea(saved_state, spmfd, same_state?saved_state:parent_state, base_state);
+        readAnArea(saved_state, spmfd, same_state?saved_state:parent_state, base_state, ancestors, stats);
         saved_state.nextArea();
     }
 
+    if (ancestors.count > 0)
+        StateChain::closeAncestors();
+
+    if (shared_config.incremental_savestates) {
+        debuglogstdio(LCF_CHECKPOINT, "Skipped loading %llu unmodified pages", stats.unmodified_pages);
+    }
+
     if (shared_config.incremental_savestates) {
         /* Clear soft-dirty bits */
         Utils::writeAll(crfd, "4\n", 2);
     }
 
+    /* Start loading lazy pages. Pages loaded later are marked as soft-dirty,
+     * so they will be saved again by the next incremental savestate */
+    LazyRestore::start();
+
     if (shared_config.incremental_savestates) {
         NATIVECALL(close(crfd));
         NATIVECALL(close(spmfd));
@@ -518,7 +712,7 @@ static int reallocateArea(Area *saved_area, Area *current_area)
 
         /* Check if it is a skipped area */
         if (saved_area->skip) {
-            if (!skipArea(current_area)) {
+            if (!current_area->skip) {
                 debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Current section is not skipped anymore !?");
                 saved_area->print("Saved");
                 current_area->print("Current");
@@ -600,7 +794,7 @@ static int reallocateArea(Area *saved_area, Area *current_area)
             ptrdiff_t unmap_size = reinterpret_cast<ptrdiff_t>(saved_area->addr) - reinterpret_cast<ptrdiff_t>(current_area->addr);
 
             /* We only deallocate this section if we are interested in it */
-            if (!skipArea(current_area)) {
+            if (!current_area->skip) {
                 debuglogstdio(LCF_CHECKPOINT, "Region %p (%s) with size %d must be deallocated", current_area->addr, current_area->name, unmap_size);
                 MYASSERT(munmap(current_area->addr, unmap_size) == 0)
             }
@@ -613,7 +807,7 @@ static int reallocateArea(Area *saved_area, Area *current_area)
         else {
             /* Areas are not overlapping, we unmap the whole area */
             /* We only deallocate this section if we are interested in it */
-            if (!skipArea(current_area)) {
+            if (!current_area->skip) {
                 current_area->print("Deallocating");
                 MYASSERT(munmap(current_area->addr, current_area->size) == 0)
             }
@@ -702,7 +896,40 @@ static int reallocateArea(Area *saved_area, Area *current_area)
     return 0;
 }
 
-static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_state, SaveState &base_state)
+/* Count a page of the savestate by its flag */
+static void countPage(SavestateStats &stats, char flag)
+{
+    switch (flag) {
+        case Area::NO_PAGE:
+            stats.no_pages++;
+            break;
+        case Area::ZERO_PAGE:
+            stats.zero_pages++;
+            break;
+        case Area::BASE_PAGE:
+            stats.base_pages++;
+            break;
+        case Area::FULL_PAGE:
+            stats.full_pages++;
+            break;
+        case Area::PARENT_PAGE:
+            stats.parent_pages++;
+            break;
+    }
+}
+
+/* Returns if a memory page was not modified since the last savestate or
+ * state loading, from its /proc/self/pagemap entry. Soft-dirty bits of pages
+ * that are not present are lost, for example after MADV_DONTNEED, so the page
+ * must be present or swapped. */
+static bool isUnmodifiedPage(uint64_t page)
+{
+    bool soft_dirty = page & (0x1ull << 55);
+    bool present = page & ((0x1ull << 63) | (0x1ull << 62));
+    return present && !soft_dirty;
+}
+
+static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_state, SaveState &base_state, StateAncestors &ancestors, SavestateStats &stats)
 {
     const Area& saved_area = saved_state.getArea();
 
@@ -714,6 +941,18 @@ static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_stat
         MYASSERT(mprotect(saved_area.addr, saved_area.size, saved_area.prot | PROT_WRITE) == 0)
     }
 
+    /* Pages of the area may be loaded on first access */
+    bool lazy = LazyRestore::isLazyArea(saved_area);
+
+#ifdef MADV_POPULATE_WRITE
+    /* If all pages of an anonymous area are stored in the savestate, fault
+     * them in at once instead of on each page write. This fails on kernels
+     * older than 5.14, which is fine. */
+    if (!lazy && (saved_area.flags & MAP_ANONYMOUS) && saved_state.isFullArea()) {
+        madvise(saved_area.addr, saved_area.size, MADV_POPULATE_WRITE);
+    }
+#endif
+
     if (shared_config.incremental_savestates) {
         /* Seek at the beginning of the area pagemap */
         MYASSERT(-1 != lseek(spmfd, static_cast<off_t>(reinterpret_cast<uintptr_t>(saved_area.addr) / (4096/8)), SEEK_SET));
@@ -737,12 +976,16 @@ static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_stat
     curAddr += 4096, page_i++, pagemap_i++) {
         /* We read pagemap file in chunks to avoid too many read syscalls */
         if (shared_config.incremental_savestates && (pagemap_i >= 512)) {
+            uint64_t pagemap_ticks = CheckpointStats::ticks();
             size_t remaining_pages = ((nb_pages-page_i)>512)?512:(nb_pages-page_i);
             Utils::readAll(spmfd, pagemaps, remaining_pages*8);
             pagemap_i = 0;
+            CheckpointStats::addTicks(CheckpointStats::PAGEMAP, CheckpointStats::ticks() - pagemap_ticks);
         }
 
         char flag = saved_state.getNextPageFlag();
+        countPage(stats, flag);
+        bool lazy_page = lazy && !LazyRestore::isPinnedPage(curAddr);
 
         if (flag == Area::NO_PAGE) {
         }
@@ -780,29 +1023,81 @@ static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_stat
                  */
                 char base_flag = base_state.getPageFlag(curAddr);
                 MYASSERT(base_flag == Area::FULL_PAGE);
-                base_state.queuePageLoad(curAddr);
+                base_state.queuePageLoad(curAddr, lazy_page);
             }
             else {
-                /* Gather the flag for the page map */
-                uint64_t page = pagemaps[pagemap_i];
-                bool soft_dirty = page & (0x1ull << 55);
-
-                if (soft_dirty) {
+                if (!isUnmodifiedPage(pagemaps[pagemap_i])) {
                     /* Memory page has been modified after parent state.
                      * We must read from the base savestate.
                      */
                     char base_flag = base_state.getPageFlag(curAddr);
                     MYASSERT(base_flag == Area::FULL_PAGE);
-                    base_state.queuePageLoad(curAddr);
+                    base_state.queuePageLoad(curAddr, lazy_page);
+                }
+                else {
+                    stats.unmodified_pages++;
+                }
+            }
+        }
+        else if (flag == Area::PARENT_PAGE) {
+            /* The page is stored by an ancestor of the savestate. If the
+             * memory page was not modified since the parent savestate, and
+             * the parent savestate is the same state or is reached before
+             * the ancestor storing the page, it already contains the page. */
+            bool unmodified = shared_config.incremental_savestates && isUnmodifiedPage(pagemaps[pagemap_i]);
+            bool skipped = unmodified && (&parent_state == &saved_state);
+
+            SaveState* ancestor = nullptr;
+            char ancestor_flag = flag;
+            for (int d = 0; !skipped && (ancestor_flag == Area::PARENT_PAGE); d++) {
+                MYASSERT(d < ancestors.count)
+                if (unmodified && (d == ancestors.parent)) {
+                    skipped = true;
                 }
+                else {
+                    ancestor = ancestors.states[d];
+                    ancestor_flag = ancestor->getPageFlag(curAddr);
+                }
+            }
+
+            if (skipped) {
+                stats.unmodified_pages++;
+            }
+            else {
+                MYASSERT(ancestor_flag == Area::FULL_PAGE);
+                ancestor->queuePageLoad(curAddr, lazy_page);
             }
         }
         else {
-            saved_state.queuePageLoad(curAddr);
+            /* If the memory page was not modified since the parent savestate,
+             * it already contains the page when loading the parent savestate
+             * again, or when both savestates store the same page id. This
+             * makes loading a recent savestate only read the pages that were
+             * modified since then. */
+            bool unmodified = false;
+            if (shared_config.incremental_savestates && isUnmodifiedPage(pagemaps[pagemap_i])) {
+                if (&parent_state == &saved_state) {
+                    unmodified = true;
+                }
+                else if (saved_state.isDeduplicated() && parent_state.isDeduplicated() &&
+                    (parent_state.getPageFlag(curAddr) == Area::FULL_PAGE)) {
+                    unmodified = (parent_state.getPageId() == saved_state.getPageId());
+                }
+            }
+
+            if (unmodified)
+                stats.unmodified_pages++;
+            else
+                saved_state.queuePageLoad(curAddr, lazy_page);
         }
     }
     base_state.finishLoad();
     saved_state.finishLoad();
+    for (int d = 0; d < ancestors.count; d++)
+        ancestors.states[d]->finishLoad();
+
+    if (lazy)
+        LazyRestore::addArea(saved_area.addr, saved_area.endAddr);
 
     /* Recover permission to the area */
     if (!(saved_area.prot & PROT_WRITE)) {
@@ -827,41 +1122,49 @@ static size_t writeAllAreas(bool base)
     char temppagemappath[1024];
     char temppagespath[1024];
 
+    /* When writing in background, the savestate is first dumped into staging
+     * memfds, and these are the files that will receive it. The base
+     * savestate is always written directly. */
+    bool async = shared_config.savestates_async && !shared_config.savestates_in_ram && !base;
+    int dst_pmfd = -1;
+    int dst_pfd = -1;
+
+    /* If the parent savestate was dropped, memory pages that were not
+     * modified since then must be saved anyway. We reset the flag before
+     * it gets saved. */
+    bool all_dirty = parent_dropped && !base;
+    if (!base)
+        parent_dropped = false;
+
     if (shared_config.savestates_in_ram) {
+        /* Make room in the savestate table, which must be done before
+         * parsing the memory mapping */
+        StateSlots::reserve(base ? base_ss_index : ss_index);
+
         if (!shared_config.incremental_savestates) {
             debuglogstdio(LCF_CHECKPOINT, "Performing checkpoint in slot %d", ss_index);
 
-            pmfd = getPagemapFd(ss_index);
-            if (pmfd) {
-                ftruncate(pmfd, 0);
-                lseek(pmfd, 0, SEEK_SET);
-            }
-            else {
-                /* Create a new memfd */
-                pmfd = syscall(SYS_memfd_create, "pagemapstate", 0);
-                setPagemapFd(ss_index, pmfd);
-            }
+            /* Release the old savestate, which is kept if other savestates
+             * depend on it */
+            if (StateSlots::getPagemapFd(ss_index))
+                StateChain::release(StateSlots::getPagemapFd(ss_index));
 
-            pfd = getPagesFd(ss_index);
-            if (pfd) {
-                ftruncate(pfd, 0);
-                lseek(pfd, 0, SEEK_SET);
-            }
-            else {
-                /* Create a new memfd */
-                pfd = syscall(SYS_memfd_create, "pagesstate", 0);
-                setPagesFd(ss_index, pfd);
-            }
+            /* Create new memfds */
+            pmfd = syscall(SYS_memfd_create, "pagemapstate", 0);
+            StateSlots::setPagemapFd(ss_index, pmfd);
+
+            pfd = syscall(SYS_memfd_create, "pagesstate", 0);
+            StateSlots::setPagesFd(ss_index, pfd);
         }
         else if (base) {
             debuglogstdio(LCF_CHECKPOINT, "Performing checkpoint in slot %d", base_ss_index);
 
             /* Create new memfds */
             pmfd = syscall(SYS_memfd_create, "pagemapstate", 0);
-            setPagemapFd(base_ss_index, pmfd);
+            StateSlots::setPagemapFd(base_ss_index, pmfd);
 
             pfd = syscall(SYS_memfd_create, "pagesstate", 0);
-            setPagesFd(base_ss_index, pfd);
+            StateSlots::setPagesFd(base_ss_index, pfd);
         }
         else {
             debuglogstdio(LCF_CHECKPOINT, "Performing checkpoint in slot %d", ss_index);
@@ -871,11 +1174,11 @@ static size_t writeAllAreas(bool base)
         }
     }
     else {
-        if (!shared_config.incremental_savestates) {
+        if (!shared_config.incremental_savestates && !async) {
             debuglogstdio(LCF_CHECKPOINT, "Performing checkpoint in %s and %s", pagemappath, pagespath);
 
             NATIVECALL(unlink(pagemappath));
-            NATIVECALL(pmfd = creat(pagemappath, 0644));
+            NATIVECALL(pmfd = open(pagemappath, O_CREAT | O_RDWR | O_TRUNC, 0644));
 
             NATIVECALL(unlink(pagespath));
             NATIVECALL(pfd = creat(pagespath, 0644));
@@ -883,7 +1186,7 @@ static size_t writeAllAreas(bool base)
         else if (base) {
             debuglogstdio(LCF_CHECKPOINT, "Performing checkpoint in %s", basepagespath);
 
-            NATIVECALL(pmfd = creat(basepagemappath, 0644));
+            NATIVECALL(pmfd = open(basepagemappath, O_CREAT | O_RDWR | O_TRUNC, 0644));
             NATIVECALL(pfd = creat(basepagespath, 0644));
         }
         else {
@@ -896,16 +1199,38 @@ static size_t writeAllAreas(bool base)
             debuglogstdio(LCF_CHECKPOINT, "Performing checkpoint in %s and %s", temppagemappath, temppagespath);
 
             NATIVECALL(unlink(temppagemappath));
-            NATIVECALL(pmfd = creat(temppagemappath, 0644));
+            NATIVECALL(pmfd = open(temppagemappath, O_CREAT | O_RDWR | O_TRUNC, 0644));
 
             NATIVECALL(unlink(temppagespath));
             NATIVECALL(pfd = creat(temppagespath, 0644));
         }
+
+        if (async) {
+            MYASSERT(pmfd != -1)
+            MYASSERT(pfd != -1)
+            dst_pmfd = pmfd;
+            dst_pfd = pfd;
+            StateFlusher::getStagingFds(pmfd, pfd);
+        }
     }
 
     MYASSERT(pmfd != -1)
     MYASSERT(pfd != -1)
 
+    if (shared_config.savestates_in_ram) {
+        if (shared_config.incremental_savestates && !base) {
+            /* The savestate is registered when complete, but the table of
+             * delta chains must be able to hold it before parsing the
+             * memory mapping */
+            StateChain::reserve(pmfd);
+        }
+        else {
+            StateChain::add(pmfd, pfd, 0);
+        }
+    }
+
+    savestate_syscalls = 0;
+
     int spmfd;
     NATIVECALL(spmfd = open("/proc/self/pagemap", O_RDONLY));
     MYASSERT(spmfd != -1);
@@ -916,8 +1241,17 @@ static size_t writeAllAreas(bool base)
         MYASSERT(crfd != -1);
     }
 
-    /* Saving the savestate header */
+    /* Saving the savestate header. The index is written at the end */
     StateHeader sh;
+    sh.magic = STATEMAGIC;
+    sh.version = STATEVERSION;
+    sh.index_offset = 0;
+    sh.area_count = 0;
+    sh.runs_offset = 0;
+    sh.run_count = 0;
+    sh.pages_size = 0;
+    for (int f = 0; f <= Area::PARENT_PAGE; f++)
+        sh.page_counts[f] = 0;
     int n=0;
     for (ThreadInfo *thread = ThreadManager::thread_list; thread != nullptr; thread = thread->next) {
         if (thread->state == ThreadInfo::ST_SUSPENDED) {
@@ -926,47 +1260,261 @@ static size_t writeAllAreas(bool base)
         }
     }
     sh.thread_count = n;
-    Utils::writeAll(pmfd, &sh, sizeof(sh));
+
+    /* Store pages in the page store if enabled, which is only supported
+     * for savestates in RAM */
+    sh.deduplicated = shared_config.savestates_in_ram && shared_config.savestates_deduplication;
+
+    /* Otherwise, compress pages if enabled and supported */
+#ifdef LIBTAS_HAS_LZ4
+    sh.compressed = !sh.deduplicated && shared_config.savestates_compression;
+#else
+    sh.compressed = false;
+#endif
+
+    Utils::pwriteAll(pmfd, &sh, sizeof(sh), 0);
+    savestate_syscalls++;
     savestate_size += sizeof(sh);
 
     /* Load the parent savestate if any. */
-    SaveState parent_state(parentpagemappath, parentpagespath, getPagemapFd(parent_ss_index), getPagesFd(parent_ss_index));
+    SaveState parent_state(parentpagemappath, parentpagespath, StateSlots::getPagemapFd(parent_ss_index), StateSlots::getPagesFd(parent_ss_index));
+
+    /* Pages not modified since the parent savestate are only referenced, if
+     * delta chains are enabled and if the parent savestate stores pages the
+     * same way, so that chains can be compacted */
+    int parent_pmfd = StateSlots::getPagemapFd(parent_ss_index);
+    bool chained = shared_config.savestates_in_ram && shared_config.incremental_savestates &&
+        (shared_config.savestates_chain_length > 0) && !base && parent_state &&
+        (parent_state.isCompressed() == sh.compressed) &&
+        (parent_state.isDeduplicated() == sh.deduplicated) &&
+        (StateChain::getDepth(parent_pmfd) < StateChain::MAX_DEPTH);
 
     /* Parse the content of /proc/self/maps into memory.
      * We don't allocate memory here, we are using our special allocated
      * memory section that won't be saved in the savestate.
      */
-    ProcSelfMaps procSelfMaps(ReservedMemory::getAddr(ReservedMemory::PSM_ADDR), ReservedMemory::PSM_SIZE);
+    uint64_t maps_ticks = CheckpointStats::ticks();
+    ProcSelfMaps procSelfMaps(skipArea);
+    CheckpointStats::addTicks(CheckpointStats::MAPS, CheckpointStats::ticks() - maps_ticks);
 
-    /* Remove write and add read flags from all memory areas we will be dumping */
+    /* Remove write and add read flags from all memory areas we will be
+     * dumping, and count the number of pages to dump */
     Area area;
+    size_t total_pages = 0;
     while (procSelfMaps.getNextArea(&area)) {
-        if (!skipArea(&area)) {
+        if (!area.skip) {
             //MYASSERT(mprotect(area.addr, area.size, (area.prot | PROT_READ) & ~PROT_WRITE) == 0)
             MYASSERT(mprotect(area.addr, area.size, (area.prot | PROT_READ)) == 0)
             MYASSERT(madvise(area.addr, area.size, MADV_SEQUENTIAL) == 0);
+            total_pages += area.size / 4096;
         }
     }
 
-    /* Dump all memory areas */
+    /* Make room in the page store for all pages. If the page store mapping
+     * was created or grown, we must parse the memory mapping again. */
+    if (sh.deduplicated && PageStore::reserve(total_pages)) {
+        maps_ticks = CheckpointStats::ticks();
+        procSelfMaps = ProcSelfMaps(skipArea);
+        CheckpointStats::addTicks(CheckpointStats::MAPS, CheckpointStats::ticks() - maps_ticks);
+    }
+
+    int writer_count = shared_config.savestate_threads;
+    if (writer_count < 1)
+        writer_count = 1;
+    if (writer_count > HelperThreads::MAX_THREADS)
+        writer_count = HelperThreads::MAX_THREADS;
+
+    /* Split the areas into groups of consecutive areas with roughly the same
+     * number of pages, one for each writer. The layout of the pagemap file
+     * only depends on the areas, so we can compute where each group starts.
+     * In the pages file, each group gets a region large enough to hold all
+     * its pages, which may leave holes in the file between groups. */
+    AreaWriter writers[HelperThreads::MAX_THREADS];
+    off_t pm_offset = sizeof(sh);
+    off_t pages_offset = 0;
+    size_t dumped_pages = 0;
+    int w = 0;
+
     procSelfMaps.reset();
+    for (int i = 0; i < writer_count; i++) {
+        AreaWriter &writer = writers[i];
+        writer.pmfd = pmfd;
+        writer.pfd = pfd;
+        writer.spmfd = spmfd;
+        writer.iovecs = static_cast<struct iovec*>(ReservedMemory::getAddr(ReservedMemory::IOVEC_ADDR)) + i * max_page_iovecs;
+        writer.iovec_count = 0;
+        writer.max_iovecs = max_page_iovecs;
+        writer.compressed = sh.compressed;
+        writer.deduplicated = sh.deduplicated;
+        writer.all_dirty = all_dirty;
+        writer.chained = chained;
+        writer.buffer_size = ReservedMemory::COMPRESS_SIZE / HelperThreads::MAX_THREADS;
+        writer.buffer = static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::COMPRESS_ADDR)) + i * writer.buffer_size;
+        writer.buffer_used = 0;
+        writer.parent_state = &parent_state;
+        writer.maps = &procSelfMaps;
+        writer.area_count = 0;
+        writer.size = 0;
+        writer.page_bytes = 0;
+        writer.stored_bytes = 0;
+        writer.new_pages = 0;
+        writer.syscalls = 0;
+        writer.errors = 0;
+        writer.io_errors = 0;
+        writer.io_error = 0;
+        writer.pagemap_ticks = 0;
+        writer.scan_ticks = 0;
+        for (int f = 0; f <= Area::PARENT_PAGE; f++)
+            writer.page_counts[f] = 0;
+    }
+    writers[0].maps_position = procSelfMaps.getPosition();
+    writers[0].pm_offset = pm_offset;
+    writers[0].pages_offset = pages_offset;
+
     while (procSelfMaps.getNextArea(&area)) {
-        if (skipArea(&area)) {
-            area.skip = true;
-            Utils::writeAll(pmfd, &area, sizeof(area));
-            savestate_size += sizeof(area);
+        pm_offset += sizeof(area);
+        if (!area.skip) {
+            area.print("Save");
+            pm_offset += area.size / 4096;
+            if (sh.compressed) {
+                /* Size of each stored page */
+                pm_offset += (area.size / 4096) * sizeof(uint16_t);
+            }
+            if (sh.deduplicated) {
+                /* Only page ids are stored */
+                pages_offset += (area.size / 4096) * sizeof(uint32_t);
+            }
+            else {
+                pages_offset += area.size;
+            }
+            dumped_pages += area.size / 4096;
         }
-        else {
-            savestate_size += writeAnArea(pmfd, pfd, spmfd, area, parent_state);
+        writers[w].area_count++;
+
+        /* Start the next group when this one has its share of pages */
+        if (((w+1) < writer_count) && (dumped_pages * writer_count >= total_pages * (w+1))) {
+            w++;
+            writers[w].maps_position = procSelfMaps.getPosition();
+            writers[w].pm_offset = pm_offset;
+            writers[w].pages_offset = pages_offset;
+        }
+    }
+    writer_count = w + 1;
+
+    /* Each writer needs its own parent savestate, because SaveState objects
+     * keep the position in the savestate files. We build them here, because
+     * helper threads cannot open files. When savestates are stored in RAM,
+     * we reopen the memfds to get independent file offsets. */
+    alignas(SaveState) char parent_storage[HelperThreads::MAX_THREADS][sizeof(SaveState)];
+    int parent_fds[HelperThreads::MAX_THREADS][2];
+    if (parent_state) {
+        for (int i = 1; i < writer_count; i++) {
+            if (shared_config.savestates_in_ram) {
+                char fdpath[64];
+                snprintf(fdpath, 64, "/proc/self/fd/%d", StateSlots::getPagemapFd(parent_ss_index));
+                NATIVECALL(parent_fds[i][0] = open(fdpath, O_RDONLY));
+                MYASSERT(parent_fds[i][0] != -1)
+                snprintf(fdpath, 64, "/proc/self/fd/%d", StateSlots::getPagesFd(parent_ss_index));
+                NATIVECALL(parent_fds[i][1] = open(fdpath, O_RDONLY));
+                MYASSERT(parent_fds[i][1] != -1)
+                writers[i].parent_state = new (parent_storage[i]) SaveState(parentpagemappath, parentpagespath, parent_fds[i][0], parent_fds[i][1]);
+            }
+            else {
+                writers[i].parent_state = new (parent_storage[i]) SaveState(parentpagemappath, parentpagespath, 0, 0);
+            }
+        }
+    }
+
+    /* Dump all memory areas. The first group is dumped by this thread */
+    for (int i = 1; i < writer_count; i++) {
+        HelperThreads::start(i-1, writeAreaGroup, &writers[i]);
+    }
+    writeAreaGroup(&writers[0]);
+    for (int i = 1; i < writer_count; i++) {
+        HelperThreads::join(i-1);
+    }
+
+    int errors = 0;
+    int io_errors = 0;
+    int io_error = 0;
+    size_t page_bytes = 0;
+    size_t stored_bytes = 0;
+    int new_pages = 0;
+    SavestateStats& stats = CheckpointStats::get();
+    for (int i = 0; i < writer_count; i++) {
+        savestate_size += writers[i].size;
+        savestate_syscalls += writers[i].syscalls;
+        errors += writers[i].errors;
+        if (writers[i].io_errors > 0) {
+            io_errors += writers[i].io_errors;
+            io_error = writers[i].io_error;
+        }
+        page_bytes += writers[i].page_bytes;
+        stored_bytes += writers[i].stored_bytes;
+        new_pages += writers[i].new_pages;
+
+        /* Writers run in parallel, so phase times add up to more than the
+         * time of the savestate when using several writers */
+        CheckpointStats::addTicks(CheckpointStats::PAGEMAP, writers[i].pagemap_ticks);
+        CheckpointStats::addTicks(CheckpointStats::SCAN, writers[i].scan_ticks);
+        CheckpointStats::addTicks(CheckpointStats::WRITE, writers[i].write_ticks);
+
+        /* Only count pages of the savestate, not the base savestate */
+        if (!base) {
+            stats.no_pages += writers[i].page_counts[Area::NO_PAGE];
+            stats.zero_pages += writers[i].page_counts[Area::ZERO_PAGE];
+            stats.base_pages += writers[i].page_counts[Area::BASE_PAGE];
+            stats.full_pages += writers[i].page_counts[Area::FULL_PAGE];
+            stats.parent_pages += writers[i].page_counts[Area::PARENT_PAGE];
+        }
+    }
+
+    if (sh.deduplicated) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_INFO, "Stored %d new pages out of %zu pages, page store now holds %u pages", new_pages, page_bytes / 4096, PageStore::pageCount());
+    }
+
+    if (sh.compressed && (stored_bytes > 0)) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_INFO, "Compressed %zu bytes of pages into %zu bytes (ratio %f)", page_bytes, stored_bytes, static_cast<double>(page_bytes) / stored_bytes);
+    }
+
+    if (errors > 0) {
+        /* This is not supposed to happen, the full pages were saved */
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "%d pages with soft-dirty cleared but no parent page !?", errors);
+    }
+
+    if (io_errors > 0) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "%d reads or writes of the savestate failed, last with errno %d", io_errors, io_error);
+    }
+
+    if (parent_state) {
+        for (int i = 1; i < writer_count; i++) {
+            writers[i].parent_state->~SaveState();
+            if (shared_config.savestates_in_ram) {
+                NATIVECALL(close(parent_fds[i][0]));
+                NATIVECALL(close(parent_fds[i][1]));
+            }
         }
     }
 
     /* Add the last null (eof) area */
     area.addr = nullptr; // End of data
     area.size = 0; // End of data
-    Utils::writeAll(pmfd, &area, sizeof(area));
+    Utils::pwriteAll(pmfd, &area, sizeof(area), pm_offset);
+    savestate_syscalls++;
     savestate_size += sizeof(area);
 
+    /* Write the index of areas and page flags, and update the header */
+    int area_count = 0;
+    for (int i = 0; i < writer_count; i++)
+        area_count += writers[i].area_count;
+    long index_size = StateIndex::write(pmfd, pm_offset + sizeof(area), area_count, sh);
+    if (index_size >= 0)
+        savestate_size += index_size;
+    else
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Writing the savestate index failed with errno %ld", -index_size);
+    Utils::pwriteAll(pmfd, &sh, sizeof(sh), 0);
+    savestate_syscalls++;
+
     if (shared_config.incremental_savestates) {
         /* Clear soft-dirty bits */
         Utils::writeAll(crfd, "4\n", 2);
@@ -975,7 +1523,7 @@ static size_t writeAllAreas(bool base)
     /* Recover area protection and advise */
     procSelfMaps.reset();
     while (procSelfMaps.getNextArea(&area)) {
-        if (!skipArea(&area)) {
+        if (!area.skip) {
             MYASSERT(mprotect(area.addr, area.size, area.prot) == 0)
             MYASSERT(madvise(area.addr, area.size, MADV_NORMAL) == 0);
         }
@@ -988,21 +1536,26 @@ static size_t writeAllAreas(bool base)
     NATIVECALL(close(spmfd));
 
     /* Closing the savestate files */
-    if (!shared_config.savestates_in_ram) {
+    if (!shared_config.savestates_in_ram && !async) {
         NATIVECALL(close(pmfd));
         NATIVECALL(close(pfd));
     }
 
     /* Rename the savestate files */
-    if (shared_config.incremental_savestates && !base) {
+    if (async) {
+        /* The helper thread closes and renames the files when done */
+        StateFlusher::start(current_ss_index, dst_pmfd, dst_pfd, temppagemappath, pagemappath, temppagespath, pagespath);
+    }
+    else if (shared_config.incremental_savestates && !base) {
         if (shared_config.savestates_in_ram) {
-            /* Closing the old savestate memfds and replace with the new one */
-            if (getPagemapFd(current_ss_index)) {
-                NATIVECALL(close(getPagemapFd(current_ss_index)));
-                NATIVECALL(close(getPagesFd(current_ss_index)));
-            }
-            setPagemapFd(current_ss_index, pmfd);
-            setPagesFd(current_ss_index, pfd);
+            /* Replace the old savestate with the new one. The old savestate
+             * is kept if the new one or other savestates depend on it */
+            int old_pmfd = StateSlots::getPagemapFd(current_ss_index);
+            StateChain::add(pmfd, pfd, chained ? parent_pmfd : 0);
+            StateSlots::setPagemapFd(current_ss_index, pmfd);
+            StateSlots::setPagesFd(current_ss_index, pfd);
+            if (old_pmfd)
+                StateChain::release(old_pmfd);
         }
         else {
             NATIVECALL(rename(temppagemappath, pagemappath));
@@ -1013,22 +1566,67 @@ static size_t writeAllAreas(bool base)
     return savestate_size;
 }
 
-/* Write a memory area into the savestate. Returns the size of the area in bytes */
-static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &parent_state)
+/* Write a buffer at the given offset of a savestate file. Writers only use
+ * raw syscalls, because errno is shared with the game thread. Failures are
+ * counted, to be reported after all writers are done. */
+static void writerPwrite(AreaWriter &writer, int fd, const void* buf, size_t count, off_t offset)
+{
+    long ret = RawSyscall::pwriteAll(fd, buf, count, offset);
+    if (ret != static_cast<long>(count)) {
+        writer.io_errors++;
+        writer.io_error = (ret < 0) ? -ret : ENOSPC;
+    }
+    writer.syscalls++;
+}
+
+/* Write a group of memory areas into the savestate. This function may be
+ * executed inside a helper thread, so it must not call any function that
+ * asserts, logs or sets errno. */
+static int writeAreaGroup(void* arg)
 {
-    area.print("Save");
-    size_t area_size = 0;
+    AreaWriter &writer = *static_cast<AreaWriter*>(arg);
+    uint64_t group_ticks = CheckpointStats::ticks();
+
+    /* Use our own copy of the memory mapping, starting at our first area */
+    ProcSelfMaps procSelfMaps = *writer.maps;
+    procSelfMaps.setPosition(writer.maps_position);
+
+    Area area;
+    for (int a = 0; a < writer.area_count; a++) {
+        procSelfMaps.getNextArea(&area);
+        if (area.skip) {
+            writerPwrite(writer, writer.pmfd, &area, sizeof(area), writer.pm_offset);
+            writer.pm_offset += sizeof(area);
+            writer.size += sizeof(area);
+        }
+        else {
+            writeAnArea(writer, area);
+        }
+    }
+
+    /* Write the remaining queued pages */
+    flushPageWrites(writer);
 
+    /* Everything that is not reading the pagemap or scanning pages is
+     * counted as writing */
+    writer.write_ticks = CheckpointStats::ticks() - group_ticks - writer.pagemap_ticks - writer.scan_ticks;
+
+    return 0;
+}
+
+/* Write a memory area into the savestate */
+static void writeAnArea(AreaWriter &writer, Area &area)
+{
     /* Save the position of the first area page in the pages file */
-    area.page_offset = lseek(pfd, 0, SEEK_CUR);
-    MYASSERT(area.page_offset != -1)
+    area.page_offset = writer.pages_offset;
 
     /* Write the area struct */
-    Utils::writeAll(pmfd, &area, sizeof(area));
-    area_size += sizeof(area);
+    writerPwrite(writer, writer.pmfd, &area, sizeof(area), writer.pm_offset);
+    writer.pm_offset += sizeof(area);
+    writer.size += sizeof(area);
 
-    /* Seek at the beginning of the area pagemap */
-    MYASSERT(-1 != lseek(spmfd, static_cast<off_t>(reinterpret_cast<uintptr_t>(area.addr) / (4096/8)), SEEK_SET));
+    /* Position of the area in the pagemap file */
+    off_t spm_offset = static_cast<off_t>(reinterpret_cast<uintptr_t>(area.addr) / (4096/8));
 
     /* Number of pages in the area */
     int nb_pages = area.size / 4096;
@@ -1048,35 +1646,78 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
     /* Current index in the savestate pagemap array */
     int ss_pagemap_i = 0;
 
+    /* Chunk of stored page sizes, when pages are compressed. They are
+     * written after all the page flags of the area */
+    uint16_t ss_sizes[4096];
+    off_t sizes_offset = writer.pm_offset + nb_pages;
+
+    SaveState &parent_state = *writer.parent_state;
+
     char* endAddr = static_cast<char*>(area.endAddr);
     for (char* curAddr = static_cast<char*>(area.addr); curAddr < endAddr; curAddr += 4096, page_i++) {
 
         /* We write a chunk of savestate pagemaps if it is full */
         if (ss_pagemap_i >= 4096) {
-            Utils::writeAll(pmfd, ss_pagemaps, 4096);
+            writerPwrite(writer, writer.pmfd, ss_pagemaps, 4096, writer.pm_offset);
+            writer.pm_offset += 4096;
+            writer.size += 4096;
+            if (writer.compressed) {
+                writerPwrite(writer, writer.pmfd, ss_sizes, 4096*sizeof(uint16_t), sizes_offset);
+                sizes_offset += 4096*sizeof(uint16_t);
+                writer.size += 4096*sizeof(uint16_t);
+            }
             ss_pagemap_i = 0;
-            area_size += 4096;
         }
 
+        /* Stored size of the current page, only non-zero for full pages */
+        ss_sizes[ss_pagemap_i] = 0;
+
         /* We read pagemap flags in chunks to avoid too many read syscalls. */
         if (pagemap_i >= 512) {
+            uint64_t pagemap_ticks = CheckpointStats::ticks();
             size_t remaining_pages = (nb_pages-page_i)>512?512:(nb_pages-page_i);
-            Utils::readAll(spmfd, pagemaps, remaining_pages*8);
+            long ret = RawSyscall::preadAll(writer.spmfd, pagemaps, remaining_pages*8, spm_offset + page_i*8);
+            if (ret != static_cast<long>(remaining_pages*8)) {
+                /* Save the unread pages as present and modified */
+                writer.io_errors++;
+                writer.io_error = (ret < 0) ? -ret : EIO;
+                for (size_t p = (ret > 0) ? (ret / 8) : 0; p < remaining_pages; p++)
+                    pagemaps[p] = (0x1ull << 63) | (0x1ull << 55);
+            }
+            writer.syscalls++;
             pagemap_i = 0;
+            writer.pagemap_ticks += CheckpointStats::ticks() - pagemap_ticks;
         }
 
         /* Gather the flag for the current pagemap. */
         uint64_t page = pagemaps[pagemap_i++];
         bool page_present = page & (0x1ull << 63);
-        bool soft_dirty = page & (0x1ull << 55);
+        bool soft_dirty = writer.all_dirty || (page & (0x1ull << 55));
+
+        /* Check if page is zero (only check on anonymous memory). Pages that
+         * will be stored in the page store are hashed in the same call. */
+        bool zero_page = false;
+        bool hashed = false;
+        uint64_t hash = 0;
+        if (page_present && (area.flags & MAP_ANONYMOUS)) {
+            uint64_t scan_ticks = CheckpointStats::ticks();
+            if (writer.deduplicated && (soft_dirty || !shared_config.incremental_savestates)) {
+                hash = Utils::hashPage(curAddr, zero_page);
+                hashed = true;
+            }
+            else {
+                zero_page = Utils::isZeroPage(curAddr);
+            }
+            writer.scan_ticks += CheckpointStats::ticks() - scan_ticks;
+        }
 
         /* Check if page is present */
         if (!page_present) {
             ss_pagemaps[ss_pagemap_i++] = Area::NO_PAGE;
         }
 
-        /* Check if page is zero (only check on anonymous memory)*/
-        else if ((area.flags & MAP_ANONYMOUS) && Utils::isZeroPage(static_cast<void*>(curAddr))) {
+        /* Check if page is zero */
+        else if (zero_page) {
             ss_pagemaps[ss_pagemap_i++] = Area::ZERO_PAGE;
         }
 
@@ -1087,17 +1728,22 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
                 char parent_flag = parent_state.getPageFlag(curAddr);
 
                 if (parent_flag == Area::NONE) {
-                    /* This is not supposed to happen, saving the full page */
-                    debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Area with soft-dirty cleared but no parent page !?");
+                    /* This is not supposed to happen, saving the full page.
+                     * We can't log from here, so it is reported later. */
+                    writer.errors++;
+                    ss_sizes[ss_pagemap_i] = queuePageWrite(writer, curAddr);
                     ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
-                    Utils::writeAll(pfd, static_cast<void*>(curAddr), 4096);
-                    area_size += 4096;
                 }
-                else if (parent_flag == Area::FULL_PAGE) {
-                    /* Parent state stores the memory page, we must store it too */
-                    ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
-                    Utils::writeAll(pfd, static_cast<void*>(curAddr), 4096);
-                    area_size += 4096;
+                else if ((parent_flag == Area::FULL_PAGE) || (parent_flag == Area::PARENT_PAGE)) {
+                    if (writer.chained) {
+                        /* Only reference the page of the parent state */
+                        ss_pagemaps[ss_pagemap_i++] = Area::PARENT_PAGE;
+                    }
+                    else {
+                        /* Parent state stores the memory page, we must store it too */
+                        ss_sizes[ss_pagemap_i] = queuePageWrite(writer, curAddr);
+                        ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
+                    }
                 }
                 else {
                     ss_pagemaps[ss_pagemap_i++] = parent_flag;
@@ -1108,17 +1754,123 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
             }
         }
         else {
+            ss_sizes[ss_pagemap_i] = queuePageWrite(writer, curAddr, hashed ? &hash : nullptr);
             ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
-            Utils::writeAll(pfd, static_cast<void*>(curAddr), 4096);
-            area_size += 4096;
         }
+
+        writer.page_counts[static_cast<int>(ss_pagemaps[ss_pagemap_i-1])]++;
     }
 
     /* Writing the last savestate pagemap chunk */
-    Utils::writeAll(pmfd, ss_pagemaps, ss_pagemap_i);
-    area_size += ss_pagemap_i;
+    writerPwrite(writer, writer.pmfd, ss_pagemaps, ss_pagemap_i, writer.pm_offset);
+    writer.pm_offset += ss_pagemap_i;
+    writer.size += ss_pagemap_i;
+
+    if (writer.compressed) {
+        writerPwrite(writer, writer.pmfd, ss_sizes, ss_pagemap_i*sizeof(uint16_t), sizes_offset);
+        writer.pm_offset = sizes_offset + ss_pagemap_i*sizeof(uint16_t);
+        writer.size += ss_pagemap_i*sizeof(uint16_t);
+    }
+}
+
+/* Queue a memory page to be written into the pages file, compressing it or
+ * storing it in the page store if enabled. `hash` is the hash of the page if
+ * already computed. Returns the size of what was written in the pages file. */
+static uint16_t queuePageWrite(AreaWriter &writer, char* addr, const uint64_t* hash)
+{
+    writer.page_bytes += 4096;
 
-    return area_size;
+    if (writer.deduplicated) {
+        /* Make room for the page id */
+        if ((writer.iovec_count == writer.max_iovecs) ||
+            ((writer.buffer_used + sizeof(uint32_t)) > writer.buffer_size)) {
+            flushPageWrites(writer);
+        }
+
+        uint32_t* id = reinterpret_cast<uint32_t*>(writer.buffer + writer.buffer_used);
+        *id = PageStore::storePage(addr, hash ? *hash : Utils::hashPage(addr), writer.new_pages);
+        if (!*id) {
+            /* The page is lost and will be loaded as a zero page */
+            writer.io_errors++;
+            writer.io_error = EIO;
+        }
+        writer.buffer_used += sizeof(uint32_t);
+        queueBuffer(writer, reinterpret_cast<char*>(id), sizeof(uint32_t));
+        return sizeof(uint32_t);
+    }
+
+#ifdef LIBTAS_HAS_LZ4
+    if (writer.compressed) {
+        /* Make room for the compressed page */
+        if ((writer.iovec_count == writer.max_iovecs) ||
+            ((writer.buffer_used + 4096) > writer.buffer_size)) {
+            flushPageWrites(writer);
+        }
+
+        /* Store the page uncompressed if the compressed page is not smaller */
+        char* dst = writer.buffer + writer.buffer_used;
+        int csize = LZ4_compress_default(addr, dst, 4096, 4095);
+        if (csize > 0) {
+            writer.buffer_used += csize;
+            queueBuffer(writer, dst, csize);
+            return csize;
+        }
+    }
+#endif
+
+    queueBuffer(writer, addr, 4096);
+    return 4096;
+}
+
+/* Queue a buffer to be written into the pages file. Contiguous buffers
+ * are merged together, and buffers are written using pwritev when the
+ * staging array is full. */
+static void queueBuffer(AreaWriter &writer, char* buf, size_t size)
+{
+    writer.stored_bytes += size;
+    writer.size += size;
+
+    if (writer.iovec_count > 0) {
+        struct iovec &last = writer.iovecs[writer.iovec_count-1];
+        if ((static_cast<char*>(last.iov_base) + last.iov_len) == buf) {
+            last.iov_len += size;
+            writer.pages_offset += size;
+            return;
+        }
+
+        if (writer.iovec_count == writer.max_iovecs) {
+            flushPageWrites(writer);
+        }
+    }
+
+    if (writer.iovec_count == 0) {
+        writer.iovec_offset = writer.pages_offset;
+    }
+
+    writer.iovecs[writer.iovec_count].iov_base = static_cast<void*>(buf);
+    writer.iovecs[writer.iovec_count].iov_len = size;
+    writer.iovec_count++;
+    writer.pages_offset += size;
+}
+
+/* Write all queued memory pages into the pages file */
+static void flushPageWrites(AreaWriter &writer)
+{
+    if (writer.iovec_count == 0)
+        return;
+
+    size_t count = 0;
+    for (int i = 0; i < writer.iovec_count; i++)
+        count += writer.iovecs[i].iov_len;
+
+    long ret = RawSyscall::pwritevAll(writer.pfd, writer.iovecs, writer.iovec_count, writer.iovec_offset);
+    if (ret != static_cast<long>(count)) {
+        writer.io_errors++;
+        writer.io_error = (ret < 0) ? -ret : ENOSPC;
+    }
+    writer.syscalls++;
+    writer.iovec_count = 0;
+    writer.buffer_used = 0;
 }
 
 }
@@ -35,6 +35,9 @@ namespace Checkpoint
 
     void setCurrentToParent();
 
+    /* Drop the current savestate */
+    void dropSavestate();
+
     bool checkCheckpoint();
     bool checkRestore();
     void handler(int signum);
@@ -0,0 +1,117 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CheckpointStats.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include "../TimeHolder.h"
+#include <time.h>
+
+namespace libtas {
+
+struct StatsState {
+    SavestateStats stats;
+    uint64_t phase_ticks[CheckpointStats::PHASE_COUNT];
+    uint64_t start_ticks;
+    TimeHolder start_time;
+
+    /* An operation was started */
+    bool started;
+
+    /* An operation has ended and was not reported yet */
+    bool pending;
+};
+
+static StatsState* getState()
+{
+    static_assert(sizeof(StatsState) <= ReservedMemory::STATS_SIZE, "Savestate stats do not fit in reserved memory");
+    return static_cast<StatsState*>(ReservedMemory::getAddr(ReservedMemory::STATS_ADDR));
+}
+
+void CheckpointStats::start(int operation)
+{
+    StatsState* st = getState();
+
+    st->stats = SavestateStats();
+    st->stats.operation = operation;
+    for (int p = 0; p < PHASE_COUNT; p++)
+        st->phase_ticks[p] = 0;
+
+    st->started = true;
+    st->start_ticks = ticks();
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &st->start_time));
+}
+
+void CheckpointStats::setIndex(int index)
+{
+    getState()->stats.index = index;
+}
+
+void CheckpointStats::addTicks(Phase phase, uint64_t ticks)
+{
+    getState()->phase_ticks[phase] += ticks;
+}
+
+SavestateStats& CheckpointStats::get()
+{
+    return getState()->stats;
+}
+
+void CheckpointStats::finish()
+{
+    StatsState* st = getState();
+    if (!st->started)
+        return;
+
+    uint64_t end_ticks = ticks();
+    TimeHolder end_time;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &end_time));
+    TimeHolder delta_time = end_time - st->start_time;
+
+    SavestateStats& stats = st->stats;
+    stats.total_time = delta_time.tv_sec + ((double)delta_time.tv_nsec) / 1000000000.0;
+
+    double seconds_per_tick = 0;
+    if (end_ticks > st->start_ticks)
+        seconds_per_tick = stats.total_time / (end_ticks - st->start_ticks);
+
+    stats.suspend_time = st->phase_ticks[SUSPEND] * seconds_per_tick;
+    stats.maps_time = st->phase_ticks[MAPS] * seconds_per_tick;
+    stats.pagemap_time = st->phase_ticks[PAGEMAP] * seconds_per_tick;
+    stats.scan_time = st->phase_ticks[SCAN] * seconds_per_tick;
+    stats.write_time = st->phase_ticks[WRITE] * seconds_per_tick;
+    stats.restore_time = st->phase_ticks[RESTORE] * seconds_per_tick;
+    stats.resume_time = st->phase_ticks[RESUME] * seconds_per_tick;
+
+    st->started = false;
+    st->pending = true;
+}
+
+bool CheckpointStats::pollStats(SavestateStats &stats)
+{
+    StatsState* st = getState();
+    if (!st->pending)
+        return false;
+
+    stats = st->stats;
+    st->pending = false;
+    return true;
+}
+
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_CHECKPOINTSTATS_H
+#define LIBTAS_CHECKPOINTSTATS_H
+
+#include <cstdint>
+#include "../../shared/SavestateStats.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Statistics of the current savestate or state loading. They are kept in our
+ * reserved memory, because a state loading starts and ends in different
+ * memory states.
+ *
+ * Phases are timed using the timestamp counter, which is cheap enough to be
+ * read for each page and can be read from helper threads. Ticks are converted
+ * into seconds at the end, using the total time of the operation.
+ */
+
+namespace libtas {
+namespace CheckpointStats
+{
+    enum Phase {
+        SUSPEND,
+        MAPS,
+        PAGEMAP,
+        SCAN,
+        WRITE,
+        RESTORE,
+        RESUME,
+        PHASE_COUNT,
+    };
+
+    inline uint64_t ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    /* Start gathering statistics of an operation */
+    void start(int operation);
+
+    /* Set the savestate index of the operation */
+    void setIndex(int index);
+
+    /* Add ticks spent in a phase */
+    void addTicks(Phase phase, uint64_t ticks);
+
+    /* Get the statistics to fill page counts and size */
+    SavestateStats& get();
+
+    /* End the operation, and compute phase times */
+    void finish();
+
+    /* Returns if an operation has ended since the last call, with its
+     * statistics */
+    bool pollStats(SavestateStats &stats);
+};
+}
+
+#endif
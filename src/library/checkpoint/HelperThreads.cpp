@@ -0,0 +1,78 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HelperThreads.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include <sched.h> // clone
+#include <csignal>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace libtas {
+
+static const size_t stack_size = ReservedMemory::HELPER_STACKS_SIZE / HelperThreads::MAX_THREADS;
+
+/* The tid of each helper thread is stored in our reserved memory, so that
+ * it is preserved when loading a savestate. The kernel clears it and wakes
+ * any waiter when the thread terminates. */
+static volatile pid_t* getTid(int index)
+{
+    return static_cast<volatile pid_t*>(ReservedMemory::getAddr(ReservedMemory::HELPER_TIDS_ADDR)) + index;
+}
+
+void HelperThreads::start(int index, int (*fn)(void*), void* arg)
+{
+    MYASSERT((index >= 0) && (index < MAX_THREADS))
+    MYASSERT(!isRunning(index))
+
+    /* Stacks grow downward, so we pass the end of the stack */
+    void* stack = ReservedMemory::getAddr(ReservedMemory::HELPER_STACKS_ADDR + (index + 1) * stack_size);
+
+    /* Block all signals, so that the helper thread inherits the full mask */
+    sigset_t all_mask, old_mask;
+    sigfillset(&all_mask);
+    NATIVECALL(pthread_sigmask(SIG_SETMASK, &all_mask, &old_mask));
+
+    volatile pid_t* tid = getTid(index);
+    int flags = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD |
+        CLONE_SYSVSEM | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID;
+    int ret = clone(fn, stack, flags, arg, tid, nullptr, tid);
+
+    NATIVECALL(pthread_sigmask(SIG_SETMASK, &old_mask, nullptr));
+
+    MYASSERT(ret != -1)
+}
+
+void HelperThreads::join(int index)
+{
+    volatile pid_t* tid = getTid(index);
+    pid_t cur_tid;
+    while ((cur_tid = *tid) != 0) {
+        syscall(SYS_futex, tid, FUTEX_WAIT, cur_tid, nullptr, nullptr, 0);
+    }
+}
+
+bool HelperThreads::isRunning(int index)
+{
+    return (*getTid(index) != 0);
+}
+
+}
@@ -0,0 +1,57 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_HELPERTHREADS_H
+#define LIBTAS_HELPERTHREADS_H
+
+/* Helper threads are raw threads created with clone(), running on stacks
+ * located in our reserved memory. They are not known by the ThreadManager,
+ * they don't allocate any memory and they don't get saved in savestates.
+ *
+ * Because they share the thread-local storage of the thread that created
+ * them, the function they run must not use any thread-local variable,
+ * which includes hooked functions, logging and NATIVECALL. Note that errno
+ * is also shared, so system calls must be issued using RawSyscall, which
+ * never writes errno.
+ * All signals are blocked inside helper threads.
+ *
+ * Savestate writers use all threads but the last one, which runs the
+ * background work happening between savestate operations: the savestate
+ * flusher, the lazy restore and the compaction of delta chains.
+ */
+
+namespace libtas {
+namespace HelperThreads
+{
+    enum {
+        MAX_THREADS = 8,
+    };
+
+    /* Start the helper thread at the given index, running fn(arg) */
+    void start(int index, int (*fn)(void*), void* arg);
+
+    /* Wait for the helper thread at the given index to terminate */
+    void join(int index);
+
+    /* Returns if the helper thread at the given index is running */
+    bool isRunning(int index);
+};
+}
+
+#endif
@@ -0,0 +1,605 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LazyRestore.h"
+#include "HelperThreads.h"
+#include "PageStore.h"
+#include "RawSyscall.h"
+#include "ReservedMemory.h"
+#include "StateChain.h"
+#include "../logging.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef LIBTAS_HAS_LZ4
+#include <lz4.h>
+#endif
+
+namespace libtas {
+
+/* The lazy restore runs between two savestate operations, and so does the
+ * savestate flusher. Because each savestate operation waits for both,
+ * they can share the same helper thread. */
+static const int lazy_thread = HelperThreads::MAX_THREADS - 1;
+
+enum {
+    /* The loading savestate, the base savestate and the ancestors of the
+     * loading savestate in its delta chain */
+    MAX_SOURCES = 2 + StateChain::MAX_DEPTH,
+    MAX_AREAS = 4096,
+    MAX_PINNED_PAGES = 3,
+    MAX_RETRIED_FAULTS = 64,
+    /* Number of contiguous pages loaded at once */
+    BATCH_PAGES = 16,
+};
+
+enum EntryState : uint8_t {
+    PENDING,
+    LOADED,
+    DISCARDED,
+};
+
+struct LazySource {
+    int fd;
+    bool compressed;
+    bool deduplicated;
+};
+
+/* Page to be loaded. Entries are sorted by address */
+struct LazyEntry {
+    char* addr;
+    off_t offset;
+    uint16_t size;
+    uint8_t source;
+    uint8_t state;
+};
+
+struct LazyArea {
+    char* addr;
+    char* endAddr;
+};
+
+/* State of the lazy restore, located in our reserved memory. The mapping
+ * holding page entries is backed by a memfd, mapped inside the region
+ * reserved for growable tables. */
+struct LazyState {
+    /* Pages can be added to the restore */
+    bool active;
+
+    /* All areas were registered, the helper thread can load pages */
+    bool ready;
+
+    int uffd;
+    int pool_fd;
+
+    int table_fd;
+    LazyEntry* entries;
+    size_t capacity;
+    size_t count;
+
+    /* Number of entries in the PENDING state */
+    size_t pending;
+
+    /* All entries before this index are not pending */
+    size_t cursor;
+
+    LazySource sources[MAX_SOURCES];
+    int source_count;
+
+    LazyArea areas[MAX_AREAS];
+    int area_count;
+
+    const char* pinned_pages[MAX_PINNED_PAGES];
+
+    /* Faulting pages that could not be filled because of a layout change
+     * that was not read yet */
+    char* retried_faults[MAX_RETRIED_FAULTS];
+    int retried_count;
+
+    /* Buffers receiving pages before they are copied into place */
+    char buffer[BATCH_PAGES*4096];
+    char compressed_buffer[4096];
+};
+
+static LazyState* getState()
+{
+    static_assert(sizeof(LazyState) <= ReservedMemory::LAZY_SIZE, "Lazy restore state does not fit in reserved memory");
+    return static_cast<LazyState*>(ReservedMemory::getAddr(ReservedMemory::LAZY_ADDR));
+}
+
+static int openUserfaultfd()
+{
+    int uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+
+#ifdef USERFAULTFD_IOC_NEW
+    /* Unprivileged processes may only use the userfaultfd device */
+    if (uffd == -1) {
+        int devfd;
+        NATIVECALL(devfd = open("/dev/userfaultfd", O_RDWR | O_CLOEXEC));
+        if (devfd != -1) {
+            uffd = syscall(SYS_ioctl, devfd, USERFAULTFD_IOC_NEW, O_CLOEXEC | O_NONBLOCK);
+            NATIVECALL(close(devfd));
+        }
+    }
+#endif
+
+    if (uffd == -1)
+        return -1;
+
+    /* We need to be notified of layout changes of registered areas, so that
+     * we don't fill pages that the game has discarded or moved. We don't
+     * restrict faults to user mode, because the game can pass lazy pages to
+     * system calls. */
+    struct uffdio_api api;
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_EVENT_REMAP | UFFD_FEATURE_EVENT_REMOVE | UFFD_FEATURE_EVENT_UNMAP;
+    if ((syscall(SYS_ioctl, uffd, UFFDIO_API, &api) != 0) ||
+        !(api.ioctls & (1ull << _UFFDIO_REGISTER))) {
+        NATIVECALL(close(uffd));
+        return -1;
+    }
+
+    return uffd;
+}
+
+void LazyRestore::init()
+{
+    LazyState* st = getState();
+
+    st->active = false;
+    if (!shared_config.savestates_lazy)
+        return;
+
+    st->uffd = openUserfaultfd();
+    if (st->uffd == -1) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "userfaultfd is not available, savestates are loaded entirely");
+        return;
+    }
+
+    if (!st->table_fd) {
+        st->table_fd = syscall(SYS_memfd_create, "lazyrestore", 0);
+        MYASSERT(st->table_fd != -1)
+    }
+
+    st->pool_fd = PageStore::getPoolFd();
+    st->count = 0;
+    st->source_count = 0;
+    st->area_count = 0;
+    st->retried_count = 0;
+    st->ready = false;
+
+    /* The helper thread accesses the stack guard and other fields of the
+     * thread control block, and errno when a call fails */
+    const char* tcb = reinterpret_cast<const char*>(pthread_self());
+    st->pinned_pages[0] = reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(tcb) & ~static_cast<uintptr_t>(4095));
+    st->pinned_pages[1] = st->pinned_pages[0] + 4096;
+    st->pinned_pages[2] = reinterpret_cast<const char*>(reinterpret_cast<uintptr_t>(&errno) & ~static_cast<uintptr_t>(4095));
+
+    st->active = true;
+}
+
+bool LazyRestore::isLazyArea(const Area& area)
+{
+    LazyState* st = getState();
+
+    if (!st->active || (st->area_count == MAX_AREAS))
+        return false;
+
+    /* Shared mappings cannot be registered in missing mode, and discarded
+     * pages of file mappings are loaded from their file. The main stack is
+     * not anonymous, because it is named [stack]. */
+    if (!(area.flags & MAP_PRIVATE) || !(area.prot & PROT_WRITE))
+        return false;
+
+    return (area.flags & MAP_ANONYMOUS) || (strcmp(area.name, "[heap]") == 0);
+}
+
+bool LazyRestore::isPinnedPage(const char* addr)
+{
+    LazyState* st = getState();
+
+    for (int i = 0; i < MAX_PINNED_PAGES; i++)
+        if (addr == st->pinned_pages[i])
+            return true;
+    return false;
+}
+
+int LazyRestore::addSource(int pfd, bool compressed, bool deduplicated)
+{
+    LazyState* st = getState();
+    MYASSERT(st->source_count < MAX_SOURCES)
+
+    LazySource& source = st->sources[st->source_count];
+    NATIVECALL(source.fd = dup(pfd));
+    MYASSERT(source.fd != -1)
+    source.compressed = compressed;
+    source.deduplicated = deduplicated;
+    return st->source_count++;
+}
+
+static void growTable(LazyState* st)
+{
+    size_t capacity = st->capacity ? 2 * st->capacity : 65536;
+    size_t size = capacity * sizeof(LazyEntry);
+    MYASSERT(ftruncate(st->table_fd, size) == 0)
+
+    void* addr = ReservedMemory::mapTable(ReservedMemory::LAZY_TABLE, st->table_fd, size);
+    MYASSERT(addr != nullptr)
+
+    st->entries = static_cast<LazyEntry*>(addr);
+    st->capacity = capacity;
+}
+
+void LazyRestore::addPage(char* addr, int source, off_t offset, uint16_t size)
+{
+    LazyState* st = getState();
+
+    if (st->count == st->capacity)
+        growTable(st);
+
+    LazyEntry& entry = st->entries[st->count++];
+    entry.addr = addr;
+    entry.offset = offset;
+    entry.size = size;
+    entry.source = source;
+    entry.state = PENDING;
+}
+
+void LazyRestore::addArea(void* addr, void* endAddr)
+{
+    LazyState* st = getState();
+    MYASSERT(st->area_count < MAX_AREAS)
+
+    st->areas[st->area_count].addr = static_cast<char*>(addr);
+    st->areas[st->area_count].endAddr = static_cast<char*>(endAddr);
+    st->area_count++;
+}
+
+/* Read the content of a page into `buf`. Functions below are executed by
+ * the helper thread, so they must not access memory outside of the lazy
+ * state. Hooked functions like ioctl() or close() are bypassed, and all
+ * syscalls are issued using RawSyscall, because errno is shared with the
+ * game thread. */
+static bool readPage(LazyState* st, const LazyEntry& entry, char* buf)
+{
+    const LazySource& source = st->sources[entry.source];
+
+    if (source.deduplicated) {
+        uint32_t id;
+        if (RawSyscall::preadAll(source.fd, &id, sizeof(id), entry.offset) != sizeof(id))
+            return false;
+        return RawSyscall::preadAll(st->pool_fd, buf, 4096, static_cast<off_t>(id) * 4096) == 4096;
+    }
+
+    if (source.compressed && (entry.size != 4096)) {
+#ifdef LIBTAS_HAS_LZ4
+        if (RawSyscall::preadAll(source.fd, st->compressed_buffer, entry.size, entry.offset) != entry.size)
+            return false;
+        return LZ4_decompress_safe(st->compressed_buffer, buf, entry.size, 4096) == 4096;
+#else
+        return false;
+#endif
+    }
+
+    return RawSyscall::preadAll(source.fd, buf, 4096, entry.offset) == 4096;
+}
+
+static void setEntryState(LazyState* st, LazyEntry& entry, uint8_t state)
+{
+    if (entry.state == PENDING)
+        st->pending--;
+    entry.state = state;
+}
+
+/* Load a run of at most `max` contiguous pending pages starting at entry `i`
+ * and copy them at `dst`, which is the address of the entry unless the area
+ * was moved. */
+static void copyPages(LazyState* st, size_t i, int max, char* dst)
+{
+    int n = 0;
+    while ((n < max) && ((i+n) < st->count) &&
+        (st->entries[i+n].state == PENDING) &&
+        (st->entries[i+n].addr == st->entries[i].addr + n*4096)) {
+        /* Pages that cannot be read are left zeroed instead of leaving the
+         * game waiting forever */
+        if (!readPage(st, st->entries[i+n], st->buffer + n*4096))
+            memset(st->buffer + n*4096, 0, 4096);
+        n++;
+    }
+
+    if (n == 0)
+        return;
+
+    struct uffdio_copy copy;
+    copy.dst = reinterpret_cast<uintptr_t>(dst);
+    copy.src = reinterpret_cast<uintptr_t>(st->buffer);
+    copy.len = n * 4096;
+    copy.mode = 0;
+    copy.copy = 0;
+    RawSyscall::ioctl(st->uffd, UFFDIO_COPY, &copy);
+
+    /* The number of copied bytes, or -errno, is stored in the structure */
+    int copied = (copy.copy > 0) ? (copy.copy / 4096) : 0;
+    for (int j = 0; j < copied; j++)
+        setEntryState(st, st->entries[i+j], LOADED);
+
+    /* Layout changes must be read before copying again. Otherwise we give up
+     * on the page, so that we always make progress. */
+    if ((copied < n) && (copy.copy != -EAGAIN))
+        setEntryState(st, st->entries[i+copied], DISCARDED);
+}
+
+/* Returns the index of the first entry at or after `addr` */
+static size_t findEntry(LazyState* st, const char* addr, size_t low, size_t high)
+{
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (st->entries[mid].addr < addr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static size_t findEntry(LazyState* st, const char* addr)
+{
+    return findEntry(st, addr, 0, st->count);
+}
+
+static void discardPages(LazyState* st, const char* start, const char* end)
+{
+    for (size_t i = findEntry(st, start); (i < st->count) && (st->entries[i].addr < end); i++)
+        setEntryState(st, st->entries[i], DISCARDED);
+}
+
+/* Pages were moved to a new registered area. We change the address of their
+ * entries, and move them to keep the table sorted. */
+static void relocatePages(LazyState* st, char* from, char* to, size_t len)
+{
+    /* Entries of the destination were discarded when it was unmapped */
+    size_t first = findEntry(st, to);
+    size_t last = findEntry(st, to + len);
+    if (first < last) {
+        for (size_t i = first; i < last; i++)
+            setEntryState(st, st->entries[i], DISCARDED);
+        std::move(st->entries + last, st->entries + st->count, st->entries + first);
+        st->count -= last - first;
+        st->cursor = std::min(st->cursor, first);
+    }
+
+    first = findEntry(st, from);
+    last = findEntry(st, from + len);
+    if (first == last)
+        return;
+
+    for (size_t i = first; i < last; i++)
+        st->entries[i].addr = to + (st->entries[i].addr - from);
+
+    if (to < from) {
+        size_t pos = findEntry(st, to, 0, first);
+        std::rotate(st->entries + pos, st->entries + first, st->entries + last);
+        st->cursor = std::min(st->cursor, pos);
+    }
+    else {
+        size_t pos = findEntry(st, to, last, st->count);
+        std::rotate(st->entries + first, st->entries + last, st->entries + pos);
+        st->cursor = std::min(st->cursor, first);
+    }
+}
+
+static void retryFault(LazyState* st, char* page)
+{
+    /* Otherwise the page will be filled when it gets prefetched */
+    if (st->retried_count < MAX_RETRIED_FAULTS)
+        st->retried_faults[st->retried_count++] = page;
+}
+
+static void handleFault(LazyState* st, char* page)
+{
+    size_t i = findEntry(st, page);
+    bool found = (i < st->count) && (st->entries[i].addr == page);
+
+    if (found && (st->entries[i].state == PENDING)) {
+        /* Also load the following pages, they will probably be accessed */
+        copyPages(st, i, BATCH_PAGES, page);
+        if (st->entries[i].state == PENDING)
+            retryFault(st, page);
+        if (st->entries[i].state != DISCARDED)
+            return;
+    }
+
+    if (found && (st->entries[i].state == LOADED)) {
+        /* Page was loaded after the fault was raised */
+        struct uffdio_range range;
+        range.start = reinterpret_cast<uintptr_t>(page);
+        range.len = 4096;
+        RawSyscall::ioctl(st->uffd, UFFDIO_WAKE, &range);
+        return;
+    }
+
+    /* Page was discarded by the game or was not present in the savestate */
+    struct uffdio_zeropage zeropage;
+    zeropage.range.start = reinterpret_cast<uintptr_t>(page);
+    zeropage.range.len = 4096;
+    zeropage.mode = 0;
+    zeropage.zeropage = 0;
+    RawSyscall::ioctl(st->uffd, UFFDIO_ZEROPAGE, &zeropage);
+    if (zeropage.zeropage == -EAGAIN) {
+        retryFault(st, page);
+    }
+    else if (zeropage.zeropage != 4096) {
+        struct uffdio_range range = zeropage.range;
+        RawSyscall::ioctl(st->uffd, UFFDIO_WAKE, &range);
+    }
+}
+
+static void handleMessage(LazyState* st, const struct uffd_msg& msg)
+{
+    switch (msg.event) {
+        case UFFD_EVENT_PAGEFAULT:
+            handleFault(st, reinterpret_cast<char*>(msg.arg.pagefault.address & ~static_cast<uint64_t>(4095)));
+            break;
+        case UFFD_EVENT_REMAP:
+            relocatePages(st, reinterpret_cast<char*>(msg.arg.remap.from),
+                reinterpret_cast<char*>(msg.arg.remap.to), msg.arg.remap.len);
+            break;
+        case UFFD_EVENT_REMOVE:
+        case UFFD_EVENT_UNMAP:
+            discardPages(st, reinterpret_cast<char*>(msg.arg.remove.start),
+                reinterpret_cast<char*>(msg.arg.remove.end));
+            break;
+        default:
+            break;
+    }
+}
+
+static int loadLazyPages(void* arg)
+{
+    LazyState* st = static_cast<LazyState*>(arg);
+
+    while (!__atomic_load_n(&st->ready, __ATOMIC_ACQUIRE))
+        RawSyscall::schedYield();
+
+    while (st->pending > 0) {
+        /* Serve faults and layout changes first */
+        struct pollfd pfd;
+        pfd.fd = st->uffd;
+        pfd.events = POLLIN;
+        while ((RawSyscall::poll(&pfd, 1, 0) > 0) && (pfd.revents & POLLIN)) {
+            struct uffd_msg msgs[16];
+            long size = RawSyscall::read(st->uffd, msgs, sizeof(msgs));
+            if (size <= 0)
+                break;
+            for (size_t m = 0; m < (size / sizeof(struct uffd_msg)); m++)
+                handleMessage(st, msgs[m]);
+        }
+
+        /* Faults are retried after reading layout changes. Retried faults
+         * are stored again at lower indices than the ones being read. */
+        int retried_count = st->retried_count;
+        st->retried_count = 0;
+        for (int r = 0; r < retried_count; r++) {
+            char* page = st->retried_faults[r];
+            handleFault(st, page);
+        }
+
+        /* Then load the next pending pages in address order */
+        while ((st->cursor < st->count) && (st->entries[st->cursor].state != PENDING))
+            st->cursor++;
+        if (st->cursor == st->count)
+            break;
+        copyPages(st, st->cursor, BATCH_PAGES, st->entries[st->cursor].addr);
+    }
+
+    /* Closing the userfaultfd unregisters all areas */
+    RawSyscall::close(st->uffd);
+    for (int s = 0; s < st->source_count; s++)
+        RawSyscall::close(st->sources[s].fd);
+
+    return 0;
+}
+
+static void closeFds(LazyState* st)
+{
+    NATIVECALL(close(st->uffd));
+    for (int s = 0; s < st->source_count; s++)
+        NATIVECALL(close(st->sources[s].fd));
+}
+
+/* Load pages directly, when their area could not be registered */
+static void loadPages(LazyState* st, size_t first, size_t last)
+{
+    for (size_t i = first; i < last; i++) {
+        LazyEntry& entry = st->entries[i];
+        if (!readPage(st, entry, entry.addr))
+            memset(entry.addr, 0, 4096);
+        setEntryState(st, entry, LOADED);
+    }
+}
+
+void LazyRestore::start()
+{
+    LazyState* st = getState();
+
+    if (!st->active)
+        return;
+    st->active = false;
+
+    if (st->count == 0) {
+        closeFds(st);
+        return;
+    }
+
+    debuglogstdio(LCF_CHECKPOINT, "Loading %zu pages lazily", st->count);
+
+    st->pending = st->count;
+    st->cursor = 0;
+    HelperThreads::start(lazy_thread, loadLazyPages, st);
+
+    /* From now on, we must not access any memory of the game until all
+     * areas are registered, because discarded pages would be filled
+     * with zeros. This includes logging. */
+    size_t e = 0;
+    for (int a = 0; a < st->area_count; a++) {
+        const LazyArea& area = st->areas[a];
+
+        size_t first = e;
+        while ((e < st->count) && (st->entries[e].addr < area.endAddr))
+            e++;
+        if (first == e)
+            continue;
+
+        /* Discard the current content of lazy pages, so that accessing
+         * them raises a missing page fault */
+        size_t run = first;
+        for (size_t i = first + 1; i <= e; i++) {
+            if ((i == e) || (st->entries[i].addr != st->entries[i-1].addr + 4096)) {
+                madvise(st->entries[run].addr, st->entries[i-1].addr + 4096 - st->entries[run].addr, MADV_DONTNEED);
+                run = i;
+            }
+        }
+
+        struct uffdio_register reg;
+        reg.range.start = reinterpret_cast<uintptr_t>(area.addr);
+        reg.range.len = area.endAddr - area.addr;
+        reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+        if ((syscall(SYS_ioctl, st->uffd, UFFDIO_REGISTER, &reg) != 0) ||
+            !(reg.ioctls & (1ull << _UFFDIO_COPY))) {
+            loadPages(st, first, e);
+        }
+    }
+
+    __atomic_store_n(&st->ready, true, __ATOMIC_RELEASE);
+}
+
+void LazyRestore::wait()
+{
+    HelperThreads::join(lazy_thread);
+}
+
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_LAZYRESTORE_H
+#define LIBTAS_LAZYRESTORE_H
+
+#include <cstdint>
+#include <sys/types.h>
+#include "ProcMapsArea.h"
+
+/* Lazy restore of savestate pages. Instead of reading all pages when loading
+ * a savestate, pages of private anonymous areas are discarded and registered
+ * to a userfaultfd. A helper thread then loads each page from the savestate
+ * when it is first accessed, and loads all remaining pages in background.
+ *
+ * The helper thread shares the TLS of the thread performing the restore,
+ * so the pages holding its thread control block and errno are always loaded
+ * eagerly. It only accesses our reserved memory and the page table, which is
+ * a separate mapping that is not saved.
+ */
+
+namespace libtas {
+namespace LazyRestore
+{
+    /* Prepare a lazy restore, if enabled and if userfaultfd is available.
+     * Must be called when no lazy restore is in progress. */
+    void init();
+
+    /* Returns if pages of the saved area can be loaded lazily */
+    bool isLazyArea(const Area& area);
+
+    /* Returns if the page must be loaded eagerly in a lazy area */
+    bool isPinnedPage(const char* addr);
+
+    /* Register the file descriptor of a savestate pages file, which is
+     * duplicated. Returns the source index to pass to addPage(). */
+    int addSource(int pfd, bool compressed, bool deduplicated);
+
+    /* Register a page to be loaded lazily from a source, at an offset and
+     * of size `size` in the pages file. Pages must be added in increasing
+     * address order. */
+    void addPage(char* addr, int source, off_t offset, uint16_t size);
+
+    /* Register a lazy area, after all its pages were added */
+    void addArea(void* addr, void* endAddr);
+
+    /* Discard the current content of lazy pages and start loading them */
+    void start();
+
+    /* Wait for all lazy pages to be loaded */
+    void wait();
+};
+}
+
+#endif
@@ -0,0 +1,327 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PageStore.h"
+#include "RawSyscall.h"
+#include "ReservedMemory.h"
+#include "../Utils.h"
+#include "../logging.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/falloc.h>
+#include <cstring>
+
+namespace libtas {
+
+/* Entry of a stored page, indexed by its page id */
+struct PageEntry {
+    uint64_t hash;
+    uint32_t refcount;
+    uint32_t next_free; // next free page id when the entry is free
+};
+
+/* State of the page store, located in our reserved memory. The mapping
+ * holding page entries followed by the hash index of page ids is backed by
+ * a memfd, mapped inside the region reserved for growable tables. Page ids
+ * start at one, zero being used for empty slots in the hash index and for
+ * missing pages in savestate files. */
+struct PageStoreState {
+    int pool_fd;
+    int table_fd;
+    PageEntry* entries;
+    uint32_t* index;
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t next_id;
+    uint32_t free_head;
+    char lock;
+};
+
+static PageStoreState* getState()
+{
+    return static_cast<PageStoreState*>(ReservedMemory::getAddr(ReservedMemory::PAGESTORE_ADDR));
+}
+
+/* Storing pages can be done by multiple writers, so we protect the table
+ * with a spinlock, which does not rely on any thread-local variable. */
+static void lockStore(PageStoreState* st)
+{
+    while (__atomic_test_and_set(&st->lock, __ATOMIC_ACQUIRE)) {}
+}
+
+static void unlockStore(PageStoreState* st)
+{
+    __atomic_clear(&st->lock, __ATOMIC_RELEASE);
+}
+
+static size_t tableSize(uint32_t capacity)
+{
+    return capacity * (sizeof(PageEntry) + 2 * sizeof(uint32_t));
+}
+
+static void insertIndex(PageStoreState* st, uint32_t id)
+{
+    uint32_t mask = 2 * st->capacity - 1;
+    uint32_t slot = st->entries[id].hash & mask;
+    while (st->index[slot])
+        slot = (slot + 1) & mask;
+    st->index[slot] = id;
+}
+
+static void removeIndex(PageStoreState* st, uint32_t id)
+{
+    uint32_t mask = 2 * st->capacity - 1;
+    uint32_t i = st->entries[id].hash & mask;
+    while (st->index[i] != id)
+        i = (i + 1) & mask;
+
+    /* Backward-shift deletion: move following entries of the cluster into
+     * the hole when their home slot is not between the hole and them */
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (!st->index[j])
+            break;
+        uint32_t k = st->entries[st->index[j]].hash & mask;
+        if ((j > i) ? ((k <= i) || (k > j)) : ((k <= i) && (k > j))) {
+            st->index[i] = st->index[j];
+            i = j;
+        }
+    }
+    st->index[i] = 0;
+}
+
+/* Resize the table to the new capacity, and rebuild the hash index */
+static void grow(PageStoreState* st, uint32_t capacity)
+{
+    size_t size = tableSize(capacity);
+    MYASSERT(ftruncate(st->table_fd, size) == 0)
+
+    void* addr = ReservedMemory::mapTable(ReservedMemory::PAGESTORE_TABLE, st->table_fd, size);
+    MYASSERT(addr != nullptr)
+
+    st->entries = static_cast<PageEntry*>(addr);
+    st->index = reinterpret_cast<uint32_t*>(st->entries + capacity);
+    st->capacity = capacity;
+
+    memset(st->index, 0, 2 * capacity * sizeof(uint32_t));
+    for (uint32_t id = 1; id < st->next_id; id++) {
+        if (st->entries[id].refcount > 0)
+            insertIndex(st, id);
+    }
+
+    debuglogstdio(LCF_CHECKPOINT, "Page store can now hold %u pages", capacity - 1);
+}
+
+bool PageStore::reserve(uint32_t count)
+{
+    PageStoreState* st = getState();
+
+    if (!st->pool_fd) {
+        st->pool_fd = syscall(SYS_memfd_create, "pagestore", 0);
+        MYASSERT(st->pool_fd != -1)
+        st->table_fd = syscall(SYS_memfd_create, "pagestoretable", 0);
+        MYASSERT(st->table_fd != -1)
+        st->next_id = 1;
+    }
+
+    /* Id zero is never used */
+    uint32_t capacity = st->capacity ? st->capacity : 65536;
+    while ((capacity - 1 - st->count) < count)
+        capacity *= 2;
+
+    if (capacity == st->capacity)
+        return false;
+
+    grow(st, capacity);
+    return true;
+}
+
+uint32_t PageStore::storePage(const char* addr, uint64_t hash, int &new_pages)
+{
+    PageStoreState* st = getState();
+    char stored_page[4096];
+
+    lockStore(st);
+
+    /* Pages with the same hash are compared with the page, because the hash
+     * does not identify the content. Colliding pages get their own id, and
+     * are found in the following slots of the index. */
+    uint32_t mask = 2 * st->capacity - 1;
+    uint32_t slot = hash & mask;
+    uint32_t id;
+    while ((id = st->index[slot])) {
+        if ((st->entries[id].hash == hash) &&
+            (RawSyscall::preadAll(st->pool_fd, stored_page, 4096, static_cast<off_t>(id) * 4096) == 4096) &&
+            (memcmp(stored_page, addr, 4096) == 0)) {
+            /* Page is already stored */
+            st->entries[id].refcount++;
+            unlockStore(st);
+            return id;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    /* Store a new page, recycling a free id if any */
+    if (st->free_head) {
+        id = st->free_head;
+        st->free_head = st->entries[id].next_free;
+    }
+    else {
+        MYASSERT(st->next_id < st->capacity)
+        id = st->next_id++;
+    }
+
+    /* The page is written before being indexed and before releasing the
+     * lock, so that other writers never compare with a partial page. This
+     * may run in a helper thread, so a failure cannot be logged here. */
+    if (RawSyscall::pwriteAll(st->pool_fd, addr, 4096, static_cast<off_t>(id) * 4096) != 4096) {
+        st->entries[id].refcount = 0;
+        st->entries[id].next_free = st->free_head;
+        st->free_head = id;
+        unlockStore(st);
+        return 0;
+    }
+
+    st->entries[id].hash = hash;
+    st->entries[id].refcount = 1;
+    st->entries[id].next_free = 0;
+    st->index[slot] = id;
+    st->count++;
+
+    unlockStore(st);
+
+    new_pages++;
+    return id;
+}
+
+void PageStore::loadPages(const uint32_t* ids, char* const* addrs, int count)
+{
+    PageStoreState* st = getState();
+
+    /* Pages with consecutive ids are read using a single preadv call */
+    struct iovec iovecs[64];
+    int i = 0;
+    while (i < count) {
+        int run = 0;
+        do {
+            iovecs[run].iov_base = addrs[i+run];
+            iovecs[run].iov_len = 4096;
+            run++;
+        } while (((i+run) < count) && (run < 64) && (ids[i+run] == ids[i]+run));
+
+        ssize_t rc;
+        do {
+            rc = preadv(st->pool_fd, iovecs, run, static_cast<off_t>(ids[i]) * 4096);
+        } while ((rc == -1) && (errno == EINTR));
+        MYASSERT(rc == run * 4096)
+
+        i += run;
+    }
+}
+
+void PageStore::releasePages(int pfd)
+{
+    PageStoreState* st = getState();
+    if (!st->pool_fd)
+        return;
+
+    lockStore(st);
+
+    /* Memory of freed pages is given back by punching holes in the pool,
+     * coalescing consecutive page ids */
+    uint32_t hole_start = 0;
+    uint32_t hole_count = 0;
+
+    uint32_t ids[1024];
+    off_t offset = 0;
+    ssize_t size;
+    while ((size = Utils::preadAll(pfd, ids, sizeof(ids), offset)) > 0) {
+        offset += size;
+        for (size_t i = 0; i < (size / sizeof(uint32_t)); i++) {
+            uint32_t id = ids[i];
+            if (!id)
+                continue;
+
+            MYASSERT(st->entries[id].refcount > 0)
+            if (--st->entries[id].refcount)
+                continue;
+
+            removeIndex(st, id);
+            st->entries[id].next_free = st->free_head;
+            st->free_head = id;
+            st->count--;
+
+            if (hole_count && (id == (hole_start + hole_count))) {
+                hole_count++;
+            }
+            else {
+                if (hole_count)
+                    fallocate(st->pool_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(hole_start) * 4096, static_cast<off_t>(hole_count) * 4096);
+                hole_start = id;
+                hole_count = 1;
+            }
+        }
+    }
+    if (hole_count)
+        fallocate(st->pool_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(hole_start) * 4096, static_cast<off_t>(hole_count) * 4096);
+
+    unlockStore(st);
+}
+
+void PageStore::retainPages(int pfd)
+{
+    PageStoreState* st = getState();
+    if (!st->pool_fd)
+        return;
+
+    lockStore(st);
+
+    /* This may run in a helper thread, so ids that are not stored anymore
+     * are skipped instead of asserting */
+    uint32_t ids[1024];
+    off_t offset = 0;
+    long size;
+    while ((size = RawSyscall::preadAll(pfd, ids, sizeof(ids), offset)) > 0) {
+        offset += size;
+        for (size_t i = 0; i < (size / sizeof(uint32_t)); i++) {
+            uint32_t id = ids[i];
+            if (!id || (id >= st->next_id) || (st->entries[id].refcount == 0))
+                continue;
+
+            st->entries[id].refcount++;
+        }
+    }
+
+    unlockStore(st);
+}
+
+int PageStore::getPoolFd()
+{
+    return getState()->pool_fd;
+}
+
+uint32_t PageStore::pageCount()
+{
+    return getState()->count;
+}
+
+}
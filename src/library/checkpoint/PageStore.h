@@ -0,0 +1,75 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_PAGESTORE_H
+#define LIBTAS_PAGESTORE_H
+
+#include <cstdint>
+#include <sys/types.h>
+
+/* The page store is a content-addressed storage of memory pages, shared by
+ * all savestates stored in RAM. Each distinct page is stored once in a memfd
+ * named "pagestore" and is identified by a page id. Savestates only store page ids, and each
+ * stored page keeps a count of the savestates referencing it.
+ *
+ * Pages are looked up using a 64-bit hash of their content, and pages with
+ * the same hash are compared byte by byte before sharing a page id.
+ *
+ * The state of the page store is kept in our reserved memory and in a
+ * separate mapping that is not saved, so that it survives state loading.
+ * Storing pages can be done from helper threads.
+ */
+
+namespace libtas {
+namespace PageStore
+{
+    /* Make sure that at least `count` new pages can be stored without
+     * growing the page store, because growing changes the mapping that holds
+     * the hash table. Must be called before parsing the memory mapping
+     * of the process. Returns if the mapping was changed. */
+    bool reserve(uint32_t count);
+
+    /* Store a memory page of hash `hash` (from Utils::hashPage) and return
+     * its page id. The page is only written if no identical page was stored.
+     * Increments `new_pages` in that case. Returns zero if the page could
+     * not be written. */
+    uint32_t storePage(const char* addr, uint64_t hash, int &new_pages);
+
+    /* Load a list of pages into memory */
+    void loadPages(const uint32_t* ids, char* const* addrs, int count);
+
+    /* Release all page ids stored in a savestate pages file. Page ids of
+     * zero are ignored. */
+    void releasePages(int pfd);
+
+    /* Add a reference to all page ids stored in a savestate pages file,
+     * which now shares them with another savestate. Page ids of zero are
+     * ignored. This function can run in a helper thread. */
+    void retainPages(int pfd);
+
+    /* File descriptor of the memfd holding the page of id `id` at offset
+     * id*4096, or 0 if the page store was not created */
+    int getPoolFd();
+
+    /* Number of distinct pages currently stored */
+    uint32_t pageCount();
+};
+}
+
+#endif
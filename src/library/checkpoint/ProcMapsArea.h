@@ -52,6 +52,7 @@ struct Area {
         ZERO_PAGE, /* Entire page is zero */
         FULL_PAGE, /* Area contains a copy of the page */
         BASE_PAGE, /* Page was not modified from base savestate */
+        PARENT_PAGE, /* Page was not modified from the parent savestate of the delta chain */
     };
 
     void* addr;
@@ -20,6 +20,7 @@
 */
 
 #include "ProcSelfMaps.h"
+#include "ReservedMemory.h"
 #include "../logging.h"
 #include <fcntl.h>
 #include <unistd.h>
@@ -29,36 +30,49 @@
 
 namespace libtas {
 
-ProcSelfMaps::ProcSelfMaps(void* restoreAddr, size_t restoreLength)
-    : dataIdx(0),
-    numAreas(0),
-    numBytes(0)
+/* Parsed and classified area. The name of the area is located in the text
+ * of /proc/self/maps that was parsed. */
+struct MapsEntry {
+    void* addr;
+    void* endAddr;
+    off_t offset;
+    ino_t inodenum;
+    uint32_t devmajor;
+    uint32_t devminor;
+    uint32_t name_offset;
+    uint16_t name_length;
+    uint8_t prot;
+    bool skip;
+    int flags;
+};
+
+/* Table of parsed areas, located in our reserved memory. The entries are
+ * located after the structure. */
+struct MapsCache {
+    /* Function that classified the areas */
+    bool (*skip)(const Area*);
+
+    /* Size of the parsed text, or 0 if the table is not valid */
+    size_t text_size;
+
+    size_t count;
+    char text[ReservedMemory::PSM_SIZE];
+};
+
+static const size_t max_entries = (ReservedMemory::MAPS_SIZE - sizeof(MapsCache)) / sizeof(MapsEntry);
+
+static MapsCache* getCache()
 {
-    int fd;
-    NATIVECALL(fd = open("/proc/self/maps", O_RDONLY));
-    MYASSERT(fd != -1);
-
-    data = static_cast<char*>(restoreAddr);
-
-    numBytes = Utils::readAll(fd, data, restoreLength);
-    MYASSERT(numBytes > 0)
-    MYASSERT(numBytes < restoreLength)
-
-    NATIVECALL(close(fd));
-
-    for (size_t i = 0; i < numBytes; i++) {
-        if (data[i] == '\n') {
-            numAreas++;
-        }
-    }
+    static_assert(sizeof(MapsCache) < ReservedMemory::MAPS_SIZE, "Memory mapping table does not fit in reserved memory");
+    return static_cast<MapsCache*>(ReservedMemory::getAddr(ReservedMemory::MAPS_ADDR));
 }
 
-void ProcSelfMaps::reset()
+static MapsEntry* getEntries(MapsCache* cache)
 {
-    dataIdx = 0;
+    return reinterpret_cast<MapsEntry*>(cache + 1);
 }
 
-uintptr_t ProcSelfMaps::readDec()
+static uintptr_t readDec(const char* data, size_t &dataIdx)
 {
     uintptr_t v = 0;
 
@@ -75,7 +89,7 @@ uintptr_t ProcSelfMaps::readDec()
     return v;
 }
 
-uintptr_t ProcSelfMaps::readHex()
+static uintptr_t readHex(const char* data, size_t &dataIdx)
 {
     uintptr_t v = 0;
 
@@ -96,28 +110,22 @@ uintptr_t ProcSelfMaps::readHex()
     return v;
 }
 
-bool ProcSelfMaps::getNextArea(Area *area)
+/* Parse one line of /proc/self/maps */
+static void parseEntry(const char* data, size_t &dataIdx, MapsEntry *entry)
 {
-    if (dataIdx >= numBytes || data[dataIdx] == 0) {
-        area->addr = nullptr;
-        area->size = 0;
-        return false;
-    }
-
-    uintptr_t addr = readHex();
+    uintptr_t addr = readHex(data, dataIdx);
     MYASSERT(addr != 0)
-    area->addr = reinterpret_cast<void*>(addr);
+    entry->addr = reinterpret_cast<void*>(addr);
 
     MYASSERT(data[dataIdx++] == '-')
 
-    uintptr_t endAddr = readHex();
+    uintptr_t endAddr = readHex(data, dataIdx);
     MYASSERT(endAddr != 0)
-    area->endAddr = reinterpret_cast<void*>(endAddr);
+    entry->endAddr = reinterpret_cast<void*>(endAddr);
 
     MYASSERT(data[dataIdx++] == ' ')
 
     MYASSERT(endAddr >= addr)
-    area->size = static_cast<size_t>(endAddr - addr);
 
     char rflag = data[dataIdx++];
     MYASSERT((rflag == 'r') || (rflag == '-'))
@@ -133,79 +141,171 @@ bool ProcSelfMaps::getNextArea(Area *area)
 
     MYASSERT(data[dataIdx++] == ' ')
 
-    area->offset = readHex();
+    entry->offset = readHex(data, dataIdx);
     MYASSERT(data[dataIdx++] == ' ')
 
-    area->devmajor = readHex();
+    entry->devmajor = readHex(data, dataIdx);
     MYASSERT(data[dataIdx++] == ':')
 
-    area->devminor = readHex();
+    entry->devminor = readHex(data, dataIdx);
     MYASSERT(data[dataIdx++] == ' ')
 
-    area->inodenum = readDec();
+    entry->inodenum = readDec(data, dataIdx);
 
     while (data[dataIdx] == ' ') {
         dataIdx++;
     }
 
-    area->name[0] = '\0';
+    entry->name_offset = dataIdx;
+    entry->name_length = 0;
     if (data[dataIdx] == '/' || data[dataIdx] == '[' || data[dataIdx] == '(') {
         // absolute pathname, or [stack], [vdso], etc.
-        size_t i = 0;
         while (data[dataIdx] != '\n') {
-            area->name[i++] = data[dataIdx++];
-            MYASSERT(i < sizeof(area->name))
+            dataIdx++;
         }
-        area->name[i] = '\0';
+        MYASSERT((dataIdx - entry->name_offset) < FILENAMESIZE)
+        entry->name_length = dataIdx - entry->name_offset;
     }
 
     MYASSERT(data[dataIdx++] == '\n')
 
-    area->prot = 0;
+    entry->prot = 0;
     if (rflag == 'r') {
-        area->prot |= PROT_READ;
+        entry->prot |= PROT_READ;
     }
     if (wflag == 'w') {
-        area->prot |= PROT_WRITE;
+        entry->prot |= PROT_WRITE;
     }
     if (xflag == 'x') {
-        area->prot |= PROT_EXEC;
+        entry->prot |= PROT_EXEC;
     }
 
-    area->flags = MAP_FIXED;
+    entry->flags = MAP_FIXED;
     if (sflag == 's') {
-        area->flags |= MAP_SHARED;
+        entry->flags |= MAP_SHARED;
     }
     if (sflag == 'p') {
-        area->flags |= MAP_PRIVATE;
+        entry->flags |= MAP_PRIVATE;
     }
-    if (area->name[0] == '\0') {
-        area->flags |= MAP_ANONYMOUS;
+    if (entry->name_length == 0) {
+        entry->flags |= MAP_ANONYMOUS;
     }
+}
 
-    area->skip = false;
-
-    /* Sometimes the [heap] is split into several contiguous segments, such as
-     * after a dumping was made (but why...?). This can screw up our code for
-     * loading and remapping the [heap] using brk, so we always read the [heap]
-     * as one single segment.
-     */
-    if (strcmp(area->name, "[heap]") == 0) {
-        Area next_area;
-        size_t curDataIdx = dataIdx;
-        bool valid = getNextArea(&next_area); // recursive call
-        if (valid && (strcmp(next_area.name, "[heap]") == 0)) {
-            MYASSERT(area->endAddr == next_area.addr)
-            MYASSERT(area->prot == next_area.prot)
-            MYASSERT(area->flags == next_area.flags)
-            area->endAddr = next_area.endAddr;
-            area->size += next_area.size;
-        }
-        else {
-            dataIdx = curDataIdx;
+static void fillArea(const MapsEntry &entry, const char* text, Area *area)
+{
+    area->addr = entry.addr;
+    area->endAddr = entry.endAddr;
+    area->size = static_cast<size_t>(static_cast<char*>(entry.endAddr) - static_cast<char*>(entry.addr));
+    area->offset = entry.offset;
+    area->prot = entry.prot;
+    area->flags = entry.flags;
+    area->devmajor = entry.devmajor;
+    area->devminor = entry.devminor;
+    area->inodenum = entry.inodenum;
+    area->skip = entry.skip;
+    memcpy(area->name, text + entry.name_offset, entry.name_length);
+    area->name[entry.name_length] = '\0';
+}
+
+static bool isHeap(const MapsEntry &entry, const char* text)
+{
+    return (entry.name_length == 6) && (memcmp(text + entry.name_offset, "[heap]", 6) == 0);
+}
+
+/* Parse the whole text of /proc/self/maps into the table and classify each
+ * area. Returns the number of areas. */
+static size_t parseMaps(const char* data, size_t numBytes, bool (*skip)(const Area*), MapsEntry *entries)
+{
+    size_t count = 0;
+    size_t dataIdx = 0;
+    Area area;
+
+    while (dataIdx < numBytes && data[dataIdx] != 0) {
+        MYASSERT(count < max_entries)
+        MapsEntry &entry = entries[count];
+        parseEntry(data, dataIdx, &entry);
+
+        /* Sometimes the [heap] is split into several contiguous segments, such as
+         * after a dumping was made (but why...?). This can screw up our code for
+         * loading and remapping the [heap] using brk, so we always read the [heap]
+         * as one single segment.
+         */
+        if ((count > 0) && isHeap(entry, data) && isHeap(entries[count-1], data)) {
+            MapsEntry &prev_entry = entries[count-1];
+            MYASSERT(prev_entry.endAddr == entry.addr)
+            MYASSERT(prev_entry.prot == entry.prot)
+            MYASSERT(prev_entry.flags == entry.flags)
+            prev_entry.endAddr = entry.endAddr;
+            fillArea(prev_entry, data, &area);
+            prev_entry.skip = skip(&area);
+            continue;
         }
+
+        entry.skip = false;
+        fillArea(entry, data, &area);
+        entry.skip = skip(&area);
+        count++;
+    }
+
+    return count;
+}
+
+ProcSelfMaps::ProcSelfMaps(bool (*skip)(const Area*))
+    : areaIdx(0)
+{
+    MapsCache* cache = getCache();
+    char* data = static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::PSM_ADDR));
+
+    int fd;
+    NATIVECALL(fd = open("/proc/self/maps", O_RDONLY));
+    MYASSERT(fd != -1);
+
+    size_t numBytes = Utils::readAll(fd, data, ReservedMemory::PSM_SIZE);
+    MYASSERT(numBytes > 0)
+    MYASSERT(numBytes < ReservedMemory::PSM_SIZE)
+
+    NATIVECALL(close(fd));
+
+    /* Parse the text only if the memory mapping changed since the last time */
+    if ((skip != cache->skip) || (numBytes != cache->text_size) ||
+        (memcmp(data, cache->text, numBytes) != 0)) {
+        cache->text_size = 0;
+        cache->count = parseMaps(data, numBytes, skip, getEntries(cache));
+        memcpy(cache->text, data, numBytes);
+        cache->text_size = numBytes;
+        cache->skip = skip;
+    }
+
+    entries = getEntries(cache);
+    text = cache->text;
+    numAreas = cache->count;
+}
+
+void ProcSelfMaps::reset()
+{
+    areaIdx = 0;
+}
+
+size_t ProcSelfMaps::getPosition()
+{
+    return areaIdx;
+}
+
+void ProcSelfMaps::setPosition(size_t position)
+{
+    areaIdx = position;
+}
+
+bool ProcSelfMaps::getNextArea(Area *area)
+{
+    if (areaIdx >= numAreas) {
+        area->addr = nullptr;
+        area->size = 0;
+        return false;
     }
 
+    fillArea(entries[areaIdx++], text, area);
     return true;
 }
 
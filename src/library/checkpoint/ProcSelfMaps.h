@@ -25,22 +25,40 @@
 #include "ProcMapsArea.h"
 
 namespace libtas {
+
+struct MapsEntry;
+
+/* Memory mapping of the process, parsed from /proc/self/maps.
+ *
+ * Parsed areas are kept in our reserved memory with their classification,
+ * so that iterating over them does not parse the text again. The table is
+ * reused by the next ProcSelfMaps objects as long as the content of
+ * /proc/self/maps does not change, which is checked by comparing it with the
+ * text of the last parsing. We cannot rely on hooking mmap and similar
+ * functions to detect changes, because libc maps memory internally without
+ * going through hooked symbols.
+ */
 class ProcSelfMaps
 {
     public:
-        ProcSelfMaps(void* restoreAddr, size_t restoreLength);
+        /* Read the memory mapping. Areas for which `skip` returns true are
+         * returned with the `skip` field set. Previously built objects must
+         * not be used anymore. */
+        explicit ProcSelfMaps(bool (*skip)(const Area*));
 
         bool getNextArea(Area *area);
         void reset();
 
-    private:
-        uintptr_t readDec();
-        uintptr_t readHex();
+        /* Get and set the current position in the list of areas, so that
+         * the parsing can be resumed from a previous area */
+        size_t getPosition();
+        void setPosition(size_t position);
 
-        char *data;
-        size_t dataIdx;
+    private:
+        const MapsEntry *entries;
+        const char *text;
+        size_t areaIdx;
         size_t numAreas;
-        size_t numBytes;
 };
 }
 
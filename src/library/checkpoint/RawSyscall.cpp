@@ -0,0 +1,110 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RawSyscall.h"
+#include <cerrno>
+
+namespace libtas {
+
+long RawSyscall::readAll(int fd, void* buf, size_t count)
+{
+    char* ptr = static_cast<char*>(buf);
+    size_t num_read = 0;
+
+    while (num_read < count) {
+        long rc = RawSyscall::read(fd, ptr + num_read, count - num_read);
+        if ((rc == -EINTR) || (rc == -EAGAIN))
+            continue;
+        if (rc < 0)
+            return rc;
+        if (rc == 0)
+            break;
+        num_read += rc;
+    }
+    return num_read;
+}
+
+long RawSyscall::preadAll(int fd, void* buf, size_t count, off_t offset)
+{
+    char* ptr = static_cast<char*>(buf);
+    size_t num_read = 0;
+
+    while (num_read < count) {
+        long rc = RawSyscall::pread(fd, ptr + num_read, count - num_read, offset + num_read);
+        if ((rc == -EINTR) || (rc == -EAGAIN))
+            continue;
+        if (rc < 0)
+            return rc;
+        if (rc == 0)
+            break;
+        num_read += rc;
+    }
+    return num_read;
+}
+
+long RawSyscall::pwriteAll(int fd, const void* buf, size_t count, off_t offset)
+{
+    const char* ptr = static_cast<const char*>(buf);
+    size_t num_written = 0;
+
+    while (num_written < count) {
+        long rc = RawSyscall::pwrite(fd, ptr + num_written, count - num_written, offset + num_written);
+        if ((rc == -EINTR) || (rc == -EAGAIN))
+            continue;
+        if (rc < 0)
+            return rc;
+        if (rc == 0)
+            break;
+        num_written += rc;
+    }
+    return num_written;
+}
+
+long RawSyscall::pwritevAll(int fd, struct iovec* iov, int iovcnt, off_t offset)
+{
+    size_t num_written = 0;
+
+    while (iovcnt > 0) {
+        long rc = RawSyscall::pwritev(fd, iov, iovcnt, offset + num_written);
+        if ((rc == -EINTR) || (rc == -EAGAIN))
+            continue;
+        if (rc < 0)
+            return rc;
+        if (rc == 0)
+            break;
+
+        num_written += rc;
+
+        /* Skip the buffers that were entirely written, and advance inside
+         * the partially written one */
+        size_t remaining = rc;
+        while ((iovcnt > 0) && (remaining >= iov->iov_len)) {
+            remaining -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return num_written;
+}
+
+}
@@ -0,0 +1,192 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_RAWSYSCALL_H
+#define LIBTAS_RAWSYSCALL_H
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <poll.h> // struct pollfd
+#include <sys/types.h> // off_t
+#include <sys/syscall.h>
+#include <sys/uio.h> // struct iovec
+
+/* System calls issued without going through the libc. The libc syscall
+ * wrappers store the error code in errno, which is a thread-local variable,
+ * so they cannot be used by helper threads that share the thread-local
+ * storage of the game thread. These functions never touch errno, and return
+ * -errno on failure like the kernel does.
+ *
+ * Functions ending with All() retry on EINTR and EAGAIN, and return the
+ * number of bytes transferred, which is only less than requested at the end
+ * of the file, or -errno on failure. They don't log anything.
+ */
+
+namespace libtas {
+namespace RawSyscall
+{
+#if defined(__x86_64__)
+    inline long call(long n, long a1 = 0, long a2 = 0, long a3 = 0, long a4 = 0, long a5 = 0)
+    {
+        long ret;
+        register long r10 __asm__("r10") = a4;
+        register long r8 __asm__("r8") = a5;
+        __asm__ volatile ("syscall"
+            : "=a"(ret)
+            : "a"(n), "D"(a1), "S"(a2), "d"(a3), "r"(r10), "r"(r8)
+            : "rcx", "r11", "memory");
+        return ret;
+    }
+#elif defined(__i386__)
+    inline long call(long n, long a1 = 0, long a2 = 0, long a3 = 0, long a4 = 0, long a5 = 0)
+    {
+        long ret;
+        __asm__ volatile ("int $0x80"
+            : "=a"(ret)
+            : "a"(n), "b"(a1), "c"(a2), "d"(a3), "S"(a4), "D"(a5)
+            : "memory");
+        return ret;
+    }
+#else
+#error "Unsupported arch"
+#endif
+
+    /* Low and high words of a 64-bit file offset, for the i386 syscalls
+     * taking offsets as two arguments */
+    inline long offsetLow(off_t offset)
+    {
+        return static_cast<long>(static_cast<uint64_t>(offset));
+    }
+
+    inline long offsetHigh(off_t offset)
+    {
+        return static_cast<long>(static_cast<uint64_t>(offset) >> 32);
+    }
+
+    inline long read(int fd, void* buf, size_t count)
+    {
+        return call(SYS_read, fd, reinterpret_cast<long>(buf), count);
+    }
+
+    inline long pread(int fd, void* buf, size_t count, off_t offset)
+    {
+#ifdef __i386__
+        return call(SYS_pread64, fd, reinterpret_cast<long>(buf), count, offsetLow(offset), offsetHigh(offset));
+#else
+        return call(SYS_pread64, fd, reinterpret_cast<long>(buf), count, offset);
+#endif
+    }
+
+    inline long pwrite(int fd, const void* buf, size_t count, off_t offset)
+    {
+#ifdef __i386__
+        return call(SYS_pwrite64, fd, reinterpret_cast<long>(buf), count, offsetLow(offset), offsetHigh(offset));
+#else
+        return call(SYS_pwrite64, fd, reinterpret_cast<long>(buf), count, offset);
+#endif
+    }
+
+    inline long pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+    {
+        /* The kernel takes the offset as two words on all archs, and ignores
+         * the high word on 64-bit archs */
+#ifdef __i386__
+        return call(SYS_pwritev, fd, reinterpret_cast<long>(iov), iovcnt, offsetLow(offset), offsetHigh(offset));
+#else
+        return call(SYS_pwritev, fd, reinterpret_cast<long>(iov), iovcnt, offset, 0);
+#endif
+    }
+
+    inline off_t lseek(int fd, off_t offset, int whence)
+    {
+#ifdef __i386__
+        int64_t result;
+        long ret = call(SYS__llseek, fd, offsetHigh(offset), offsetLow(offset), reinterpret_cast<long>(&result), whence);
+        return (ret < 0) ? ret : result;
+#else
+        return call(SYS_lseek, fd, offset, whence);
+#endif
+    }
+
+    inline long ftruncate(int fd, off_t length)
+    {
+#ifdef __i386__
+        return call(SYS_ftruncate64, fd, offsetLow(length), offsetHigh(length));
+#else
+        return call(SYS_ftruncate, fd, length);
+#endif
+    }
+
+    inline long sendfile(int out_fd, int in_fd, off_t* offset, size_t count)
+    {
+#ifdef __i386__
+        int64_t offset64 = *offset;
+        long ret = call(SYS_sendfile64, out_fd, in_fd, reinterpret_cast<long>(&offset64), count);
+        *offset = offset64;
+        return ret;
+#else
+        return call(SYS_sendfile, out_fd, in_fd, reinterpret_cast<long>(offset), count);
+#endif
+    }
+
+    inline long ioctl(int fd, unsigned long request, void* arg)
+    {
+        return call(SYS_ioctl, fd, request, reinterpret_cast<long>(arg));
+    }
+
+    inline long poll(struct pollfd* fds, unsigned long nfds, int timeout)
+    {
+        return call(SYS_poll, reinterpret_cast<long>(fds), nfds, timeout);
+    }
+
+    inline long close(int fd)
+    {
+        return call(SYS_close, fd);
+    }
+
+    inline long fdatasync(int fd)
+    {
+        return call(SYS_fdatasync, fd);
+    }
+
+    inline long renameat(int olddirfd, const char* oldpath, int newdirfd, const char* newpath)
+    {
+        return call(SYS_renameat, olddirfd, reinterpret_cast<long>(oldpath), newdirfd, reinterpret_cast<long>(newpath));
+    }
+
+    inline long unlinkat(int dirfd, const char* path, int flags)
+    {
+        return call(SYS_unlinkat, dirfd, reinterpret_cast<long>(path), flags);
+    }
+
+    inline long schedYield()
+    {
+        return call(SYS_sched_yield);
+    }
+
+    long readAll(int fd, void* buf, size_t count);
+    long preadAll(int fd, void* buf, size_t count, off_t offset);
+    long pwriteAll(int fd, const void* buf, size_t count, off_t offset);
+
+    /* The iovec array may be modified to handle partial writes */
+    long pwritevAll(int fd, struct iovec* iov, int iovcnt, off_t offset);
+}
+}
+
+#endif
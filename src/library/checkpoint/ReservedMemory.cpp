@@ -21,13 +21,42 @@
 
 #include "ReservedMemory.h"
 #include "../logging.h"
+#include "../GlobalState.h"
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace libtas {
 
 static intptr_t restoreAddr = 0;
 static size_t restoreLength = 0;
+static intptr_t tablesAddr = 0;
+
+/* Maximum size of each table */
+#ifdef __x86_64__
+static const size_t tableSizes[ReservedMemory::TABLE_COUNT] = {
+    64 * ONE_MB, /* SLOTS_TABLE */
+    4096UL * ONE_MB, /* PAGESTORE_TABLE */
+    1024 * ONE_MB, /* LAZY_TABLE */
+    64 * ONE_MB, /* CHAIN_TABLE */
+};
+#else
+static const size_t tableSizes[ReservedMemory::TABLE_COUNT] = {
+    1 * ONE_MB, /* SLOTS_TABLE */
+    32 * ONE_MB, /* PAGESTORE_TABLE */
+    32 * ONE_MB, /* LAZY_TABLE */
+    1 * ONE_MB, /* CHAIN_TABLE */
+};
+#endif
+
+static size_t tableOffset(int table)
+{
+    size_t offset = 0;
+    for (int t = 0; t < table; t++)
+        offset += tableSizes[t];
+    return offset;
+}
 
 void ReservedMemory::init()
 {
@@ -45,6 +74,20 @@ void ReservedMemory::init()
         memset(reinterpret_cast<void*>(restoreAddr), 0, restoreLength);
         // debuglogstdio(LCF_ERROR, "Setup reserved space from %p to %p", reinterpret_cast<void*>(restoreAddr+ONE_MB), reinterpret_cast<void*>(restoreAddr+restoreLength));
     }
+
+    /* Reserve the address space of the growable tables before any
+     * savestate is made. The region is an inaccessible mapping of an empty
+     * memfd, so that it cannot be merged with the game mappings, and the
+     * kernel does not account memory for it. */
+    if (tablesAddr == 0) {
+        int fd = syscall(SYS_memfd_create, "tables", 0);
+        MYASSERT(fd != -1)
+        void* addr = mmap(nullptr, tableOffset(TABLE_COUNT), PROT_NONE,
+            MAP_SHARED | MAP_NORESERVE, fd, 0);
+        MYASSERT(addr != MAP_FAILED)
+        NATIVECALL(close(fd));
+        tablesAddr = reinterpret_cast<intptr_t>(addr);
+    }
 }
 
 void* ReservedMemory::getAddr(intptr_t offset)
@@ -57,4 +100,25 @@ size_t ReservedMemory::getSize()
     return restoreLength;
 }
 
+void* ReservedMemory::mapTable(int table, int fd, size_t size)
+{
+    if (size > tableSizes[table])
+        return nullptr;
+
+    /* The table keeps its address, and its content is preserved because
+     * the new mapping is backed by the same memfd. */
+    void* addr = mmap(reinterpret_cast<void*>(tablesAddr + tableOffset(table)),
+        size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (addr == MAP_FAILED)
+        return nullptr;
+    return addr;
+}
+
+bool ReservedMemory::isTableArea(const Area* area)
+{
+    char* start = reinterpret_cast<char*>(tablesAddr);
+    return (tablesAddr != 0) && (area->addr >= start) &&
+        (area->endAddr <= (start + tableOffset(TABLE_COUNT)));
+}
+
 }
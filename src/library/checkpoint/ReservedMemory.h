@@ -24,29 +24,66 @@
 
 #include <cstdint> // intptr_t
 #include <cstddef> // size_t
+#include "ProcMapsArea.h"
 
 #define ONE_MB 1024 * 1024
-#define RESTORE_TOTAL_SIZE 5 * ONE_MB
+#define RESTORE_TOTAL_SIZE 14 * ONE_MB
 
 namespace libtas {
 namespace ReservedMemory {
     enum Addresses {
-        PAGEMAPS_ADDR = 0,
-        PAGES_ADDR = 11*sizeof(int),
-        PSM_ADDR = 22*sizeof(int),
+        SLOTS_ADDR = 0,
+        PSM_ADDR = 128,
         STACK_ADDR = ONE_MB,
+        IOVEC_ADDR = 5 * ONE_MB,
+        HELPER_TIDS_ADDR = 5 * ONE_MB + 128*1024,
+        PAGESTORE_ADDR = 5 * ONE_MB + 128*1024 + 4096,
+        FLUSH_ADDR = 5 * ONE_MB + 128*1024 + 8192,
+        STATS_ADDR = 5 * ONE_MB + 128*1024 + 16384,
+        LAZY_ADDR = 5 * ONE_MB + 128*1024 + 20480,
+        HELPER_STACKS_ADDR = 6 * ONE_MB,
+        COMPRESS_ADDR = 7 * ONE_MB,
+        CHAIN_ADDR = 9 * ONE_MB,
+        MAPS_ADDR = 11 * ONE_MB,
     };
     enum Sizes {
-        PAGEMAPS_SIZE = PAGES_ADDR - PAGEMAPS_ADDR,
-        PAGES_SIZE = PSM_ADDR - PAGES_ADDR,
+        SLOTS_SIZE = PSM_ADDR - SLOTS_ADDR,
         PSM_SIZE = STACK_ADDR - PSM_ADDR,
-        STACK_SIZE = RESTORE_TOTAL_SIZE - STACK_ADDR,
+        STACK_SIZE = IOVEC_ADDR - STACK_ADDR,
+        IOVEC_SIZE = HELPER_TIDS_ADDR - IOVEC_ADDR,
+        HELPER_TIDS_SIZE = PAGESTORE_ADDR - HELPER_TIDS_ADDR,
+        PAGESTORE_SIZE = FLUSH_ADDR - PAGESTORE_ADDR,
+        FLUSH_SIZE = STATS_ADDR - FLUSH_ADDR,
+        STATS_SIZE = LAZY_ADDR - STATS_ADDR,
+        LAZY_SIZE = HELPER_STACKS_ADDR - LAZY_ADDR,
+        HELPER_STACKS_SIZE = COMPRESS_ADDR - HELPER_STACKS_ADDR,
+        COMPRESS_SIZE = CHAIN_ADDR - COMPRESS_ADDR,
+        CHAIN_SIZE = MAPS_ADDR - CHAIN_ADDR,
+        MAPS_SIZE = RESTORE_TOTAL_SIZE - MAPS_ADDR,
+    };
+
+    /* Tables that grow during the session. Each one is mapped inside a
+     * region reserved at startup, so that it never moves into memory held
+     * by a savestate, which would be overwritten when loading it. */
+    enum Tables {
+        SLOTS_TABLE,
+        PAGESTORE_TABLE,
+        LAZY_TABLE,
+        CHAIN_TABLE,
+        TABLE_COUNT,
     };
 
     void init();
     void* getAddr(intptr_t offset);
     size_t getSize();
 
+    /* Map the first `size` bytes of the memfd `fd` at the fixed location of
+     * the table, replacing any previous mapping of it. Returns nullptr if
+     * the table cannot be that large. */
+    void* mapTable(int table, int fd, size_t size);
+
+    /* Returns if the area is located inside the region of the tables */
+    bool isTableArea(const Area* area);
 
 }
 }
@@ -22,15 +22,31 @@
 #include "SaveState.h"
 #include "../Utils.h"
 #include "StateHeader.h"
+#include "StateIndex.h"
 #include "../logging.h"
+#include "PageStore.h"
+#include "LazyRestore.h"
+#include "RawSyscall.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <cstring>
+#ifdef LIBTAS_HAS_LZ4
+#include <lz4.h>
+#endif
 
 namespace libtas {
 
 SaveState::SaveState(char* pagemappath, char* pagespath, int pagemapfd, int pagesfd)
 {
     queued_size = 0;
+    queued_count = 0;
+    queued_iovec_count = 0;
+    prefetch_end = 0;
+    lazy_source = -1;
+    ids_count = 0;
+    compressed = false;
+    deduplicated = false;
+    indexed = false;
 
     if (shared_config.savestates_in_ram) {
         pmfd = pagemapfd;
@@ -54,8 +70,18 @@ SaveState::SaveState(char* pagemappath, char* pagespath, int pagemapfd, int page
 
         NATIVECALL(pfd = open(pagespath, O_RDONLY));
         MYASSERT(pfd != -1)
+
+        /* Pages are mostly read in file order */
+        posix_fadvise(pfd, 0, 0, POSIX_FADV_SEQUENTIAL);
     }
 
+    /* Check if pages are compressed, and if the savestate has an index */
+    Utils::preadAll(pmfd, &header, sizeof(header), 0);
+    compressed = header.compressed;
+    deduplicated = header.deduplicated;
+    indexed = (header.magic == STATEMAGIC) && (header.version == STATEVERSION) &&
+        (header.index_offset != 0);
+
     restart();
 }
 
@@ -67,46 +93,95 @@ SaveState::~SaveState()
     }
 }
 
-void SaveState::readHeader(StateHeader& sh)
+bool SaveState::readHeader(StateHeader& sh)
 {
-    lseek(pmfd, 0, SEEK_SET);
-    Utils::readAll(pmfd, &sh, sizeof(sh));
+    RawSyscall::lseek(pmfd, 0, SEEK_SET);
+    bool success = (RawSyscall::readAll(pmfd, &sh, sizeof(sh)) == static_cast<long>(sizeof(sh)));
 
     restart();
+    return success;
 }
 
 void SaveState::restart()
 {
-    /* Seek after the savestate header */
-    lseek(pmfd, sizeof(StateHeader), SEEK_SET);
-    flags_remaining = 0;
+    /* Read the first area, after the savestate header */
+    seekArea(sizeof(StateHeader));
+}
 
-    /* Read the first area */
+void SaveState::seekArea(off_t offset)
+{
+    RawSyscall::lseek(pmfd, offset, SEEK_SET);
+    flags_remaining = 0;
+    index_size = 0;
+    next_area_offset = offset;
     nextArea();
 }
 
-char SaveState::nextFlag()
+void SaveState::seekChunk(uint32_t page, off_t page_offset)
 {
-    if (flag_i == 4096) {
-    	MYASSERT(flags_remaining > 0);
+    int nb_pages = area.size / 4096;
+    RawSyscall::lseek(pmfd, flags_offset + page, SEEK_SET);
+    flags_remaining = nb_pages - page;
+    if (compressed)
+        sizes_offset = flags_offset + nb_pages + page * sizeof(uint16_t);
+    next_pfd_offset = page_offset;
+    current_addr = static_cast<char*>(area.addr) + static_cast<size_t>(page) * 4096;
+    flag_i = 4096;
+}
 
-    	int size = (flags_remaining > 4096 ? 4096 : flags_remaining);
+void SaveState::readFlags()
+{
+    /* Flags that cannot be read, or that are past the end of the area, are
+     * returned as missing pages. We can't assert or log here. */
+    int size = (flags_remaining > 4096 ? 4096 : flags_remaining);
+    if ((size <= 0) || (RawSyscall::readAll(pmfd, flags, size) != size))
+        memset(flags, Area::NONE, sizeof(flags));
+    if (size > 0)
+        flags_remaining -= size;
+
+    if (compressed && (size > 0)) {
+        /* Read the corresponding chunk of page sizes */
+        if (RawSyscall::preadAll(pmfd, sizes, size*sizeof(uint16_t), sizes_offset) != static_cast<long>(size*sizeof(uint16_t)))
+            memset(flags, Area::NONE, sizeof(flags));
+        sizes_offset += size*sizeof(uint16_t);
+    }
 
-    	Utils::readAll(pmfd, flags, size);
-    	flags_remaining -= size;
+    flag_i = 0;
+}
 
-    	flag_i = 0;
+char SaveState::nextFlag()
+{
+    if (flag_i == 4096) {
+        readFlags();
     }
 
-    current_flag = flags[flag_i++];
+    current_flag = flags[flag_i];
+    if (current_flag == Area::FULL_PAGE) {
+        if (compressed)
+            current_size = sizes[flag_i];
+        else if (deduplicated)
+            current_size = sizeof(uint32_t);
+        else
+            current_size = 4096;
+        next_pfd_offset += current_size;
+    }
+    flag_i++;
     return current_flag;
 }
 
 void SaveState::nextArea()
 {
-    if (flags_remaining > 0)
-        lseek(pmfd, flags_remaining, SEEK_CUR);
-    Utils::readAll(pmfd, &area, sizeof(Area));
+    if ((flags_remaining + index_size) > 0)
+        RawSyscall::lseek(pmfd, flags_remaining + index_size, SEEK_CUR);
+
+    /* An area that cannot be read ends the savestate */
+    if (RawSyscall::readAll(pmfd, &area, sizeof(Area)) != static_cast<long>(sizeof(Area))) {
+        area.addr = nullptr;
+        area.endAddr = nullptr;
+        area.size = 0;
+        area.skip = false;
+    }
+    flags_offset = next_area_offset + sizeof(Area);
     next_pfd_offset = area.page_offset;
     current_addr = static_cast<char*>(area.addr);
     flag_i = 4096;
@@ -115,6 +190,14 @@ void SaveState::nextArea()
     } else {
         flags_remaining = area.size / 4096;
     }
+
+    /* The page sizes are located after all page flags of the area */
+    index_size = 0;
+    if (compressed && (flags_remaining > 0)) {
+        index_size = flags_remaining * sizeof(uint16_t);
+        sizes_offset = flags_offset + flags_remaining;
+    }
+    next_area_offset = flags_offset + flags_remaining + index_size;
 }
 
 Area& SaveState::getArea()
@@ -124,7 +207,15 @@ Area& SaveState::getArea()
 
 char SaveState::getPageFlag(char* addr)
 {
-    MYASSERT(addr >= (current_addr - 4096));
+    /* No savestate, for example if the parent savestate was dropped */
+    if (pmfd == -1)
+        return Area::NONE;
+
+    /* Addresses must be queried in increasing order. This function can be
+     * called from helper threads, so it reports misuse as a missing page
+     * instead of asserting. */
+    if (addr < (current_addr - 4096))
+        return Area::NONE;
 
     /* If we already gathered the flag for this address, return it again */
     if (addr == (current_addr - 4096))
@@ -133,6 +224,18 @@ char SaveState::getPageFlag(char* addr)
     while ((area.addr != nullptr) && (addr >= static_cast<char*>(area.endAddr))) {
         /* Skip areas until the one we are interested in */
         nextArea();
+
+        /* If it is not the next area, look for it in the index */
+        if (indexed && (area.addr != nullptr) && (addr >= static_cast<char*>(area.endAddr))) {
+            StateIndexArea index_area;
+            if (StateIndex::findArea(pmfd, header, addr, index_area)) {
+                seekArea(index_area.pagemap_offset);
+            }
+            else {
+                /* Go to the last null area, located before the index */
+                seekArea(header.index_offset - sizeof(Area));
+            }
+        }
     }
 
     // debuglogstdio(LCF_CHECKPOINT, "Savestate addr query %p, current area %p and size %d, with current addr %p", addr, area.addr, area.size, current_addr);
@@ -146,26 +249,50 @@ char SaveState::getPageFlag(char* addr)
     if (area.skip)
         return Area::NONE;
 
+    /* If many chunks of page flags must be read before reaching the page,
+     * look for the chunk of the page in the index */
+    uint32_t page = (addr - static_cast<char*>(area.addr)) / 4096;
+    uint32_t current_page = (current_addr - static_cast<char*>(area.addr)) / 4096;
+    if (indexed && (page >= current_page + MIN_SEEK_PAGES)) {
+        StateIndexArea index_area;
+        StateIndexRun run;
+        uint32_t chunk_page = page - (page % StateIndex::CHUNK_PAGES);
+        if (StateIndex::findArea(pmfd, header, addr, index_area) &&
+            StateIndex::findRun(pmfd, header, index_area, chunk_page, run) &&
+            (run.first_page == chunk_page)) {
+            seekChunk(chunk_page, run.page_offset);
+        }
+    }
+
     char flag;
     do {
         flag = nextFlag();
-        if (flag == Area::FULL_PAGE) {
-            next_pfd_offset += 4096;
-        }
         current_addr += 4096;
     } while (current_addr <= addr);
 
     return flag;
 }
 
+bool SaveState::isFullArea()
+{
+    if (area.skip || (flag_i != 4096) || (flags_remaining == 0) || (flags_remaining > 4096))
+        return false;
+
+    int count = flags_remaining;
+    readFlags();
+
+    for (int i = 0; i < count; i++) {
+        if (flags[i] != Area::FULL_PAGE)
+            return false;
+    }
+    return true;
+}
+
 /* Like getPageFlag(), but assumes you're going through the addresses
  * sequentially.  This means it can skip some checks and be a little faster. */
 char SaveState::getNextPageFlag()
 {
     char flag = nextFlag();
-    if (flag == Area::FULL_PAGE) {
-        next_pfd_offset += 4096;
-    }
     current_addr += 4096;
     return flag;
 }
@@ -173,29 +300,133 @@ char SaveState::getNextPageFlag()
 void SaveState::finishLoad()
 {
     if (queued_size > 0) {
-        lseek(pfd, queued_offset, SEEK_SET);
-        Utils::readAll(pfd, queued_addr, queued_size);
+        if (compressed) {
+            /* Read all queued pages at once, then decompress each page */
+            Utils::preadAll(pfd, queued_buffer, queued_size, queued_offset);
+            char* src = queued_buffer;
+            for (int i = 0; i < queued_count; i++) {
+                if (queued_sizes[i] == 4096) {
+                    /* Page was stored uncompressed */
+                    memcpy(queued_addrs[i], src, 4096);
+                }
+                else {
+#ifdef LIBTAS_HAS_LZ4
+                    int ret = LZ4_decompress_safe(src, queued_addrs[i], queued_sizes[i], 4096);
+                    MYASSERT(ret == 4096)
+#else
+                    MYASSERT(false)
+#endif
+                }
+                src += queued_sizes[i];
+            }
+            queued_count = 0;
+        }
+        else if (deduplicated) {
+            /* Read all queued page ids, then load the pages */
+            Utils::preadAll(pfd, queued_buffer, queued_size, queued_offset);
+            PageStore::loadPages(reinterpret_cast<uint32_t*>(queued_buffer), queued_addrs, queued_count);
+            queued_count = 0;
+        }
+        else {
+            /* Read all queued pages at once into their memory location */
+            Utils::preadvAll(pfd, queued_iovecs, queued_iovec_count, queued_offset);
+            queued_iovec_count = 0;
+        }
         queued_size = 0;
     }
 }
 
-void SaveState::queuePageLoad(char* addr)
+uint32_t SaveState::getPageId()
+{
+    MYASSERT(deduplicated && (current_flag == Area::FULL_PAGE))
+
+    off_t offset = next_pfd_offset - sizeof(uint32_t);
+    if ((offset < ids_offset) || (offset >= (ids_offset + ids_count * static_cast<off_t>(sizeof(uint32_t))))) {
+        /* Page ids of an area are contiguous, so we read the following ones */
+        ssize_t size = Utils::preadAll(pfd, ids, sizeof(ids), offset);
+        MYASSERT(size >= static_cast<ssize_t>(sizeof(uint32_t)))
+        ids_offset = offset;
+        ids_count = size / sizeof(uint32_t);
+    }
+    return ids[(offset - ids_offset) / sizeof(uint32_t)];
+}
+
+void SaveState::queuePageLoad(char* addr, bool lazy)
 {
     MYASSERT(addr + 4096 == current_addr);
 
+    if (lazy) {
+        if (lazy_source == -1)
+            lazy_source = LazyRestore::addSource(pfd, compressed, deduplicated);
+        LazyRestore::addPage(addr, lazy_source, next_pfd_offset - current_size, current_size);
+        return;
+    }
+
+    prefetch(next_pfd_offset - current_size);
+
+    if (compressed || deduplicated) {
+        /* Compressed pages and page ids are contiguous in the pages file,
+         * but each page must be processed separately */
+        if (queued_size > 0) {
+            if (((next_pfd_offset - current_size) != queued_offset + queued_size) ||
+                (queued_count == MAX_QUEUED_PAGES)) {
+                finishLoad();
+            }
+        }
+
+        if (queued_size == 0) {
+            queued_offset = next_pfd_offset - current_size;
+        }
+
+        queued_addrs[queued_count] = addr;
+        queued_sizes[queued_count] = current_size;
+        queued_count++;
+        queued_size += current_size;
+        return;
+    }
+
     if (queued_size > 0) {
-    	if ((next_pfd_offset - 4096) == queued_offset + queued_size &&
-    	    addr == queued_addr + queued_size) {
-            queued_size += 4096;
-            return;
-    	} else {
+        if ((next_pfd_offset - 4096) != queued_offset + queued_size) {
             finishLoad();
-    	}
+        }
+        else {
+            /* Extend the last buffer if the page follows it in memory */
+            struct iovec &last = queued_iovecs[queued_iovec_count-1];
+            if (addr == static_cast<char*>(last.iov_base) + last.iov_len) {
+                last.iov_len += 4096;
+                queued_size += 4096;
+                return;
+            }
+
+            if (queued_iovec_count == MAX_QUEUED_IOVECS) {
+                finishLoad();
+            }
+        }
     }
 
-    queued_offset = (next_pfd_offset - 4096);
-    queued_addr = addr;
-    queued_size = 4096;
+    if (queued_size == 0) {
+        queued_offset = (next_pfd_offset - 4096);
+    }
+
+    queued_iovecs[queued_iovec_count].iov_base = addr;
+    queued_iovecs[queued_iovec_count].iov_len = 4096;
+    queued_iovec_count++;
+    queued_size += 4096;
+}
+
+void SaveState::prefetch(off_t offset)
+{
+    /* Savestates in RAM don't need to be read ahead */
+    if (shared_config.savestates_in_ram)
+        return;
+
+    /* Read ahead again when we reach the second half of the last region */
+    if ((offset + PREFETCH_SIZE/2) < prefetch_end)
+        return;
+
+    off_t start = (offset > prefetch_end) ? offset : prefetch_end;
+    prefetch_end = offset + PREFETCH_SIZE;
+    posix_fadvise(pfd, start, prefetch_end - start, POSIX_FADV_WILLNEED);
 }
 
 }
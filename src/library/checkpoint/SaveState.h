@@ -24,6 +24,7 @@
 
 #include "ProcMapsArea.h"
 #include "StateHeader.h"
+#include <sys/uio.h> // struct iovec
 
 namespace libtas {
 class SaveState
@@ -32,8 +33,8 @@ class SaveState
         SaveState(char* pagemappath, char* pagespath, int pagemapfd, int pagesfd);
         ~SaveState();
 
-	// Also resets back to first area
-	void readHeader(StateHeader& sh);
+	// Also resets back to first area. Can be called from helper threads.
+	bool readHeader(StateHeader& sh);
 
 	Area& getArea();
 	void nextArea();
@@ -41,17 +42,65 @@ class SaveState
 	// Reset back to first area
 	void restart();
 
-    char getPageFlag(char* addr);
+	/* Returns the flag of the page at `addr`, which must not be before the
+	 * previously queried page. Pages that cannot be read are returned as
+	 * Area::NONE. This function does not assert nor log, and it only uses
+	 * raw syscalls, so it can be called from helper threads. */
+	char getPageFlag(char* addr);
 	char getNextPageFlag();
-	void queuePageLoad(char* addr);
+	/* Queue the current page to be loaded. If `lazy`, the page is instead
+	 * registered to be loaded on first access by the lazy restore */
+	void queuePageLoad(char* addr, bool lazy = false);
 	void finishLoad();
 
+	/* Returns if all pages of the current area are stored in the savestate.
+	 * Must be called before getting the first page flag of the area. Areas
+	 * larger than one chunk of flags are never considered full. */
+	bool isFullArea();
+
+	/* Returns the page id of the current page, which must be a full page
+	 * of a deduplicated savestate */
+	uint32_t getPageId();
+
+	bool isDeduplicated() const {
+		return deduplicated;
+	}
+
+	bool isCompressed() const {
+		return compressed;
+	}
+
+	/* Position and size of the current page in the pages file, which must
+	 * be a full page */
+	off_t getPageOffset() const {
+		return next_pfd_offset - current_size;
+	}
+
+	uint16_t getPageSize() const {
+		return current_size;
+	}
+
+	int getPagesFd() const {
+		return pfd;
+	}
+
     explicit operator bool() const {
         return (pmfd != -1);
     }
 
     private:
 	char nextFlag();
+	void readFlags();
+
+	/* Read the area located at `offset` in the pagemap file */
+	void seekArea(off_t offset);
+
+	/* Go to page `page` of the current area, which must start a chunk of
+	 * page flags, and which is stored at `page_offset` in the pages file */
+	void seekChunk(uint32_t page, off_t page_offset);
+
+	/* Tell the kernel to read ahead the pages file from `offset` */
+	void prefetch(off_t offset);
 
 	char flags[4096];
     char current_flag;
@@ -64,9 +113,67 @@ class SaveState
     char* current_addr;
 	off_t next_pfd_offset;
 
-	char* queued_addr;
+    /* Offsets of the page flags of the current area and of the next area in
+     * the pagemap file */
+    off_t flags_offset;
+    off_t next_area_offset;
+
+    /* Header of the savestate, and does it contain an index of areas and
+     * page flags. Reading page flags is faster than searching the index
+     * unless many chunks of page flags are skipped. */
+    StateHeader header;
+    bool indexed;
+    enum {
+        MIN_SEEK_PAGES = 16 * 4096,
+    };
+
 	off_t queued_offset;
 	int queued_size;
+
+    /* Uncompressed pages queued to be read with a single preadv. Pages are
+     * contiguous in the pages file, but not necessarily in memory */
+    enum {
+        MAX_QUEUED_IOVECS = 64,
+    };
+    struct iovec queued_iovecs[MAX_QUEUED_IOVECS];
+    int queued_iovec_count;
+
+    /* End of the region of the pages file that was read ahead */
+    enum {
+        PREFETCH_SIZE = 4 * 1024 * 1024,
+    };
+    off_t prefetch_end;
+
+    /* Are pages stored compressed. In that case, the size of each stored
+     * page is written in the pagemap file after the page flags of each area */
+    bool compressed;
+    uint16_t sizes[4096];
+    uint16_t current_size;
+    off_t sizes_offset;
+    int index_size;
+
+    /* Are pages stored in the page store. In that case, the pages file only
+     * contains page ids */
+    bool deduplicated;
+
+    /* Compressed or deduplicated pages that are queued to be read, and the
+     * buffer that receives them before they get decompressed or loaded */
+    enum {
+        MAX_QUEUED_PAGES = 16,
+    };
+    char* queued_addrs[MAX_QUEUED_PAGES];
+    uint16_t queued_sizes[MAX_QUEUED_PAGES];
+    int queued_count;
+    char queued_buffer[MAX_QUEUED_PAGES*4096];
+
+    /* Chunk of page ids read from the pages file, starting at offset
+     * `ids_offset`, used when comparing pages of two savestates */
+    uint32_t ids[1024];
+    off_t ids_offset;
+    int ids_count;
+
+    /* Source index of the pages file in the lazy restore, or -1 */
+    int lazy_source;
 };
 }
 
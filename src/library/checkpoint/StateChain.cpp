@@ -0,0 +1,443 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StateChain.h"
+#include "StateSlots.h"
+#include "StateHeader.h"
+#include "StateIndex.h"
+#include "SaveState.h"
+#include "PageStore.h"
+#include "RawSyscall.h"
+#include "HelperThreads.h"
+#include "ReservedMemory.h"
+#include "../Utils.h"
+#include "../logging.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <new> // placement new
+#include <cstdio> // snprintf
+
+namespace libtas {
+
+/* The compaction runs between savestate operations, like the savestate
+ * flusher and the lazy restore. Because each savestate operation waits for
+ * all of them, they can share the same helper thread. */
+static const int chain_thread = HelperThreads::MAX_THREADS - 1;
+
+enum {
+    /* Size of the buffer receiving pages copied into a keyframe */
+    COPY_SIZE = 256 * 1024,
+};
+
+/* Contiguous stored pages waiting to be copied into a keyframe */
+struct CopyRun {
+    int fd;
+    off_t src_offset;
+    off_t dst_offset;
+    size_t size;
+};
+
+/* State of delta chains, located in our reserved memory. The table is
+ * backed by a memfd, mapped inside the region reserved for growable tables. */
+struct ChainState {
+    int table_fd;
+    ChainNode* nodes;
+    int capacity;
+
+    /* A compaction was started and its keyframe was not used yet */
+    bool pending;
+
+    /* The compaction succeeded, only read after the helper thread ended */
+    bool success;
+
+    /* Slot and pagemap memfd of the savestate being compacted, and memfds
+     * receiving its keyframe */
+    int index;
+    int pmfd;
+    int keyframe_pmfd;
+    int keyframe_pfd;
+
+    /* Savestates built by the compaction or by openAncestors() */
+    int state_count;
+    int state_fds[StateChain::MAX_DEPTH+1][2];
+    SaveState* states[StateChain::MAX_DEPTH+1];
+    alignas(SaveState) char state_storage[StateChain::MAX_DEPTH+1][sizeof(SaveState)];
+
+    /* Buffers used by the compaction */
+    char flags[4096];
+    uint16_t sizes[4096];
+    char buffer[COPY_SIZE];
+};
+
+static ChainState* getState()
+{
+    static_assert(sizeof(ChainState) <= ReservedMemory::CHAIN_SIZE, "Delta chain state does not fit in reserved memory");
+    return static_cast<ChainState*>(ReservedMemory::getAddr(ReservedMemory::CHAIN_ADDR));
+}
+
+void StateChain::reserve(int pmfd)
+{
+    ChainState* st = getState();
+
+    if (pmfd < st->capacity)
+        return;
+
+    if (!st->table_fd) {
+        st->table_fd = syscall(SYS_memfd_create, "statechain", 0);
+        MYASSERT(st->table_fd != -1)
+    }
+
+    int capacity = st->capacity ? st->capacity : 1024;
+    while (capacity <= pmfd)
+        capacity *= 2;
+
+    /* New nodes are filled with zeros by the kernel */
+    size_t size = capacity * sizeof(ChainNode);
+    MYASSERT(ftruncate(st->table_fd, size) == 0)
+
+    void* addr = ReservedMemory::mapTable(ReservedMemory::CHAIN_TABLE, st->table_fd, size);
+    MYASSERT(addr != nullptr)
+
+    st->nodes = static_cast<ChainNode*>(addr);
+    st->capacity = capacity;
+}
+
+void StateChain::add(int pmfd, int pfd, int parent_pmfd)
+{
+    reserve(pmfd);
+
+    ChainState* st = getState();
+    ChainNode& node = st->nodes[pmfd];
+    MYASSERT(node.refs == 0)
+
+    node.pages_fd = pfd;
+    node.parent = parent_pmfd;
+    node.refs = 1;
+    node.depth = 0;
+
+    if (parent_pmfd) {
+        MYASSERT(parent_pmfd < st->capacity)
+        ChainNode& parent = st->nodes[parent_pmfd];
+        MYASSERT(parent.refs > 0)
+        parent.refs++;
+        node.depth = parent.depth + 1;
+    }
+}
+
+void StateChain::release(int pmfd)
+{
+    ChainState* st = getState();
+
+    while (pmfd) {
+        MYASSERT(pmfd < st->capacity)
+        ChainNode& node = st->nodes[pmfd];
+        MYASSERT(node.refs > 0)
+        if (--node.refs > 0)
+            return;
+
+        /* Release the pages that the savestate holds in the page store */
+        StateHeader sh;
+        if ((Utils::preadAll(pmfd, &sh, sizeof(sh), 0) == static_cast<ssize_t>(sizeof(sh))) &&
+            sh.deduplicated)
+            PageStore::releasePages(node.pages_fd);
+
+        NATIVECALL(close(pmfd));
+        NATIVECALL(close(node.pages_fd));
+
+        /* The parent may not be referenced anymore */
+        pmfd = node.parent;
+        node.pages_fd = 0;
+        node.parent = 0;
+        node.depth = 0;
+    }
+}
+
+int StateChain::getDepth(int pmfd)
+{
+    ChainState* st = getState();
+    if ((pmfd <= 0) || (pmfd >= st->capacity)) return 0;
+    return st->nodes[pmfd].depth;
+}
+
+/* Build a savestate and its ancestors, up to `count` savestates. We reopen
+ * their memfds to get independent file offsets, because the same savestate
+ * may be read by another SaveState object. */
+static int openStates(ChainState* st, int pmfd, int count, int* pmfds)
+{
+    MYASSERT(st->state_count == 0)
+
+    int n = 0;
+    while (pmfd && (n < count)) {
+        ChainNode& node = st->nodes[pmfd];
+
+        char fdpath[64];
+        snprintf(fdpath, 64, "/proc/self/fd/%d", pmfd);
+        NATIVECALL(st->state_fds[n][0] = open(fdpath, O_RDONLY));
+        MYASSERT(st->state_fds[n][0] != -1)
+        snprintf(fdpath, 64, "/proc/self/fd/%d", node.pages_fd);
+        NATIVECALL(st->state_fds[n][1] = open(fdpath, O_RDONLY));
+        MYASSERT(st->state_fds[n][1] != -1)
+
+        st->states[n] = new (st->state_storage[n]) SaveState(nullptr, nullptr, st->state_fds[n][0], st->state_fds[n][1]);
+        if (pmfds)
+            pmfds[n] = pmfd;
+
+        n++;
+        pmfd = node.parent;
+    }
+
+    st->state_count = n;
+    return n;
+}
+
+static void closeStates(ChainState* st)
+{
+    for (int n = 0; n < st->state_count; n++) {
+        st->states[n]->~SaveState();
+        NATIVECALL(close(st->state_fds[n][0]));
+        NATIVECALL(close(st->state_fds[n][1]));
+    }
+    st->state_count = 0;
+}
+
+int StateChain::openAncestors(int pmfd, SaveState** states, int* pmfds)
+{
+    ChainState* st = getState();
+    if ((pmfd <= 0) || (pmfd >= st->capacity)) return 0;
+
+    int count = openStates(st, st->nodes[pmfd].parent, MAX_DEPTH, pmfds);
+    for (int n = 0; n < count; n++)
+        states[n] = st->states[n];
+    return count;
+}
+
+void StateChain::closeAncestors()
+{
+    closeStates(getState());
+}
+
+/* Write the pending stored pages into the keyframe */
+static bool flushCopy(ChainState* st, CopyRun &run)
+{
+    if (run.size == 0)
+        return true;
+
+    if (RawSyscall::preadAll(run.fd, st->buffer, run.size, run.src_offset) != static_cast<long>(run.size))
+        return false;
+    if (RawSyscall::pwriteAll(st->keyframe_pfd, st->buffer, run.size, run.dst_offset) != static_cast<long>(run.size))
+        return false;
+
+    run.size = 0;
+    return true;
+}
+
+/* Queue a stored page to be copied into the keyframe. Pages that are
+ * contiguous in the pages file of a savestate are copied together. */
+static bool copyPage(ChainState* st, CopyRun &run, int fd, off_t src_offset, off_t dst_offset, size_t size)
+{
+    if ((run.size > 0) && ((fd != run.fd) ||
+        (src_offset != static_cast<off_t>(run.src_offset + run.size)) ||
+        ((run.size + size) > COPY_SIZE))) {
+        if (!flushCopy(st, run))
+            return false;
+    }
+
+    if (run.size == 0) {
+        run.fd = fd;
+        run.src_offset = src_offset;
+        run.dst_offset = dst_offset;
+    }
+    run.size += size;
+    return true;
+}
+
+/* Write the keyframe of the first built savestate. Pages flagged as
+ * PARENT_PAGE are looked for in ancestors, and their stored form is copied
+ * as is, which requires all savestates of the chain to store pages the same
+ * way. The pagemap layout is identical to the one of the savestate. */
+static bool writeKeyframe(ChainState* st)
+{
+    SaveState &state = *st->states[0];
+
+    StateHeader sh;
+    if (!state.readHeader(sh))
+        return false;
+    if (RawSyscall::pwriteAll(st->keyframe_pmfd, &sh, sizeof(sh), 0) != static_cast<long>(sizeof(sh)))
+        return false;
+
+    off_t pm_offset = sizeof(sh);
+    off_t pages_offset = 0;
+    int area_count = 0;
+    CopyRun run = {0, 0, 0, 0};
+
+    Area& area = state.getArea();
+    while (area.addr != nullptr) {
+        Area keyframe_area = area;
+        keyframe_area.page_offset = pages_offset;
+        if (RawSyscall::pwriteAll(st->keyframe_pmfd, &keyframe_area, sizeof(Area), pm_offset) != static_cast<long>(sizeof(Area)))
+            return false;
+        pm_offset += sizeof(Area);
+        area_count++;
+
+        if (!area.skip) {
+            int nb_pages = area.size / 4096;
+            off_t sizes_offset = pm_offset + nb_pages;
+            char* addr = static_cast<char*>(area.addr);
+
+            for (int page_i = 0; page_i < nb_pages; page_i += 4096) {
+                int count = ((nb_pages - page_i) > 4096) ? 4096 : (nb_pages - page_i);
+
+                for (int i = 0; i < count; i++, addr += 4096) {
+                    SaveState* source = &state;
+                    char flag = state.getNextPageFlag();
+                    for (int d = 1; (flag == Area::PARENT_PAGE) && (d < st->state_count); d++) {
+                        source = st->states[d];
+                        flag = source->getPageFlag(addr);
+                    }
+
+                    st->flags[i] = flag;
+                    st->sizes[i] = 0;
+
+                    if (flag == Area::FULL_PAGE) {
+                        st->sizes[i] = source->getPageSize();
+                        if (!copyPage(st, run, source->getPagesFd(), source->getPageOffset(), pages_offset, st->sizes[i]))
+                            return false;
+                        pages_offset += st->sizes[i];
+                    }
+                    else if ((flag == Area::PARENT_PAGE) || (flag == Area::NONE)) {
+                        /* The chain is broken */
+                        return false;
+                    }
+                }
+
+                if (RawSyscall::pwriteAll(st->keyframe_pmfd, st->flags, count, pm_offset) != count)
+                    return false;
+                pm_offset += count;
+
+                if (sh.compressed) {
+                    if (RawSyscall::pwriteAll(st->keyframe_pmfd, st->sizes, count*sizeof(uint16_t), sizes_offset) != static_cast<long>(count*sizeof(uint16_t)))
+                        return false;
+                    sizes_offset += count*sizeof(uint16_t);
+                }
+            }
+
+            if (sh.compressed)
+                pm_offset = sizes_offset;
+        }
+
+        state.nextArea();
+    }
+
+    if (!flushCopy(st, run))
+        return false;
+
+    /* Add the last null (eof) area */
+    Area last_area;
+    last_area.addr = nullptr;
+    last_area.size = 0;
+    if (RawSyscall::pwriteAll(st->keyframe_pmfd, &last_area, sizeof(Area), pm_offset) != static_cast<long>(sizeof(Area)))
+        return false;
+
+    /* Write the index of the keyframe and update its header */
+    if (StateIndex::write(st->keyframe_pmfd, pm_offset + sizeof(Area), area_count, sh) < 0)
+        return false;
+    if (RawSyscall::pwriteAll(st->keyframe_pmfd, &sh, sizeof(sh), 0) != static_cast<long>(sizeof(sh)))
+        return false;
+
+    /* The keyframe shares its page ids with the savestate and its ancestors.
+     * Page ids of the savestate are released when it is replaced. */
+    if (sh.deduplicated)
+        PageStore::retainPages(st->keyframe_pfd);
+
+    return true;
+}
+
+/* Function executed by the helper thread, which must not call any hooked
+ * function, nor any function that asserts, logs or sets errno. All file
+ * accesses use RawSyscall, and failures are only reported by the result.
+ * The keyframe is only used by the next call to wait(). */
+static int compactState(void*)
+{
+    ChainState* st = getState();
+    st->success = writeKeyframe(st);
+    return 0;
+}
+
+void StateChain::startCompaction(int index)
+{
+    ChainState* st = getState();
+
+    int max_depth = shared_config.savestates_chain_length;
+    if (max_depth > MAX_DEPTH)
+        max_depth = MAX_DEPTH;
+
+    int pmfd = StateSlots::getPagemapFd(index);
+    if ((max_depth <= 0) || !pmfd || (getDepth(pmfd) < max_depth))
+        return;
+
+    /* Create the memfds receiving the keyframe */
+    st->keyframe_pmfd = syscall(SYS_memfd_create, "pagemapstate", 0);
+    MYASSERT(st->keyframe_pmfd != -1)
+    st->keyframe_pfd = syscall(SYS_memfd_create, "pagesstate", 0);
+    MYASSERT(st->keyframe_pfd != -1)
+    reserve(st->keyframe_pmfd);
+
+    /* Build the savestate and all its ancestors */
+    openStates(st, pmfd, MAX_DEPTH+1, nullptr);
+
+    st->index = index;
+    st->pmfd = pmfd;
+    st->pending = true;
+    st->success = false;
+
+    debuglogstdio(LCF_CHECKPOINT, "Compacting state %d with %d ancestors in background", index, st->state_count - 1);
+    HelperThreads::start(chain_thread, compactState, nullptr);
+}
+
+void StateChain::wait()
+{
+    ChainState* st = getState();
+
+    if (!st->pending)
+        return;
+
+    HelperThreads::join(chain_thread);
+    st->pending = false;
+    closeStates(st);
+
+    if (!st->success) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Compacting state %d failed", st->index);
+        NATIVECALL(close(st->keyframe_pmfd));
+        NATIVECALL(close(st->keyframe_pfd));
+        return;
+    }
+
+    /* Replace the savestate of the slot by its keyframe. The savestate is
+     * kept if other savestates depend on it. */
+    MYASSERT(StateSlots::getPagemapFd(st->index) == st->pmfd)
+    add(st->keyframe_pmfd, st->keyframe_pfd, 0);
+    StateSlots::setPagemapFd(st->index, st->keyframe_pmfd);
+    StateSlots::setPagesFd(st->index, st->keyframe_pfd);
+    release(st->pmfd);
+
+    debuglogstdio(LCF_CHECKPOINT, "Compacted state %d into a keyframe", st->index);
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_STATECHAIN_H
+#define LIBTAS_STATECHAIN_H
+
+/* Delta chains of savestates stored in RAM. A savestate of a chain only
+ * stores the pages modified since its parent savestate, other pages being
+ * flagged as PARENT_PAGE and read from the parent, which may itself read
+ * them from its own parent.
+ *
+ * Savestates are identified by their pagemap memfd. Each savestate counts
+ * the savestate slots and the child savestates referencing it, so that
+ * overwriting or dropping a savestate slot keeps the savestate alive while
+ * other savestates depend on it.
+ *
+ * When a chain becomes longer than the configured length, a helper thread
+ * compacts its last savestate into a keyframe, which stores all its pages
+ * besides base pages, so that neither saving nor loading a savestate depends
+ * on the number of savestates taken before.
+ *
+ * The table of savestates lives in its own mapping, which is not saved in
+ * savestates, and its state is kept in our reserved memory, so that it
+ * survives state loading. It is backed by a memfd named "statechain", which
+ * the program reads to follow delta chains.
+ */
+
+namespace libtas {
+
+class SaveState;
+
+/* Savestate of the table, indexed by its pagemap memfd */
+struct ChainNode {
+    int pages_fd;
+
+    /* Pagemap memfd of the parent savestate, or 0 for a keyframe */
+    int parent;
+
+    /* Number of savestate slots and child savestates referencing it */
+    int refs;
+
+    /* Number of ancestors */
+    int depth;
+};
+
+namespace StateChain
+{
+    enum {
+        /* Maximum number of ancestors of a savestate */
+        MAX_DEPTH = 16,
+    };
+
+    /* Make sure that the table can hold the savestate of pagemap memfd
+     * `pmfd`. Growing the table changes its mapping, so it must be called
+     * before parsing the memory mapping of the process. */
+    void reserve(int pmfd);
+
+    /* Register a new savestate, referenced by one savestate slot. Its parent
+     * is the savestate of pagemap memfd `parent_pmfd`, or 0 for a keyframe. */
+    void add(int pmfd, int pfd, int parent_pmfd);
+
+    /* Release a reference to a savestate. When nothing references it, its
+     * pages are released from the page store, its memfds are closed and its
+     * reference to its parent is released. */
+    void release(int pmfd);
+
+    /* Number of ancestors of a savestate */
+    int getDepth(int pmfd);
+
+    /* Build the ancestors of a savestate, starting from its parent, in our
+     * reserved memory. Each ancestor uses its own file descriptions. Returns
+     * the number of ancestors, and fills their pagemap memfd. */
+    int openAncestors(int pmfd, SaveState** states, int* pmfds);
+
+    /* Destroy the ancestors built by openAncestors() */
+    void closeAncestors();
+
+    /* Start compacting the savestate of a slot into a keyframe in
+     * background, if its chain is too long */
+    void startCompaction(int index);
+
+    /* Wait for the current compaction to end, if any, and replace the
+     * savestate of the slot by its keyframe. Must be called before
+     * accessing any savestate. */
+    void wait();
+};
+}
+
+#endif
@@ -0,0 +1,198 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StateFlusher.h"
+#include "HelperThreads.h"
+#include "RawSyscall.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include <unistd.h>
+#include <fcntl.h> // AT_FDCWD
+#include <cerrno>
+#include <cstring>
+#include <sys/syscall.h>
+
+namespace libtas {
+
+/* Savestate writers never use the last helper thread, because the first
+ * writer is the thread performing the savestate. It is shared with the lazy
+ * restore, which never runs at the same time. */
+static const int flush_thread = HelperThreads::MAX_THREADS - 1;
+
+/* State of the flush, located in our reserved memory */
+struct FlushState {
+    /* Staging memfds, or 0 if not created yet */
+    int staging_pmfd;
+    int staging_pfd;
+
+    /* Savestate files being written */
+    int pmfd;
+    int pfd;
+
+    /* Index of the savestate being flushed */
+    int index;
+
+    /* A flush was started and was not reported yet */
+    bool pending;
+
+    /* The helper thread has finished. We don't check if the thread is
+     * running, because the lazy restore uses the same thread */
+    bool done;
+
+    /* All writes succeeded */
+    bool success;
+
+    char temppagemappath[1024];
+    char pagemappath[1024];
+    char temppagespath[1024];
+    char pagespath[1024];
+};
+
+static FlushState* getState()
+{
+    static_assert(sizeof(FlushState) <= ReservedMemory::FLUSH_SIZE, "Flush state does not fit in reserved memory");
+    return static_cast<FlushState*>(ReservedMemory::getAddr(ReservedMemory::FLUSH_ADDR));
+}
+
+/* Copy a staging memfd into a file at the same offsets. The pages file may
+ * contain holes between the regions of each writer, so we only copy data
+ * segments. */
+static bool copyFile(int src, int dst)
+{
+    off_t end = RawSyscall::lseek(src, 0, SEEK_END);
+    if (end < 0)
+        return false;
+
+    off_t data = 0;
+    while (data < end) {
+        data = RawSyscall::lseek(src, data, SEEK_DATA);
+        if (data < 0)
+            return false;
+        off_t hole = RawSyscall::lseek(src, data, SEEK_HOLE);
+        if (hole < 0)
+            return false;
+        if (RawSyscall::lseek(dst, data, SEEK_SET) < 0)
+            return false;
+
+        while (data < hole) {
+            long ret = RawSyscall::sendfile(dst, src, &data, hole - data);
+            if ((ret == -EINTR) || (ret == -EAGAIN))
+                continue;
+            if (ret <= 0)
+                return false;
+        }
+    }
+
+    return RawSyscall::ftruncate(dst, end) == 0;
+}
+
+/* Function executed by the helper thread. Hooked functions like close() or
+ * rename() are bypassed, and all syscalls are issued using RawSyscall,
+ * because errno is shared with the game thread. */
+static int flushStateFiles(void*)
+{
+    FlushState* st = getState();
+
+    bool success = copyFile(st->staging_pmfd, st->pmfd) &&
+        copyFile(st->staging_pfd, st->pfd);
+
+    if (success) {
+        success = (RawSyscall::fdatasync(st->pmfd) == 0) &&
+            (RawSyscall::fdatasync(st->pfd) == 0);
+    }
+
+    RawSyscall::close(st->pmfd);
+    RawSyscall::close(st->pfd);
+
+    if (success) {
+        success = (RawSyscall::renameat(AT_FDCWD, st->temppagemappath, AT_FDCWD, st->pagemappath) == 0) &&
+            (RawSyscall::renameat(AT_FDCWD, st->temppagespath, AT_FDCWD, st->pagespath) == 0);
+    }
+    else {
+        RawSyscall::unlinkat(AT_FDCWD, st->temppagemappath, 0);
+        RawSyscall::unlinkat(AT_FDCWD, st->temppagespath, 0);
+    }
+
+    /* Free the memory used by the staging memfds */
+    RawSyscall::ftruncate(st->staging_pmfd, 0);
+    RawSyscall::ftruncate(st->staging_pfd, 0);
+
+    st->success = success;
+    __atomic_store_n(&st->done, true, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void StateFlusher::getStagingFds(int &pmfd, int &pfd)
+{
+    FlushState* st = getState();
+
+    if (!st->staging_pmfd) {
+        st->staging_pmfd = syscall(SYS_memfd_create, "stagingpagemap", 0);
+        MYASSERT(st->staging_pmfd != -1)
+        st->staging_pfd = syscall(SYS_memfd_create, "stagingpages", 0);
+        MYASSERT(st->staging_pfd != -1)
+    }
+    else {
+        ftruncate(st->staging_pmfd, 0);
+        ftruncate(st->staging_pfd, 0);
+    }
+
+    pmfd = st->staging_pmfd;
+    pfd = st->staging_pfd;
+}
+
+void StateFlusher::start(int index, int pmfd, int pfd, const char* temppagemappath,
+    const char* pagemappath, const char* temppagespath, const char* pagespath)
+{
+    FlushState* st = getState();
+
+    st->pmfd = pmfd;
+    st->pfd = pfd;
+    st->index = index;
+    st->pending = true;
+    st->done = false;
+    st->success = false;
+    strncpy(st->temppagemappath, temppagemappath, 1023);
+    strncpy(st->pagemappath, pagemappath, 1023);
+    strncpy(st->temppagespath, temppagespath, 1023);
+    strncpy(st->pagespath, pagespath, 1023);
+
+    debuglogstdio(LCF_CHECKPOINT, "Flushing state %d to disk in background", index);
+    HelperThreads::start(flush_thread, flushStateFiles, nullptr);
+}
+
+void StateFlusher::wait()
+{
+    HelperThreads::join(flush_thread);
+}
+
+bool StateFlusher::pollDone(int &index, bool &success)
+{
+    FlushState* st = getState();
+
+    if (!st->pending || !__atomic_load_n(&st->done, __ATOMIC_ACQUIRE))
+        return false;
+
+    index = st->index;
+    success = st->success;
+    st->pending = false;
+    return true;
+}
+
+}
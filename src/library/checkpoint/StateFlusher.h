@@ -0,0 +1,56 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_STATEFLUSHER_H
+#define LIBTAS_STATEFLUSHER_H
+
+/* Asynchronous writing of savestates to disk. The savestate is first dumped
+ * into staging memfds while the game is suspended, and a helper thread
+ * copies them into the savestate files after the game has resumed. The
+ * files are written under temporary names and renamed when complete, so
+ * that a savestate file is never seen partially written.
+ *
+ * The state of the flush is kept in our reserved memory, so that it is
+ * preserved when loading a savestate. Any access to savestate files must
+ * be preceded by a call to wait().
+ */
+
+namespace libtas {
+namespace StateFlusher
+{
+    /* Get the staging memfds receiving the next savestate, creating them
+     * if needed. Must be called after wait(). */
+    void getStagingFds(int &pmfd, int &pfd);
+
+    /* Start copying the staging memfds into the opened files `pmfd` and
+     * `pfd`, which are then closed. Temporary files are renamed to their
+     * final paths when complete. */
+    void start(int index, int pmfd, int pfd, const char* temppagemappath,
+        const char* pagemappath, const char* temppagespath, const char* pagespath);
+
+    /* Wait for the current flush to end, if any */
+    void wait();
+
+    /* Returns if a flush has ended since the last call, with the index of
+     * the savestate and if all writes succeeded. */
+    bool pollDone(int &index, bool &success);
+};
+}
+
+#endif
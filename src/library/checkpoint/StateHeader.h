@@ -22,15 +22,43 @@
 #ifndef LIBTAS_STATEHEADER_H
 #define LIBTAS_STATEHEADER_H
 
+#include "ProcMapsArea.h"
 #include <pthread.h>
+#include <cstdint>
 
 #define STATEMAXTHREADS 100
 
+/* Identify savestates written in the current format */
+#define STATEMAGIC 0x5353544c /* "LTSS" */
+#define STATEVERSION 1
+
 namespace libtas {
 struct StateHeader {
+    uint32_t magic;
+    uint32_t version;
+
     int thread_count;
     pthread_t pthread_ids[STATEMAXTHREADS];
     pid_t tids[STATEMAXTHREADS];
+
+    /* Are memory pages compressed in the pages file */
+    bool compressed;
+
+    /* Are memory pages stored in the page store, the pages file only
+     * containing page ids */
+    bool deduplicated;
+
+    /* Location of the index of areas and of the runs of page flags in the
+     * pagemap file, or 0 if the savestate has no index */
+    off_t index_offset;
+    uint32_t area_count;
+    off_t runs_offset;
+    uint32_t run_count;
+
+    /* Number of pages of each flag and size of the stored pages, so that
+     * the savestate can be inspected without reading it */
+    uint64_t page_counts[Area::PARENT_PAGE+1];
+    uint64_t pages_size;
 };
 }
 
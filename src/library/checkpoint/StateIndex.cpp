@@ -0,0 +1,236 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StateIndex.h"
+#include "RawSyscall.h"
+#include <cerrno>
+
+namespace libtas {
+
+enum {
+    /* Number of index entries written at once */
+    AREA_BUFFER = 128,
+    RUN_BUFFER = 256,
+};
+
+/* State of the index being written. Entries are buffered and written when
+ * the buffers are full. */
+struct IndexWriter {
+    int pmfd;
+    off_t area_offset;
+    off_t run_offset;
+
+    StateIndexArea areas[AREA_BUFFER];
+    int area_i;
+    StateIndexRun runs[RUN_BUFFER];
+    int run_i;
+    uint32_t run_count;
+
+    /* First error, as -errno, or zero */
+    long error;
+};
+
+/* Read from the pagemap file, recording any failure */
+static void readIndexed(IndexWriter &writer, void* buf, size_t size, off_t offset)
+{
+    long ret = RawSyscall::preadAll(writer.pmfd, buf, size, offset);
+    if ((ret != static_cast<long>(size)) && !writer.error)
+        writer.error = (ret < 0) ? ret : -EIO;
+}
+
+static void writeIndex(IndexWriter &writer, const void* buf, size_t size, off_t offset)
+{
+    long ret = RawSyscall::pwriteAll(writer.pmfd, buf, size, offset);
+    if ((ret != static_cast<long>(size)) && !writer.error)
+        writer.error = (ret < 0) ? ret : -ENOSPC;
+}
+
+static void flushAreas(IndexWriter &writer)
+{
+    size_t size = writer.area_i * sizeof(StateIndexArea);
+    writeIndex(writer, writer.areas, size, writer.area_offset);
+    writer.area_offset += size;
+    writer.area_i = 0;
+}
+
+static void flushRuns(IndexWriter &writer)
+{
+    size_t size = writer.run_i * sizeof(StateIndexRun);
+    writeIndex(writer, writer.runs, size, writer.run_offset);
+    writer.run_offset += size;
+    writer.run_i = 0;
+}
+
+static void addRun(IndexWriter &writer, const StateIndexRun &run)
+{
+    if (writer.run_i == RUN_BUFFER)
+        flushRuns(writer);
+    writer.runs[writer.run_i++] = run;
+    writer.run_count++;
+}
+
+long StateIndex::write(int pmfd, off_t offset, int area_count, StateHeader &sh)
+{
+    IndexWriter writer;
+    writer.pmfd = pmfd;
+    writer.error = 0;
+    writer.area_offset = offset;
+    writer.run_offset = offset + area_count * sizeof(StateIndexArea);
+    writer.area_i = 0;
+    writer.run_i = 0;
+    writer.run_count = 0;
+
+    for (int f = 0; f <= Area::PARENT_PAGE; f++)
+        sh.page_counts[f] = 0;
+    sh.pages_size = 0;
+
+    char flags[CHUNK_PAGES];
+    uint16_t sizes[CHUNK_PAGES];
+    Area area;
+
+    off_t pm_offset = sizeof(StateHeader);
+    for (int a = 0; (a < area_count) && !writer.error; a++) {
+        readIndexed(writer, &area, sizeof(Area), pm_offset);
+        if (writer.error)
+            break;
+
+        StateIndexArea &index_area = writer.areas[writer.area_i];
+        index_area.addr = area.addr;
+        index_area.endAddr = area.endAddr;
+        index_area.pagemap_offset = pm_offset;
+        index_area.first_run = writer.run_count;
+        pm_offset += sizeof(Area);
+
+        if (!area.skip) {
+            int nb_pages = area.size / 4096;
+            off_t sizes_offset = pm_offset + nb_pages;
+            off_t page_offset = area.page_offset;
+
+            for (int page_i = 0; page_i < nb_pages; page_i += CHUNK_PAGES) {
+                int count = ((nb_pages - page_i) > CHUNK_PAGES) ? CHUNK_PAGES : (nb_pages - page_i);
+                readIndexed(writer, flags, count, pm_offset);
+                pm_offset += count;
+                if (sh.compressed) {
+                    readIndexed(writer, sizes, count*sizeof(uint16_t), sizes_offset);
+                    sizes_offset += count*sizeof(uint16_t);
+                }
+                if (writer.error)
+                    break;
+
+                /* Runs are cut at each chunk */
+                StateIndexRun run;
+                run.first_page = page_i;
+                run.page_count = 0;
+                run.page_offset = page_offset;
+                run.flag = flags[0];
+
+                for (int i = 0; i < count; i++) {
+                    if (flags[i] != run.flag) {
+                        addRun(writer, run);
+                        run.first_page = page_i + i;
+                        run.page_count = 0;
+                        run.page_offset = page_offset;
+                        run.flag = flags[i];
+                    }
+                    run.page_count++;
+
+                    sh.page_counts[static_cast<int>(flags[i])]++;
+                    if (flags[i] == Area::FULL_PAGE) {
+                        size_t size = sh.compressed ? sizes[i] : (sh.deduplicated ? sizeof(uint32_t) : 4096);
+                        page_offset += size;
+                        sh.pages_size += size;
+                    }
+                }
+                addRun(writer, run);
+            }
+
+            if (sh.compressed)
+                pm_offset = sizes_offset;
+        }
+
+        index_area.run_count = writer.run_count - index_area.first_run;
+        if (++writer.area_i == AREA_BUFFER)
+            flushAreas(writer);
+    }
+
+    flushAreas(writer);
+    flushRuns(writer);
+
+    /* Savestates without an index are still valid */
+    if (writer.error) {
+        sh.index_offset = 0;
+        sh.area_count = 0;
+        sh.runs_offset = 0;
+        sh.run_count = 0;
+        return writer.error;
+    }
+
+    sh.index_offset = offset;
+    sh.area_count = area_count;
+    sh.runs_offset = offset + area_count * sizeof(StateIndexArea);
+    sh.run_count = writer.run_count;
+
+    return area_count * sizeof(StateIndexArea) + writer.run_count * sizeof(StateIndexRun);
+}
+
+bool StateIndex::findArea(int pmfd, const StateHeader &sh, void* addr, StateIndexArea &area)
+{
+    /* Look for the first area ending after the address */
+    uint32_t low = 0;
+    uint32_t high = sh.area_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (RawSyscall::preadAll(pmfd, &area, sizeof(area), sh.index_offset + mid * sizeof(StateIndexArea)) != static_cast<long>(sizeof(area)))
+            return false;
+        if (static_cast<char*>(area.endAddr) <= static_cast<char*>(addr))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == sh.area_count)
+        return false;
+
+    return RawSyscall::preadAll(pmfd, &area, sizeof(area), sh.index_offset + low * sizeof(StateIndexArea)) == static_cast<long>(sizeof(area));
+}
+
+bool StateIndex::findRun(int pmfd, const StateHeader &sh, const StateIndexArea &area, uint32_t page, StateIndexRun &run)
+{
+    /* Look for the last run starting before the page */
+    uint32_t low = area.first_run;
+    uint32_t high = area.first_run + area.run_count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (RawSyscall::preadAll(pmfd, &run, sizeof(run), sh.runs_offset + mid * sizeof(StateIndexRun)) != static_cast<long>(sizeof(run)))
+            return false;
+        if (run.first_page <= page)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low == area.first_run)
+        return false;
+
+    if (RawSyscall::preadAll(pmfd, &run, sizeof(run), sh.runs_offset + (low - 1) * sizeof(StateIndexRun)) != static_cast<long>(sizeof(run)))
+        return false;
+    return (page < run.first_page + run.page_count);
+}
+
+}
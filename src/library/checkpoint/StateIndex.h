@@ -0,0 +1,88 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_STATEINDEX_H
+#define LIBTAS_STATEINDEX_H
+
+#include "StateHeader.h"
+#include <cstdint>
+#include <sys/types.h>
+
+/* Index of a savestate, written in the pagemap file after the last null
+ * area. It contains one entry per area, sorted by address, followed by the
+ * run-length encoded page flags of all areas. A run never crosses a chunk of
+ * 4096 page flags, so that the position of each chunk in the pages file is
+ * the offset of a run.
+ *
+ * The index allows to find the flag and the stored position of any page
+ * with a few reads, instead of reading all page flags up to it.
+ */
+
+namespace libtas {
+
+struct StateIndexArea {
+    void* addr;
+    void* endAddr;
+
+    /* Offset of the Area structure in the pagemap file */
+    off_t pagemap_offset;
+
+    /* Runs of the area */
+    uint32_t first_run;
+    uint32_t run_count;
+};
+
+struct StateIndexRun {
+    /* Index of the first page of the run in the area */
+    uint32_t first_page;
+    uint32_t page_count;
+
+    /* Offset of the first page of the run in the pages file */
+    off_t page_offset;
+
+    char flag;
+};
+
+namespace StateIndex
+{
+    enum {
+        /* Number of page flags read at once */
+        CHUNK_PAGES = 4096,
+    };
+
+    /* Build the index of the `area_count` areas of the pagemap file `pmfd`,
+     * whose header is `sh`, and write it at `offset`. The index fields and
+     * page counts of the header are filled, but the header is not written.
+     * Returns the size of the index, or -errno if the index could not be
+     * written, in which case the header is marked as having no index. This
+     * function only uses raw syscalls and does not log, so it can run in a
+     * helper thread. */
+    long write(int pmfd, off_t offset, int area_count, StateHeader &sh);
+
+    /* Find the area containing `addr`, or the first area after it. Returns
+     * false if there is no such area or if the index cannot be read. This
+     * function and findRun() can run in a helper thread. */
+    bool findArea(int pmfd, const StateHeader &sh, void* addr, StateIndexArea &area);
+
+    /* Find the run of an area containing page `page` */
+    bool findRun(int pmfd, const StateHeader &sh, const StateIndexArea &area, uint32_t page, StateIndexRun &run);
+}
+}
+
+#endif
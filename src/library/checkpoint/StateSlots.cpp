@@ -0,0 +1,96 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StateSlots.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include <unistd.h>
+#include <sys/syscall.h>
+
+namespace libtas {
+
+/* State of the table, located in our reserved memory. The table is backed
+ * by a memfd, mapped inside the region reserved for growable tables. */
+struct StateSlotsState {
+    int table_fd;
+    SlotFds* slots;
+    int capacity;
+};
+
+static StateSlotsState* getState()
+{
+    return static_cast<StateSlotsState*>(ReservedMemory::getAddr(ReservedMemory::SLOTS_ADDR));
+}
+
+void StateSlots::reserve(int index)
+{
+    StateSlotsState* st = getState();
+
+    if (index < st->capacity)
+        return;
+
+    if (!st->table_fd) {
+        st->table_fd = syscall(SYS_memfd_create, "stateslots", 0);
+        MYASSERT(st->table_fd != -1)
+    }
+
+    int capacity = st->capacity ? st->capacity : 1024;
+    while (capacity <= index)
+        capacity *= 2;
+
+    /* New slots are filled with zeros by the kernel */
+    size_t size = capacity * sizeof(SlotFds);
+    MYASSERT(ftruncate(st->table_fd, size) == 0)
+
+    void* addr = ReservedMemory::mapTable(ReservedMemory::SLOTS_TABLE, st->table_fd, size);
+    MYASSERT(addr != nullptr)
+
+    st->slots = static_cast<SlotFds*>(addr);
+    st->capacity = capacity;
+}
+
+int StateSlots::getPagemapFd(int index)
+{
+    StateSlotsState* st = getState();
+    if ((index < 0) || (index >= st->capacity)) return 0;
+    return st->slots[index].pagemap_fd;
+}
+
+int StateSlots::getPagesFd(int index)
+{
+    StateSlotsState* st = getState();
+    if ((index < 0) || (index >= st->capacity)) return 0;
+    return st->slots[index].pages_fd;
+}
+
+void StateSlots::setPagemapFd(int index, int fd)
+{
+    StateSlotsState* st = getState();
+    MYASSERT((index >= 0) && (index < st->capacity))
+    st->slots[index].pagemap_fd = fd;
+}
+
+void StateSlots::setPagesFd(int index, int fd)
+{
+    StateSlotsState* st = getState();
+    MYASSERT((index >= 0) && (index < st->capacity))
+    st->slots[index].pages_fd = fd;
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_STATESLOTS_H
+#define LIBTAS_STATESLOTS_H
+
+/* Table of the memfds holding each savestate stored in RAM, indexed by the
+ * savestate index. The table lives in its own mapping, which is not saved
+ * in savestates, and its location is kept in our reserved memory, so that
+ * it survives state loading. Reading the table never allocates memory.
+ *
+ * The table is backed by a memfd named "stateslots", holding one SlotFds
+ * per savestate index, which the program reads to access savestates.
+ */
+
+namespace libtas {
+
+struct SlotFds {
+    int pagemap_fd;
+    int pages_fd;
+};
+
+namespace StateSlots
+{
+    /* Make sure that the table can hold the savestate of the given index.
+     * Growing the table changes its mapping, so it must be called before
+     * parsing the memory mapping of the process. */
+    void reserve(int index);
+
+    /* Get the memfds of a savestate, or 0 if there is none */
+    int getPagemapFd(int index);
+    int getPagesFd(int index);
+
+    /* Set the memfds of a savestate. The table must hold the index. */
+    void setPagemapFd(int index, int fd);
+    void setPagesFd(int index, int fd);
+};
+}
+
+#endif
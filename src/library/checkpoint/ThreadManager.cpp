@@ -29,6 +29,7 @@
 #include "ThreadManager.h"
 #include "ThreadSync.h"
 #include "Checkpoint.h"
+#include "CheckpointStats.h"
 #include "../timewrappers.h" // clock_gettime
 #include "../threadwrappers.h" // getThreadId
 #include "../logging.h"
@@ -364,8 +365,12 @@ void ThreadManager::checkpoint()
     /* We save the alternate stack if the game did set one */
     AltStack::saveStack();
 
+    CheckpointStats::start(SavestateStats::SAVE);
+
     /* Sending a suspend signal to all threads */
+    uint64_t suspend_ticks = CheckpointStats::ticks();
     suspendThreads();
+    CheckpointStats::addTicks(CheckpointStats::SUSPEND, CheckpointStats::ticks() - suspend_ticks);
 
     /* We flag all opened files as tracked and store their offset. */
     FileHandleList::trackAllFiles();
@@ -390,7 +395,12 @@ void ThreadManager::checkpoint()
     /* We recover the offset of all opened files */
     FileHandleList::recoverAllFiles();
 
+    /* When a state was loaded, we get here with the memory of the savestate,
+     * but statistics are preserved */
+    uint64_t resume_ticks = CheckpointStats::ticks();
     resumeThreads();
+    CheckpointStats::addTicks(CheckpointStats::RESUME, CheckpointStats::ticks() - resume_ticks);
+    CheckpointStats::finish();
 
     /* Restoring the original signal handlers */
     CustomSignals::restoreHandlers();
@@ -427,7 +437,11 @@ void ThreadManager::restore()
 
     restoreInProgress = false;
 
+    CheckpointStats::start(SavestateStats::LOAD);
+
+    uint64_t suspend_ticks = CheckpointStats::ticks();
     suspendThreads();
+    CheckpointStats::addTicks(CheckpointStats::SUSPEND, CheckpointStats::ticks() - suspend_ticks);
 
     restoreInProgress = true;
 
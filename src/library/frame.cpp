@@ -34,6 +34,8 @@
 #include "threadwrappers.h" // isMainThread()
 #include "checkpoint/ThreadManager.h"
 #include "checkpoint/Checkpoint.h"
+#include "checkpoint/StateFlusher.h"
+#include "checkpoint/CheckpointStats.h"
 #include "ScreenCapture.h"
 #include "WindowTitle.h"
 #include "EventQueue.h"
@@ -199,6 +201,22 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
      * boundary.
      */
 
+    /* Notify the program of savestates written in background */
+    int flushed_index;
+    bool flush_succeeded;
+    if (StateFlusher::pollDone(flushed_index, flush_succeeded)) {
+        if (flush_succeeded) {
+            sendMessage(MSGB_SAVESTATE_DURABLE);
+            sendData(&flushed_index, sizeof(int));
+        }
+        else {
+            std::string flush_error = "Could not write savestate ";
+            flush_error += std::to_string(flushed_index) + " on disk";
+            debuglog(LCF_CHECKPOINT | LCF_ERROR, flush_error);
+            setAlertMsg(flush_error);
+        }
+    }
+
     /* Send error messages */
     std::string alert;
     while (getAlertMsg(alert)) {
@@ -212,6 +230,13 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
     struct timespec ticks = detTimer.getTicks();
     sendData(&ticks, sizeof(struct timespec));
 
+    /* Send statistics of the last savestate operation */
+    SavestateStats savestate_stats;
+    if (CheckpointStats::pollStats(savestate_stats)) {
+        sendMessage(MSGB_SAVESTATE_STATS);
+        sendData(&savestate_stats, sizeof(SavestateStats));
+    }
+
     /* Send GameInfo struct if needed */
     if (game_info.tosend) {
         sendMessage(MSGB_GAMEINFO);
@@ -602,6 +627,10 @@ static void receive_messages(std::function<void()> draw)
 
                 break;
 
+            case MSGN_DROP_STATE:
+                Checkpoint::dropSavestate();
+                break;
+
             case MSGN_STOP_ENCODE:
                 if (avencoder) {
                     debuglog(LCF_DUMP, "Stop AV dumping");
@@ -31,6 +31,7 @@
 #include "inputs/inputs.h"
 #include "checkpoint/ThreadManager.h"
 #include "checkpoint/Checkpoint.h"
+#include "checkpoint/StateFlusher.h"
 #include "audio/AudioContext.h"
 #include "encoding/AVEncoder.h"
 #include <unistd.h> // getpid()
@@ -128,6 +129,9 @@ void __attribute__((constructor)) init(void)
 
 void __attribute__((destructor)) term(void)
 {
+    /* Finish writing the last savestate on disk */
+    StateFlusher::wait();
+
     ThreadManager::deallocateThreads();
 
     sendMessage(MSGB_QUIT);
@@ -153,6 +153,12 @@ void Config::save(const std::string& gamepath) {
     settings.setValue("save_screenpixels", sc.save_screenpixels);
     settings.setValue("incremental_savestates", sc.incremental_savestates);
     settings.setValue("savestates_in_ram", sc.savestates_in_ram);
+    settings.setValue("savestates_compression", sc.savestates_compression);
+    settings.setValue("savestates_deduplication", sc.savestates_deduplication);
+    settings.setValue("savestates_async", sc.savestates_async);
+    settings.setValue("savestates_lazy", sc.savestates_lazy);
+    settings.setValue("savestates_chain_length", sc.savestates_chain_length);
+    settings.setValue("savestate_threads", sc.savestate_threads);
     settings.setValue("backtrack_savestate", sc.backtrack_savestate);
 
     settings.endGroup();
@@ -264,6 +270,12 @@ void Config::load(const std::string& gamepath) {
     sc.save_screenpixels = settings.value("save_screenpixels", sc.save_screenpixels).toBool();
     sc.incremental_savestates = settings.value("incremental_savestates", sc.incremental_savestates).toBool();
     sc.savestates_in_ram = settings.value("savestates_in_ram", sc.savestates_in_ram).toBool();
+    sc.savestates_compression = settings.value("savestates_compression", sc.savestates_compression).toBool();
+    sc.savestates_deduplication = settings.value("savestates_deduplication", sc.savestates_deduplication).toBool();
+    sc.savestates_async = settings.value("savestates_async", sc.savestates_async).toBool();
+    sc.savestates_lazy = settings.value("savestates_lazy", sc.savestates_lazy).toBool();
+    sc.savestates_chain_length = settings.value("savestates_chain_length", sc.savestates_chain_length).toInt();
+    sc.savestate_threads = settings.value("savestate_threads", sc.savestate_threads).toInt();
     sc.backtrack_savestate = settings.value("backtrack_savestate", sc.backtrack_savestate).toBool();
     sc.opengl_soft = settings.value("opengl_soft", sc.opengl_soft).toBool();
 
@@ -36,6 +36,7 @@
 #include <sstream>
 #include <iostream>
 #include <cerrno>
+#include <cstdio> // remove
 #include <unistd.h> // fork()
 #include <fcntl.h> // O_RDWR, O_CREAT
 #include <future>
@@ -301,6 +302,7 @@ void GameLoop::init()
 
     /* Remove savestates again in case we did not exist cleanly the previous time */
     remove_savestates(context);
+    flushing_savestates.clear();
 
     /* Remove the file socket */
     removeSocket();
@@ -441,13 +443,13 @@ void GameLoop::initProcessMessages()
     /* Build and send the backtrack savestate path/index */
     if (context->config.sc.backtrack_savestate) {
         sendMessage(MSGN_BACKTRACK_SAVESTATE_INDEX);
-        int index = 10;
+        int index = BACKTRACK_SAVESTATE_SLOT;
         sendData(&index, sizeof(int));
 
         if (!context->config.sc.savestates_in_ram) {
             std::string basesavestatepath = context->config.savestatedir + '/';
             basesavestatepath += context->gamename;
-            basesavestatepath += ".state10";
+            basesavestatepath += ".state" + std::to_string(BACKTRACK_SAVESTATE_SLOT);
             sendMessage(MSGN_BACKTRACK_SAVESTATE_PATH);
             sendString(basesavestatepath);
         }
@@ -467,6 +469,8 @@ bool GameLoop::startFrameMessages()
 
     while (message != MSGB_START_FRAMEBOUNDARY) {
         float fps, lfps;
+        int statei;
+        SavestateStats savestate_stats;
         switch (message) {
         case MSGB_WINDOW_ID:
             receiveData(&context->game_window, sizeof(Window));
@@ -512,6 +516,15 @@ bool GameLoop::startFrameMessages()
         case MSGB_ENCODING_SEGMENT:
             receiveData(&context->encoding_segment, sizeof(int));
             break;
+        case MSGB_SAVESTATE_DURABLE:
+            receiveData(&statei, sizeof(int));
+            flushing_savestates.erase(statei);
+            emit savestateDurable(statei);
+            break;
+        case MSGB_SAVESTATE_STATS:
+            receiveData(&savestate_stats, sizeof(SavestateStats));
+            emit savestateStatsReceived(savestate_stats);
+            break;
         case MSGB_QUIT:
             if (context->config.dumping) {
                 /* Finished running a dump from the command line */
@@ -734,74 +747,8 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
         case HOTKEY_SAVESTATE7:
         case HOTKEY_SAVESTATE8:
         case HOTKEY_SAVESTATE9:
-        {
-            /* Perform a savestate:
-             * - save the moviefile if we are recording
-             * - tell the game to save its state
-             */
-
-            /* Saving is not allowed if currently encoding */
-            if (context->config.sc.av_dumping) {
-                emit alertToShow(QString("Saving is not allowed when in the middle of video encoding"));
-                return false;
-            }
-
-            /* Slot number */
-            int statei = hk.type - HOTKEY_SAVESTATE1 + 1;
-
-            if (context->config.sc.recording != SharedConfig::NO_RECORDING) {
-                /* Building the movie path */
-                std::string moviepath = context->config.savestatedir + '/';
-                moviepath += context->gamename;
-                moviepath += ".movie" + std::to_string(statei) + ".ltm";
-
-                /* Save the movie file */
-                movie.saveMovie(moviepath, context->framecount);
-            }
-
-            /* Send the savestate index */
-            sendMessage(MSGN_SAVESTATE_INDEX);
-            sendData(&statei, sizeof(int));
-
-            /* Send the savestate path */
-            std::string savestatepath = context->config.savestatedir + '/';
-            savestatepath += context->gamename;
-            savestatepath += ".state" + std::to_string(statei);
-            if (! context->config.sc.savestates_in_ram) {
-                sendMessage(MSGN_SAVESTATE_PATH);
-                sendString(savestatepath);
-            }
-            else {
-                /* Create empty savestate files if stored in RAM */
-                std::string pagemappath = savestatepath + ".pm";
-                std::string pagespath = savestatepath + ".p";
-                std::ofstream opm(pagemappath);
-                opm.close();
-                std::ofstream op(pagespath);
-                op.close();
-            }
-
-            if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
-                std::string msg = "Saving state ";
-                msg += std::to_string(statei);
-                sendMessage(MSGN_OSD_MSG);
-                sendString(msg);
-            }
-
-            sendMessage(MSGN_SAVESTATE);
-
-            if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
-                std::string message = "State ";
-                message += std::to_string(statei);
-                message += " saved";
-                sendMessage(MSGN_OSD_MSG);
-                sendString(message);
-            }
-
-            emit savestatePerformed(statei, context->framecount);
-
+            saveState(hk.type - HOTKEY_SAVESTATE1 + 1);
             return false;
-        }
 
         case HOTKEY_LOADSTATE1:
         case HOTKEY_LOADSTATE2:
@@ -813,236 +760,8 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
         case HOTKEY_LOADSTATE8:
         case HOTKEY_LOADSTATE9:
         case HOTKEY_LOADSTATE_BACKTRACK:
-
-            /* Load a savestate:
-             * - check for an existing savestate in the slot
-             * - if in read-only move, we must check that the movie
-                 associated with the savestate must be a prefix of the
-                 current movie
-             * - tell the game to load its state
-             * - if loading succeeded:
-             * -- send the shared config
-             * -- increment the rerecord count
-             * -- receive the frame count and the current time
-             */
-        {
-
-            /* Loading is not allowed if currently encoding */
-            if (context->config.sc.av_dumping) {
-                emit alertToShow(QString("Loading is not allowed when in the middle of video encoding"));
-                return false;
-            }
-
-            /* Slot number */
-            int statei = hk.type - HOTKEY_LOADSTATE1 + 1;
-
-            /* Send the savestate index */
-            sendMessage(MSGN_SAVESTATE_INDEX);
-            sendData(&statei, sizeof(int));
-
-            /* Building the movie path */
-            std::string moviepath = context->config.savestatedir + '/';
-            moviepath += context->gamename;
-            moviepath += ".movie" + std::to_string(statei) + ".ltm";
-
-            /* Building the savestate path */
-            std::string savestatepath = context->config.savestatedir + '/';
-            savestatepath += context->gamename;
-            savestatepath += ".state" + std::to_string(statei);
-
-            /* Check that the savestate exists */
-            std::string pagemappath = savestatepath + ".pm";
-            std::string pagespath = savestatepath + ".p";
-            if ((access(pagemappath.c_str(), F_OK) != 0) || (access(pagespath.c_str(), F_OK) != 0)) {
-                /* If there is no savestate but a movie file, offer to load
-                 * the movie and fast-forward to the savestate movie frame.
-                 */
-                if ((context->config.sc.recording != SharedConfig::NO_RECORDING) &&
-                    (access(moviepath.c_str(), F_OK) == 0)) {
-
-                    /* Ask the user if they want to load the movie, and get the answer.
-                     * Prompting a alert window must be done by the UI thread, so we are
-                     * using std::future/std::promise mechanism.
-                     */
-                    std::promise<bool> answer;
-                    std::future<bool> future = answer.get_future();
-                    emit askToShow(QString("There is a savestate in that slot from a previous game iteration. Do you want to load the associated movie?"), &answer);
-
-                    if (! future.get()) {
-                        /* User answered no */
-                        return false;
-                    }
-
-                    /* Load the savestate movie */
-                    MovieFile savedmovie(context);
-                    int ret = savedmovie.loadInputs(moviepath);
-                    if (ret < 0) {
-                        emit alertToShow(QString("Could not load the moviefile associated with the savestate"));
-                        return false;
-                    }
-
-                    /* Checking if our movie is a prefix of the savestate movie */
-                    if (!savedmovie.isPrefix(movie, context->framecount)) {
-                        /* Not a prefix, we don't allow loading */
-                        emit alertToShow(QString("We already diverged from the savestate movie"));
-                        return false;
-                    }
-
-                    /* Loading the movie */
-                    emit inputsToBeChanged();
-                    movie.loadInputs(moviepath);
-                    emit inputsChanged();
-
-                    /* Return if we already are on the correct frame */
-                    if (context->framecount == movie.savestateFramecount())
-                        return false;
-
-                    /* Fast-forward to savestate frame */
-                    context->config.sc.recording = SharedConfig::RECORDING_READ;
-                    context->config.sc.movie_framecount = movie.nbFrames();
-                    context->pause_frame = movie.savestateFramecount();
-                    context->config.sc.running = true;
-                    context->config.sc.fastforward = true;
-                    context->config.sc_modified = true;
-
-                    emit sharedConfigChanged();
-
-                    return false;
-                }
-
-                else {
-                    if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
-                        std::string message = "No savestate in slot ";
-                        message += std::to_string(statei);
-                        sendMessage(MSGN_OSD_MSG);
-                        sendString(message);
-                    }
-                    else {
-                        emit alertToShow(QString("There is no savestate to load in this slot"));
-                    }
-                    return false;
-                }
-            }
-
-            /* Send savestate path */
-            if (! context->config.sc.savestates_in_ram) {
-                sendMessage(MSGN_SAVESTATE_PATH);
-                sendString(savestatepath);
-            }
-
-
-            /* When loading in read mode, we don't allow loading a non-prefix movie */
-            if (context->config.sc.recording == SharedConfig::RECORDING_READ) {
-
-                /* Checking if the savestate movie is a prefix of our movie */
-                MovieFile savedmovie(context);
-                int ret = savedmovie.loadInputs(moviepath);
-                if (ret < 0) {
-                    emit alertToShow(QString("Could not load the moviefile associated with the savestate"));
-                    return false;
-                }
-
-                if (!movie.isPrefix(savedmovie)) {
-                    /* Not a prefix, we don't allow loading */
-                    if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
-                        sendMessage(MSGN_OSD_MSG);
-                        sendString(std::string("Savestate inputs mismatch"));
-                    }
-                    else {
-                        emit alertToShow(QString("Trying to load a state in read-only but the inputs mismatch"));
-                    }
-                    return false;
-                }
-            }
-
-            if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
-                std::string msg;
-                if (hk.type == HOTKEY_LOADSTATE_BACKTRACK) {
-                    msg = "Loading backtrack state ";
-                }
-                else {
-                    msg = "Loading state ";
-                    msg += std::to_string(statei);
-                }
-                sendMessage(MSGN_OSD_MSG);
-                sendString(msg);
-            }
-
-            sendMessage(MSGN_LOADSTATE);
-
-            emit inputsToBeChanged();
-
-            int message = receiveMessage();
-            /* Loading is not assured to succeed, the following must
-             * only be done if it's the case.
-             */
-
-            bool didLoad = message == MSGB_LOADING_SUCCEEDED;
-            if (didLoad) {
-                /* The copy of SharedConfig that the game stores may not
-                 * be the same as this one due to memory loading, so we
-                 * send it.
-                 */
-                sendMessage(MSGN_CONFIG);
-                sendData(&context->config.sc, sizeof(SharedConfig));
-
-                if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
-                    /* When in writing move, we load the movie associated
-                     * with the savestate.
-                     */
-                    movie.loadInputs(moviepath);
-                }
-
-                /* If the movie was modified since last state load, increment
-                 * the rerecord count. */
-                if (movie.modifiedSinceLastStateLoad) {
-                    context->rerecord_count++;
-                    emit rerecordChanged();
-                    movie.modifiedSinceLastStateLoad = false;
-                }
-
-                message = receiveMessage();
-
-                emit savestatePerformed(statei, 0);
-            }
-
-            /* The frame count has changed, we must get the new one */
-            if (message != MSGB_FRAMECOUNT_TIME) {
-                std::cerr << "Got wrong message after state loading" << std::endl;
-
-                if (!context->config.sc.opengl_soft) {
-                    emit alertToShow(QString("Crash after loading the savestate. Savestates are unstable unless you check Video>Force software rendering"));
-                }
-
-                return false;
-            }
-            receiveData(&context->framecount, sizeof(unsigned long));
-            if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
-                context->config.sc.movie_framecount = context->framecount;
-            }
-            receiveData(&context->current_time, sizeof(struct timespec));
-
-            emit inputsChanged();
-            emit frameCountChanged();
-
-            if (didLoad && (context->config.sc.osd & SharedConfig::OSD_MESSAGES)) {
-                std::string msg;
-                if (hk.type == HOTKEY_LOADSTATE_BACKTRACK) {
-                    msg = "Backtrack state loaded";
-                }
-                else {
-                    msg = "State ";
-                    msg += std::to_string(statei);
-                    msg += " loaded";
-                }
-                sendMessage(MSGN_OSD_MSG);
-                sendString(msg);
-            }
-
-            sendMessage(MSGN_EXPOSE);
-
+            loadState(hk.type - HOTKEY_LOADSTATE1 + 1);
             return false;
-        }
 
         case HOTKEY_READWRITE:
             /* Switch between movie write and read-only */
@@ -1178,6 +897,344 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
 }
 
 
+bool GameLoop::saveState(int statei)
+{
+    /* Perform a savestate:
+     * - save the moviefile if we are recording
+     * - tell the game to save its state
+     */
+
+    /* Saving is not allowed if currently encoding */
+    if (context->config.sc.av_dumping) {
+        emit alertToShow(QString("Saving is not allowed when in the middle of video encoding"));
+        return false;
+    }
+
+    if (context->config.sc.recording != SharedConfig::NO_RECORDING) {
+        /* Building the movie path */
+        std::string moviepath = context->config.savestatedir + '/';
+        moviepath += context->gamename;
+        moviepath += ".movie" + std::to_string(statei) + ".ltm";
+
+        /* Save the movie file */
+        movie.saveMovie(moviepath, context->framecount);
+    }
+
+    /* Send the savestate index */
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    /* Send the savestate path */
+    std::string savestatepath = context->config.savestatedir + '/';
+    savestatepath += context->gamename;
+    savestatepath += ".state" + std::to_string(statei);
+    if (! context->config.sc.savestates_in_ram) {
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+    else {
+        /* Create empty savestate files if stored in RAM */
+        std::string pagemappath = savestatepath + ".pm";
+        std::string pagespath = savestatepath + ".p";
+        std::ofstream opm(pagemappath);
+        opm.close();
+        std::ofstream op(pagespath);
+        op.close();
+    }
+
+    if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+        std::string msg = "Saving state ";
+        msg += std::to_string(statei);
+        sendMessage(MSGN_OSD_MSG);
+        sendString(msg);
+    }
+
+    sendMessage(MSGN_SAVESTATE);
+
+    /* The savestate files may only be complete after a few frames */
+    if (context->config.sc.savestates_async && !context->config.sc.savestates_in_ram) {
+        flushing_savestates.insert(statei);
+    }
+
+    if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+        std::string message = "State ";
+        message += std::to_string(statei);
+        message += " saved";
+        sendMessage(MSGN_OSD_MSG);
+        sendString(message);
+    }
+
+    emit savestatePerformed(statei, context->framecount);
+
+    return true;
+}
+
+bool GameLoop::loadState(int statei)
+{
+    /* Load a savestate:
+     * - check for an existing savestate in the slot
+     * - if in read-only move, we must check that the movie
+         associated with the savestate must be a prefix of the
+         current movie
+     * - tell the game to load its state
+     * - if loading succeeded:
+     * -- send the shared config
+     * -- increment the rerecord count
+     * -- receive the frame count and the current time
+     */
+
+    /* Loading is not allowed if currently encoding */
+    if (context->config.sc.av_dumping) {
+        emit alertToShow(QString("Loading is not allowed when in the middle of video encoding"));
+        return false;
+    }
+
+    /* Send the savestate index */
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    /* Building the movie path */
+    std::string moviepath = context->config.savestatedir + '/';
+    moviepath += context->gamename;
+    moviepath += ".movie" + std::to_string(statei) + ".ltm";
+
+    /* Building the savestate path */
+    std::string savestatepath = context->config.savestatedir + '/';
+    savestatepath += context->gamename;
+    savestatepath += ".state" + std::to_string(statei);
+
+    /* Check that the savestate exists, or is being written by the game */
+    std::string pagemappath = savestatepath + ".pm";
+    std::string pagespath = savestatepath + ".p";
+    if (!flushing_savestates.count(statei) &&
+        ((access(pagemappath.c_str(), F_OK) != 0) || (access(pagespath.c_str(), F_OK) != 0))) {
+        /* If there is no savestate but a movie file, offer to load
+         * the movie and fast-forward to the savestate movie frame.
+         */
+        if ((context->config.sc.recording != SharedConfig::NO_RECORDING) &&
+            (access(moviepath.c_str(), F_OK) == 0)) {
+
+            /* Ask the user if they want to load the movie, and get the answer.
+             * Prompting a alert window must be done by the UI thread, so we are
+             * using std::future/std::promise mechanism.
+             */
+            std::promise<bool> answer;
+            std::future<bool> future = answer.get_future();
+            emit askToShow(QString("There is a savestate in that slot from a previous game iteration. Do you want to load the associated movie?"), &answer);
+
+            if (! future.get()) {
+                /* User answered no */
+                return false;
+            }
+
+            /* Load the savestate movie */
+            MovieFile savedmovie(context);
+            int ret = savedmovie.loadInputs(moviepath);
+            if (ret < 0) {
+                emit alertToShow(QString("Could not load the moviefile associated with the savestate"));
+                return false;
+            }
+
+            /* Checking if our movie is a prefix of the savestate movie */
+            if (!savedmovie.isPrefix(movie, context->framecount)) {
+                /* Not a prefix, we don't allow loading */
+                emit alertToShow(QString("We already diverged from the savestate movie"));
+                return false;
+            }
+
+            /* Loading the movie */
+            emit inputsToBeChanged();
+            movie.loadInputs(moviepath);
+            emit inputsChanged();
+
+            /* Return if we already are on the correct frame */
+            if (context->framecount == movie.savestateFramecount())
+                return false;
+
+            /* Fast-forward to savestate frame */
+            context->config.sc.recording = SharedConfig::RECORDING_READ;
+            context->config.sc.movie_framecount = movie.nbFrames();
+            context->pause_frame = movie.savestateFramecount();
+            context->config.sc.running = true;
+            context->config.sc.fastforward = true;
+            context->config.sc_modified = true;
+
+            emit sharedConfigChanged();
+
+            return false;
+        }
+
+        else {
+            if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+                std::string message = "No savestate in slot ";
+                message += std::to_string(statei);
+                sendMessage(MSGN_OSD_MSG);
+                sendString(message);
+            }
+            else {
+                emit alertToShow(QString("There is no savestate to load in this slot"));
+            }
+            return false;
+        }
+    }
+
+    /* Send savestate path */
+    if (! context->config.sc.savestates_in_ram) {
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+
+
+    /* When loading in read mode, we don't allow loading a non-prefix movie */
+    if (context->config.sc.recording == SharedConfig::RECORDING_READ) {
+
+        /* Checking if the savestate movie is a prefix of our movie */
+        MovieFile savedmovie(context);
+        int ret = savedmovie.loadInputs(moviepath);
+        if (ret < 0) {
+            emit alertToShow(QString("Could not load the moviefile associated with the savestate"));
+            return false;
+        }
+
+        if (!movie.isPrefix(savedmovie)) {
+            /* Not a prefix, we don't allow loading */
+            if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+                sendMessage(MSGN_OSD_MSG);
+                sendString(std::string("Savestate inputs mismatch"));
+            }
+            else {
+                emit alertToShow(QString("Trying to load a state in read-only but the inputs mismatch"));
+            }
+            return false;
+        }
+    }
+
+    if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+        std::string msg;
+        if (statei == BACKTRACK_SAVESTATE_SLOT) {
+            msg = "Loading backtrack state ";
+        }
+        else {
+            msg = "Loading state ";
+            msg += std::to_string(statei);
+        }
+        sendMessage(MSGN_OSD_MSG);
+        sendString(msg);
+    }
+
+    sendMessage(MSGN_LOADSTATE);
+
+    emit inputsToBeChanged();
+
+    int message = receiveMessage();
+    /* Loading is not assured to succeed, the following must
+     * only be done if it's the case.
+     */
+
+    bool didLoad = message == MSGB_LOADING_SUCCEEDED;
+    if (didLoad) {
+        /* The copy of SharedConfig that the game stores may not
+         * be the same as this one due to memory loading, so we
+         * send it.
+         */
+        sendMessage(MSGN_CONFIG);
+        sendData(&context->config.sc, sizeof(SharedConfig));
+
+        if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+            /* When in writing move, we load the movie associated
+             * with the savestate.
+             */
+            movie.loadInputs(moviepath);
+        }
+
+        /* If the movie was modified since last state load, increment
+         * the rerecord count. */
+        if (movie.modifiedSinceLastStateLoad) {
+            context->rerecord_count++;
+            emit rerecordChanged();
+            movie.modifiedSinceLastStateLoad = false;
+        }
+
+        message = receiveMessage();
+
+        emit savestatePerformed(statei, 0);
+    }
+
+    /* The frame count has changed, we must get the new one */
+    if (message != MSGB_FRAMECOUNT_TIME) {
+        std::cerr << "Got wrong message after state loading" << std::endl;
+
+        if (!context->config.sc.opengl_soft) {
+            emit alertToShow(QString("Crash after loading the savestate. Savestates are unstable unless you check Video>Force software rendering"));
+        }
+
+        return false;
+    }
+    receiveData(&context->framecount, sizeof(unsigned long));
+    if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+        context->config.sc.movie_framecount = context->framecount;
+    }
+    receiveData(&context->current_time, sizeof(struct timespec));
+
+    emit inputsChanged();
+    emit frameCountChanged();
+
+    if (didLoad && (context->config.sc.osd & SharedConfig::OSD_MESSAGES)) {
+        std::string msg;
+        if (statei == BACKTRACK_SAVESTATE_SLOT) {
+            msg = "Backtrack state loaded";
+        }
+        else {
+            msg = "State ";
+            msg += std::to_string(statei);
+            msg += " loaded";
+        }
+        sendMessage(MSGN_OSD_MSG);
+        sendString(msg);
+    }
+
+    sendMessage(MSGN_EXPOSE);
+
+    return didLoad;
+}
+
+bool GameLoop::dropState(int statei)
+{
+    /* All incremental savestates depend on the base savestate */
+    if ((statei == 0) && context->config.sc.incremental_savestates) {
+        return false;
+    }
+
+    /* Send the savestate index */
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    /* Send the savestate path */
+    std::string savestatepath = context->config.savestatedir + '/';
+    savestatepath += context->gamename;
+    savestatepath += ".state" + std::to_string(statei);
+    if (! context->config.sc.savestates_in_ram) {
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+
+    sendMessage(MSGN_DROP_STATE);
+    flushing_savestates.erase(statei);
+
+    /* Remove the savestate files and the associated movie */
+    std::string pagemappath = savestatepath + ".pm";
+    std::string pagespath = savestatepath + ".p";
+    remove(pagemappath.c_str());
+    remove(pagespath.c_str());
+
+    std::string moviepath = context->config.savestatedir + '/';
+    moviepath += context->gamename;
+    moviepath += ".movie" + std::to_string(statei) + ".ltm";
+    remove(moviepath.c_str());
+
+    return true;
+}
+
 void GameLoop::sleepSendPreview()
 {
     /* Sleep a bit to not surcharge the processor */
@@ -22,9 +22,11 @@
 
 #include <QObject>
 #include <memory>
+#include <set>
 
 #include "Context.h"
 #include "MovieFile.h"
+#include "../shared/SavestateStats.h"
 #include <xcb/xcb_keysyms.h>
 
 class GameLoop : public QObject {
@@ -34,6 +36,21 @@ public:
     void start();
     MovieFile movie;
 
+    /* Savestate slots. Slots 1 to 9 are used by hotkeys, and slot 0 stores
+     * the base savestate of incremental savestates. Slots starting from
+     * FIRST_FREE_SAVESTATE_SLOT can be freely used. */
+    enum {
+        BACKTRACK_SAVESTATE_SLOT = 10,
+        FIRST_FREE_SAVESTATE_SLOT = 11,
+    };
+
+    /* Save, load or drop the savestate of a slot. Returns if the operation
+     * succeeded. These must be called from the game loop thread, while the
+     * game is processing messages at a frame boundary. */
+    bool saveState(int statei);
+    bool loadState(int statei);
+    bool dropState(int statei);
+
 private:
     Context* context;
 
@@ -53,6 +70,9 @@ private:
     /* Last saved/loaded savestate */
     int current_savestate;
 
+    /* Savestates that the game is still writing on disk in background */
+    std::set<int> flushing_savestates;
+
     /* Inputs from the previous frame */
     AllInputs prev_ai;
 
@@ -120,6 +140,12 @@ signals:
 
     /* register a savestate */
     void savestatePerformed(int slot, unsigned long frame);
+
+    /* A savestate written in background is entirely on disk */
+    void savestateDurable(int slot);
+
+    /* Statistics of a savestate or state loading were received */
+    void savestateStatsReceived(SavestateStats stats);
 };
 
 #endif
@@ -0,0 +1,46 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CompareKernels.h"
+#include "CompareKernelsImpl.h"
+
+template <class T>
+void compareValues(const T* values, const T* previous, T compare_value, size_t count, CompareType compare_type, CompareOperator compare_operator, uint64_t* matches)
+{
+#ifdef LIBTAS_HAS_AVX2_KERNELS
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) {
+        compareValuesAVX2(values, previous, compare_value, count, compare_type, compare_operator, matches);
+        return;
+    }
+#endif
+
+    compareDispatch(values, previous, compare_value, count, compare_type, compare_operator, matches);
+}
+
+template void compareValues(const unsigned char*, const unsigned char*, unsigned char, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const char*, const char*, char, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const unsigned short*, const unsigned short*, unsigned short, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const short*, const short*, short, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const unsigned int*, const unsigned int*, unsigned int, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const int*, const int*, int, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const uint64_t*, const uint64_t*, uint64_t, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const int64_t*, const int64_t*, int64_t, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const float*, const float*, float, size_t, CompareType, CompareOperator, uint64_t*);
+template void compareValues(const double*, const double*, double, size_t, CompareType, CompareOperator, uint64_t*);
@@ -0,0 +1,44 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_COMPAREKERNELS_H_INCLUDED
+#define LIBTAS_COMPAREKERNELS_H_INCLUDED
+
+#include "CompareEnums.h"
+#include <cstdint>
+#include <cstddef>
+
+/* Compare a contiguous array of values, and store the result as a bitmap of
+ * matching values: bit i%64 of word i/64 is set if value i matches.
+ *
+ * Kernels are vectorized with SSE2, and with AVX2 if the processor supports
+ * it, which is checked at runtime. They are instantiated for all types of
+ * TypeIndex.h. */
+
+/* Compare `count` values to their previous values, or to `compare_value`,
+ * and fill the `(count+63)/64` words of `matches`. Values that are NaN or
+ * infinite never match. */
+template <class T>
+void compareValues(const T* values, const T* previous, T compare_value, size_t count, CompareType compare_type, CompareOperator compare_operator, uint64_t* matches);
+
+/* Same function, only compiled with AVX2 enabled */
+template <class T>
+void compareValuesAVX2(const T* values, const T* previous, T compare_value, size_t count, CompareType compare_type, CompareOperator compare_operator, uint64_t* matches);
+
+#endif
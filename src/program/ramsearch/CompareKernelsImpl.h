@@ -0,0 +1,234 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_COMPAREKERNELSIMPL_H_INCLUDED
+#define LIBTAS_COMPAREKERNELSIMPL_H_INCLUDED
+
+/* Implementation of the comparison kernels, included by each translation
+ * unit that compiles them for an instruction set. The vector width and the
+ * instructions depend on the compiler flags of the translation unit, so
+ * everything is in an unnamed namespace to keep one copy per unit. */
+
+#include "CompareEnums.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* Operators working on both scalars and GCC vectors, for which they return
+ * a mask vector */
+struct OpEqual {
+    template <class A> auto operator()(A a, A b) const -> decltype(a == b) {return a == b;}
+};
+struct OpNotEqual {
+    template <class A> auto operator()(A a, A b) const -> decltype(a != b) {return a != b;}
+};
+struct OpLess {
+    template <class A> auto operator()(A a, A b) const -> decltype(a < b) {return a < b;}
+};
+struct OpGreater {
+    template <class A> auto operator()(A a, A b) const -> decltype(a > b) {return a > b;}
+};
+struct OpLessEqual {
+    template <class A> auto operator()(A a, A b) const -> decltype(a <= b) {return a <= b;}
+};
+struct OpGreaterEqual {
+    template <class A> auto operator()(A a, A b) const -> decltype(a >= b) {return a >= b;}
+};
+
+/* Check NaN/Inf for float/double. We don't use std::isfinite, because it is
+ * an inline library function that is emitted as a weak symbol. The linker
+ * could then keep the copy compiled with AVX2 for all units. */
+template <class T>
+inline typename std::enable_if<std::is_floating_point<T>::value, bool>::type isFinite(T v)
+{
+    return __builtin_isfinite(v);
+}
+
+template <class T>
+inline typename std::enable_if<!std::is_floating_point<T>::value, bool>::type isFinite(T)
+{
+    return true;
+}
+
+/* Compare values one by one, starting from word `first_word` */
+template <class T, class Op>
+inline void compareScalar(const T* values, const T* previous, T compare_value, size_t count, uint64_t* matches, Op op, size_t first_word)
+{
+    for (size_t w = first_word; w < (count+63)/64; w++) {
+        size_t first = w*64;
+        size_t last = (first + 64 < count) ? (first + 64) : count;
+        uint64_t word = 0;
+        for (size_t i = first; i < last; i++) {
+            T ref = previous ? previous[i] : compare_value;
+            bool match = isFinite(values[i]) && op(values[i], ref);
+            word |= static_cast<uint64_t>(match) << (i - first);
+        }
+        matches[w] = word;
+    }
+}
+
+#ifdef __SSE2__
+
+#ifdef __AVX2__
+typedef __m256i MaskRegister;
+#else
+typedef __m128i MaskRegister;
+#endif
+
+static const int VECTOR_BYTES = sizeof(MaskRegister);
+
+/* Gather one bit for each lane of `size` bytes of a mask register */
+template <int size> inline uint32_t maskBits(MaskRegister m);
+
+#ifdef __AVX2__
+template <> inline uint32_t maskBits<1>(MaskRegister m)
+{
+    return _mm256_movemask_epi8(m);
+}
+
+template <> inline uint32_t maskBits<2>(MaskRegister m)
+{
+    /* Pack lanes into bytes, which are in the first 64 bits of each 128-bit
+     * half, then move both halves together */
+    __m256i packed = _mm256_packs_epi16(m, _mm256_setzero_si256());
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    return _mm256_movemask_epi8(packed) & 0xffff;
+}
+
+template <> inline uint32_t maskBits<4>(MaskRegister m)
+{
+    return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+template <> inline uint32_t maskBits<8>(MaskRegister m)
+{
+    return _mm256_movemask_pd(_mm256_castsi256_pd(m));
+}
+#else
+template <> inline uint32_t maskBits<1>(MaskRegister m)
+{
+    return _mm_movemask_epi8(m);
+}
+
+template <> inline uint32_t maskBits<2>(MaskRegister m)
+{
+    return _mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128())) & 0xff;
+}
+
+template <> inline uint32_t maskBits<4>(MaskRegister m)
+{
+    return _mm_movemask_ps(_mm_castsi128_ps(m));
+}
+
+template <> inline uint32_t maskBits<8>(MaskRegister m)
+{
+    return _mm_movemask_pd(_mm_castsi128_pd(m));
+}
+#endif
+
+/* Compare whole words of values with vectors, and the last values one by
+ * one. `compare_previous` is a template parameter so that the inner loop
+ * does not test it. */
+template <class T, bool compare_previous, class Op>
+inline void compareVector(const T* values, const T* previous, T compare_value, size_t count, uint64_t* matches, Op op)
+{
+    typedef T Vector __attribute__((vector_size(VECTOR_BYTES)));
+    static const int LANES = VECTOR_BYTES / sizeof(T);
+
+    Vector zero = {};
+    Vector ref = zero + compare_value;
+
+    size_t words = count / 64;
+    for (size_t w = 0; w < words; w++) {
+        uint64_t word = 0;
+        for (int k = 0; k < 64 / LANES; k++) {
+            size_t i = w*64 + k*LANES;
+            Vector v;
+            memcpy(&v, values + i, VECTOR_BYTES);
+            if (compare_previous)
+                memcpy(&ref, previous + i, VECTOR_BYTES);
+
+            auto mask = op(v, ref);
+
+            /* Check NaN/Inf for float/double, for which v-v is not zero */
+            if (std::is_floating_point<T>::value)
+                mask &= ((v - v) == zero);
+
+            MaskRegister m;
+            memcpy(&m, &mask, VECTOR_BYTES);
+            word |= static_cast<uint64_t>(maskBits<sizeof(T)>(m)) << (k*LANES);
+        }
+        matches[w] = word;
+    }
+
+    compareScalar(values, previous, compare_value, count, matches, op, words);
+}
+
+#endif
+
+template <class T, class Op>
+inline void compareWith(const T* values, const T* previous, T compare_value, size_t count, uint64_t* matches, Op op)
+{
+#ifdef __SSE2__
+    if (previous)
+        compareVector<T, true>(values, previous, compare_value, count, matches, op);
+    else
+        compareVector<T, false>(values, previous, compare_value, count, matches, op);
+#else
+    compareScalar(values, previous, compare_value, count, matches, op, 0);
+#endif
+}
+
+template <class T>
+inline void compareDispatch(const T* values, const T* previous, T compare_value, size_t count, CompareType compare_type, CompareOperator compare_operator, uint64_t* matches)
+{
+    if (compare_type == CompareType::Value)
+        previous = nullptr;
+
+    switch(compare_operator) {
+        case CompareOperator::Equal:
+            compareWith(values, previous, compare_value, count, matches, OpEqual());
+            break;
+        case CompareOperator::NotEqual:
+            compareWith(values, previous, compare_value, count, matches, OpNotEqual());
+            break;
+        case CompareOperator::Less:
+            compareWith(values, previous, compare_value, count, matches, OpLess());
+            break;
+        case CompareOperator::Greater:
+            compareWith(values, previous, compare_value, count, matches, OpGreater());
+            break;
+        case CompareOperator::LessEqual:
+            compareWith(values, previous, compare_value, count, matches, OpLessEqual());
+            break;
+        case CompareOperator::GreaterEqual:
+            compareWith(values, previous, compare_value, count, matches, OpGreaterEqual());
+            break;
+    }
+}
+
+}
+
+#endif
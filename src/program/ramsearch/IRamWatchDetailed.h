@@ -33,6 +33,9 @@ public:
     /* Return the current value of the ram watch as a string */
     virtual std::string value_str() = 0;
 
+    /* Format a value of the stored type, given as raw bytes */
+    virtual std::string format_value(const char* value) = 0;
+
     /* Poke a value (given as a string) into the ram watch address. Return
      * the result of process_vm_writev call
      */
@@ -41,6 +44,9 @@ public:
     /* Returns the index of the stored type */
     virtual int type() = 0;
 
+    /* Returns the size of the stored type */
+    virtual int size() = 0;
+
     uintptr_t address;
     std::string label;
     bool hex;
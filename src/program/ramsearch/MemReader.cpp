@@ -0,0 +1,72 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemReader.h"
+#include <sstream>
+#include <fstream>
+#include <iostream>
+
+size_t MemReader::read(uintptr_t addr, void* local, size_t size) const
+{
+    struct iovec remote;
+    remote.iov_base = reinterpret_cast<void*>(addr);
+    remote.iov_len = size;
+    return readv(local, &remote, 1);
+}
+
+ProcessMemReader::ProcessMemReader(pid_t p) : pid(p) {}
+
+std::vector<MemSection> ProcessMemReader::sections() const
+{
+    std::vector<MemSection> sections;
+
+    /* Compose the filename for the /proc memory map, and open it. */
+    std::ostringstream oss;
+    oss << "/proc/" << pid << "/maps";
+    std::ifstream mapsfile(oss.str());
+    if (!mapsfile) {
+        std::cerr << "Could not open " << oss.str() << std::endl;
+        return sections;
+    }
+
+    std::string line;
+    MemSection::reset();
+
+    while (std::getline(mapsfile, line)) {
+        MemSection section;
+        section.readMap(line);
+        sections.push_back(section);
+    }
+
+    return sections;
+}
+
+size_t ProcessMemReader::readv(void* local, const struct iovec* remote, size_t count) const
+{
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++)
+        size += remote[i].iov_len;
+
+    struct iovec local_range;
+    local_range.iov_base = local;
+    local_range.iov_len = size;
+
+    ssize_t ret = process_vm_readv(pid, &local_range, 1, remote, count, 0);
+    return (ret > 0) ? ret : 0;
+}
@@ -0,0 +1,64 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_MEMREADER_H_INCLUDED
+#define LIBTAS_MEMREADER_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+#include "MemSection.h"
+
+/* Source of the game memory for searches: the memory of the running game,
+ * or the memory stored in a savestate. Readers can be used from multiple
+ * threads at once. */
+class MemReader {
+    public:
+        virtual ~MemReader() {}
+
+        /* Memory sections of the game, in address order */
+        virtual std::vector<MemSection> sections() const = 0;
+
+        /* Read the `count` ranges of `remote` one after the other into
+         * `local`, like `process_vm_readv`. Reading stops at the first page
+         * that cannot be read. Returns the number of bytes read. */
+        virtual size_t readv(void* local, const struct iovec* remote, size_t count) const = 0;
+
+        /* Read a single range */
+        size_t read(uintptr_t addr, void* local, size_t size) const;
+};
+
+/* Memory of the running game */
+class ProcessMemReader : public MemReader {
+    public:
+        ProcessMemReader(pid_t pid);
+
+        /* Read from the /proc/pid/maps file */
+        std::vector<MemSection> sections() const override;
+
+        size_t readv(void* local, const struct iovec* remote, size_t count) const override;
+
+    private:
+        pid_t pid;
+};
+
+#endif
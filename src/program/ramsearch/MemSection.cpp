@@ -60,7 +60,11 @@ void MemSection::readMap(std::string& line)
         return !std::isspace(ch);
     }).base(), filename.end());
 
-    /* Determine section type */
+    detectType();
+}
+
+void MemSection::detectType()
+{
     if (!readflag) {
         type = MemNoRead;
         return;
@@ -64,6 +64,10 @@ class MemSection {
 
         /* Parse a single line from the /proc/pid/maps file. */
         void readMap(std::string& line);
+
+        /* Determine the section type from the other fields. Sections must
+         * be processed in address order, like lines of a maps file. */
+        void detectType();
 };
 
 #endif
@@ -0,0 +1,89 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemSnapshot.h"
+#include <climits> // IOV_MAX
+
+MemSnapshot::MemSnapshot(const MemReader& r) : reader(r) {}
+
+void MemSnapshot::clear()
+{
+    ranges.clear();
+    offsets.clear();
+    read_sizes.clear();
+}
+
+size_t MemSnapshot::add(uintptr_t addr, size_t size)
+{
+    struct iovec range;
+    range.iov_base = reinterpret_cast<void*>(addr);
+    range.iov_len = size;
+    ranges.push_back(range);
+    return ranges.size() - 1;
+}
+
+void MemSnapshot::extend(uintptr_t end)
+{
+    ranges.back().iov_len = end - rangeAddr(ranges.size() - 1);
+}
+
+int MemSnapshot::read()
+{
+    /* Lay out all ranges in the buffer */
+    size_t total_size = 0;
+    offsets.resize(ranges.size());
+    for (size_t i = 0; i < ranges.size(); i++) {
+        offsets[i] = total_size;
+        total_size += ranges[i].iov_len;
+    }
+    buffer.resize(total_size);
+    read_sizes.assign(ranges.size(), 0);
+
+    int calls = 0;
+    size_t first = 0;
+    while (first < ranges.size()) {
+        size_t count = ranges.size() - first;
+        if (count > IOV_MAX)
+            count = IOV_MAX;
+
+        size_t done = reader.readv(buffer.data() + offsets[first], &ranges[first], count);
+        calls++;
+
+        /* Ranges are read in order, until one cannot be read entirely */
+        size_t i = first;
+        for (; (i < first + count) && (done >= ranges[i].iov_len); i++) {
+            read_sizes[i] = ranges[i].iov_len;
+            done -= ranges[i].iov_len;
+        }
+
+        if (i < first + count) {
+            /* Range `i` was partially read or not at all, skip it */
+            read_sizes[i] = done;
+            i++;
+        }
+        first = i;
+    }
+
+    return calls;
+}
+
+bool MemSnapshot::readValue(uintptr_t addr, void* value, size_t size) const
+{
+    return reader.read(addr, value, size) == size;
+}
@@ -0,0 +1,70 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_MEMSNAPSHOT_H_INCLUDED
+#define LIBTAS_MEMSNAPSHOT_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "MemReader.h"
+
+/* Copy of ranges of the game memory. Ranges are queued, then read all at
+ * once with as few calls to the reader as possible, each call reading up to
+ * IOV_MAX ranges into a single buffer. */
+class MemSnapshot {
+    public:
+        MemSnapshot(const MemReader& reader);
+
+        /* Remove all ranges */
+        void clear();
+
+        /* Queue a range of memory, and return its index */
+        size_t add(uintptr_t addr, size_t size);
+
+        /* Extend the last queued range up to `end` */
+        void extend(uintptr_t end);
+
+        size_t rangeCount() const {return ranges.size();}
+        uintptr_t rangeAddr(size_t i) const {return reinterpret_cast<uintptr_t>(ranges[i].iov_base);}
+        uintptr_t rangeEnd(size_t i) const {return rangeAddr(i) + ranges[i].iov_len;}
+
+        /* Read all queued ranges. Returns the number of reader calls. */
+        int read();
+
+        /* Content of a range, only valid up to `readSize(i)` */
+        const char* rangeData(size_t i) const {return buffer.data() + offsets[i];}
+        size_t readSize(size_t i) const {return read_sizes[i];}
+
+        /* Read a value with its own reader call, used when the range
+         * containing it could only be partially read */
+        bool readValue(uintptr_t addr, void* value, size_t size) const;
+
+    private:
+        const MemReader& reader;
+
+        std::vector<struct iovec> ranges;
+        std::vector<size_t> offsets;
+        std::vector<size_t> read_sizes;
+        std::vector<char> buffer;
+};
+
+#endif
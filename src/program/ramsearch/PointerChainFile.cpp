@@ -0,0 +1,248 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PointerChainFile.h"
+#include <fstream>
+#include <map>
+#include <algorithm>
+#include <cstdint>
+#include <climits> // PATH_MAX
+
+static const uint32_t CHAINFILE_MAGIC = 0x4350544c; // "LTPC"
+static const uint32_t CHAINFILE_VERSION = 1;
+
+/* Static section and the file it belongs to */
+struct StaticSection {
+    uintptr_t addr;
+    uintptr_t endaddr;
+    std::string filename;
+};
+
+/* Get the start address of each mapped file, and the static sections with
+ * their file. The bss section is anonymous, and belongs to the file mapped
+ * before it. */
+static void getFiles(const std::vector<MemSection>& sections, std::map<std::string, uintptr_t>& files, std::vector<StaticSection>& static_sections)
+{
+    std::string last_filename;
+    for (const MemSection& section : sections) {
+        if (!section.filename.empty() && (section.filename[0] != '[')) {
+            files.insert(std::make_pair(section.filename, section.addr));
+            last_filename = section.filename;
+        }
+
+        if (section.type & (MemSection::MemDataRW | MemSection::MemBSS)) {
+            if (section.filename.empty() && last_filename.empty())
+                continue;
+            StaticSection ss;
+            ss.addr = section.addr;
+            ss.endaddr = section.endaddr;
+            ss.filename = section.filename.empty() ? last_filename : section.filename;
+            static_sections.push_back(ss);
+        }
+    }
+}
+
+template <class T>
+static void writeValue(std::ofstream& file, T value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class T>
+static bool readValue(std::ifstream& file, T& value)
+{
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool savePointerChains(const std::string& path, const std::vector<PointerChain>& chains, const std::vector<MemSection>& sections, std::string& error)
+{
+    std::map<std::string, uintptr_t> files;
+    std::vector<StaticSection> static_sections;
+    getFiles(sections, files, static_sections);
+
+    /* Index of each file in the saved list */
+    std::vector<std::string> filenames;
+    std::map<std::string, uint32_t> file_indices;
+
+    struct SavedChain {
+        uint32_t file;
+        uint64_t offset;
+        const std::vector<int>* offsets;
+    };
+    std::vector<SavedChain> saved_chains;
+    saved_chains.reserve(chains.size());
+
+    for (const PointerChain& chain : chains) {
+        auto it = std::upper_bound(static_sections.begin(), static_sections.end(), chain.first, [] (uintptr_t addr, const StaticSection& ss) {
+            return addr < ss.addr;
+        });
+        if ((it == static_sections.begin()) || (chain.first >= (it-1)->endaddr))
+            continue;
+
+        const std::string& filename = (it-1)->filename;
+        auto fit = file_indices.find(filename);
+        if (fit == file_indices.end()) {
+            fit = file_indices.insert(std::make_pair(filename, static_cast<uint32_t>(filenames.size()))).first;
+            filenames.push_back(filename);
+        }
+
+        SavedChain saved;
+        saved.file = fit->second;
+        saved.offset = chain.first - files[filename];
+        saved.offsets = &chain.second;
+        saved_chains.push_back(saved);
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        error = "Could not open file " + path;
+        return false;
+    }
+
+    writeValue(file, CHAINFILE_MAGIC);
+    writeValue(file, CHAINFILE_VERSION);
+
+    writeValue(file, static_cast<uint32_t>(filenames.size()));
+    for (const std::string& filename : filenames) {
+        writeValue(file, static_cast<uint32_t>(filename.size()));
+        file.write(filename.data(), filename.size());
+    }
+
+    writeValue(file, static_cast<uint64_t>(saved_chains.size()));
+    for (const SavedChain& saved : saved_chains) {
+        writeValue(file, saved.file);
+        writeValue(file, saved.offset);
+        writeValue(file, static_cast<uint8_t>(saved.offsets->size()));
+        for (int offset : *saved.offsets)
+            writeValue(file, static_cast<int32_t>(offset));
+    }
+
+    if (!file) {
+        error = "Could not write file " + path;
+        return false;
+    }
+    return true;
+}
+
+bool loadPointerChains(const std::string& path, const std::vector<MemSection>& sections, std::vector<PointerChain>& chains, std::string& error)
+{
+    chains.clear();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "Could not open file " + path;
+        return false;
+    }
+
+    /* Lengths read from the file are checked against its size */
+    file.seekg(0, std::ios::end);
+    std::streamoff file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    uint32_t magic, version;
+    if (!readValue(file, magic) || !readValue(file, version) || (magic != CHAINFILE_MAGIC)) {
+        error = "File " + path + " is not a pointer scan file";
+        return false;
+    }
+    if (version != CHAINFILE_VERSION) {
+        error = "Unsupported pointer scan file version";
+        return false;
+    }
+
+    std::map<std::string, uintptr_t> files;
+    std::vector<StaticSection> static_sections;
+    getFiles(sections, files, static_sections);
+
+    /* Get the current start address of each file, matching by file name if
+     * the full path differs, or 0 if the file is not mapped */
+    uint32_t file_count;
+    if (!readValue(file, file_count)) {
+        error = "Pointer scan file is truncated";
+        return false;
+    }
+
+    std::vector<uintptr_t> file_addrs;
+    for (uint32_t f = 0; f < file_count; f++) {
+        uint32_t length;
+        if (!readValue(file, length)) {
+            error = "Pointer scan file is truncated";
+            return false;
+        }
+        if ((length > PATH_MAX) || (length > (file_size - file.tellg()))) {
+            error = "Pointer scan file is corrupted";
+            return false;
+        }
+        std::string filename(length, '\0');
+        if (!file.read(&filename[0], length)) {
+            error = "Pointer scan file is truncated";
+            return false;
+        }
+
+        uintptr_t addr = 0;
+        auto it = files.find(filename);
+        if (it != files.end()) {
+            addr = it->second;
+        }
+        else {
+            std::string basename = filename.substr(filename.find_last_of('/') + 1);
+            for (const auto& loaded : files) {
+                if (loaded.first.substr(loaded.first.find_last_of('/') + 1) == basename) {
+                    addr = loaded.second;
+                    break;
+                }
+            }
+        }
+        file_addrs.push_back(addr);
+    }
+
+    uint64_t chain_count;
+    if (!readValue(file, chain_count)) {
+        error = "Pointer scan file is truncated";
+        return false;
+    }
+
+    for (uint64_t c = 0; c < chain_count; c++) {
+        uint32_t file_index;
+        uint64_t offset;
+        uint8_t offset_count;
+        if (!readValue(file, file_index) || !readValue(file, offset) || !readValue(file, offset_count) || (file_index >= file_count)) {
+            error = "Pointer scan file is truncated";
+            return false;
+        }
+
+        PointerChain chain;
+        chain.second.resize(offset_count);
+        for (int& o : chain.second) {
+            int32_t value;
+            if (!readValue(file, value)) {
+                error = "Pointer scan file is truncated";
+                return false;
+            }
+            o = value;
+        }
+
+        if (file_addrs[file_index] == 0)
+            continue;
+
+        chain.first = file_addrs[file_index] + offset;
+        chains.push_back(std::move(chain));
+    }
+
+    return true;
+}
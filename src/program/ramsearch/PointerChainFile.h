@@ -0,0 +1,48 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_POINTERCHAINFILE_H_INCLUDED
+#define LIBTAS_POINTERCHAINFILE_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "MemSection.h"
+#include "PointerChainSearch.h"
+
+/* Binary file of pointer chains. Base addresses are stored relative to the
+ * start of the file (executable or library) whose static sections contain
+ * them, so that chains can be loaded after the game is restarted at other
+ * addresses.
+ *
+ * The file contains a header with a magic number and a version, the list of
+ * file names, then for each chain the index of its file, the offset of its
+ * base address, the number of offsets and the offsets. */
+
+/* Save `chains`, using the current `sections` of the game to locate base
+ * addresses. Chains with a base address outside of a static section are
+ * skipped. Returns false and fills `error` on failure. */
+bool savePointerChains(const std::string& path, const std::vector<PointerChain>& chains, const std::vector<MemSection>& sections, std::string& error);
+
+/* Load chains, using the current `sections` of the game to compute base
+ * addresses. Chains whose file is not mapped are skipped. Returns false and
+ * fills `error` on failure. */
+bool loadPointerChains(const std::string& path, const std::vector<MemSection>& sections, std::vector<PointerChain>& chains, std::string& error);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PointerChainResolver.h"
+#include "MemSnapshot.h"
+#include "WorkerPool.h"
+#include <cstring>
+#include <algorithm>
+
+void resolvePointerChains(const MemReader& reader, const std::vector<PointerChain>& chains, WorkerPool& pool, std::vector<uintptr_t>& addresses, const std::function<void(size_t)>& progress)
+{
+    static const size_t BLOCK_SIZE = 4096;
+
+    addresses.resize(chains.size());
+
+    size_t block_count = (chains.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    pool.run(block_count, [&] (size_t b, int) {
+        size_t first = b * BLOCK_SIZE;
+        size_t last = std::min(first + BLOCK_SIZE, chains.size());
+
+        /* Chains of the block that still have pointers to follow */
+        std::vector<size_t> active;
+        for (size_t c = first; c < last; c++) {
+            addresses[c] = chains[c].first;
+            if (!chains[c].second.empty())
+                active.push_back(c);
+        }
+
+        MemSnapshot snapshot(reader);
+
+        /* Offsets are stored from the target, so the first pointer read
+         * from the base address uses the last offset */
+        for (size_t level = 0; !active.empty(); level++) {
+            snapshot.clear();
+            for (size_t c : active)
+                snapshot.add(addresses[c], sizeof(uintptr_t));
+            snapshot.read();
+
+            size_t remaining = 0;
+            for (size_t i = 0; i < active.size(); i++) {
+                size_t c = active[i];
+                const std::vector<int>& offsets = chains[c].second;
+
+                if (snapshot.readSize(i) < sizeof(uintptr_t)) {
+                    addresses[c] = 0;
+                    continue;
+                }
+
+                uintptr_t next_address;
+                memcpy(&next_address, snapshot.rangeData(i), sizeof(uintptr_t));
+                addresses[c] = next_address + offsets[offsets.size() - 1 - level];
+
+                if (level + 1 < offsets.size())
+                    active[remaining++] = c;
+            }
+            active.resize(remaining);
+        }
+
+        progress(last - first);
+    });
+}
@@ -0,0 +1,41 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_POINTERCHAINRESOLVER_H_INCLUDED
+#define LIBTAS_POINTERCHAINRESOLVER_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+
+#include "PointerChainSearch.h"
+#include "MemReader.h"
+
+class WorkerPool;
+
+/* Follow all `chains` in the memory of `reader`, and store in `addresses`
+ * the address each chain ends at, or 0 if a pointer of the chain could not
+ * be read. Instead of one read per pointer, chains are processed in blocks,
+ * and the pointers of a same level of all chains of a block are read at
+ * once. Blocks are processed in parallel on `pool`, and `progress` is
+ * called from the worker threads with the number of chains of each
+ * processed block. */
+void resolvePointerChains(const MemReader& reader, const std::vector<PointerChain>& chains, WorkerPool& pool, std::vector<uintptr_t>& addresses, const std::function<void(size_t)>& progress);
+
+#endif
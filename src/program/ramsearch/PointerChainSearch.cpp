@@ -0,0 +1,182 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PointerChainSearch.h"
+#include "PointerIndex.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+
+/* Number of addresses of a level processed by each task */
+static const size_t ADDRESSES_PER_TASK = 256;
+
+/* Number of chains passed to the output at once */
+static const size_t BATCH_SIZE = 4096;
+
+PointerChainSearch::PointerChainSearch(const PointerIndex& i, WorkerPool& p) : index(i), pool(p) {}
+
+std::vector<PointerChainSearch::Hit> PointerChainSearch::findHits(int l, int max_offset, bool is_static, const std::function<void(size_t)>& progress)
+{
+    const std::vector<uintptr_t>& addresses = levels[l].addresses;
+    size_t task_count = (addresses.size() + ADDRESSES_PER_TASK - 1) / ADDRESSES_PER_TASK;
+
+    /* Each task stores its hits separately, so that they are merged in
+     * address order */
+    std::vector<std::vector<Hit>> results(task_count);
+    std::atomic<size_t> done(0);
+
+    pool.run(task_count, [&] (size_t t, int thread) {
+        size_t end = std::min(addresses.size(), (t+1)*ADDRESSES_PER_TASK);
+        for (size_t i = t*ADDRESSES_PER_TASK; i < end; i++) {
+            uintptr_t addr = addresses[i];
+            uintptr_t low = (addr > static_cast<uintptr_t>(max_offset)) ? (addr - max_offset) : 0;
+            auto range = index.find(low, addr, is_static);
+            for (auto iter = range.first; iter != range.second; iter++)
+                results[t].push_back({iter->address, static_cast<uint32_t>(i), static_cast<int>(addr - iter->value)});
+        }
+
+        done += end - t*ADDRESSES_PER_TASK;
+        if (thread == 0)
+            progress(done);
+    });
+
+    size_t count = 0;
+    for (const auto& result : results)
+        count += result.size();
+
+    std::vector<Hit> hits;
+    hits.reserve(count);
+    for (auto& result : results) {
+        hits.insert(hits.end(), result.begin(), result.end());
+        std::vector<Hit>().swap(result);
+    }
+    return hits;
+}
+
+bool PointerChainSearch::addLevel(std::vector<Hit>& hits, std::vector<uintptr_t>& visited)
+{
+    std::sort(hits.begin(), hits.end(), [] (const Hit& a, const Hit& b) {
+        return (a.address < b.address) || ((a.address == b.address) && (a.parent < b.parent));
+    });
+
+    levels.emplace_back();
+    Level& level = levels.back();
+
+    for (const Hit& hit : hits) {
+        /* Skip addresses that were reached at a previous level */
+        if (std::binary_search(visited.begin(), visited.end(), hit.address))
+            continue;
+
+        if (level.addresses.empty() || (level.addresses.back() != hit.address)) {
+            level.addresses.push_back(hit.address);
+            level.edge_start.push_back(level.edge_parent.size());
+        }
+        level.edge_parent.push_back(hit.parent);
+        level.edge_offset.push_back(hit.offset);
+    }
+    level.edge_start.push_back(level.edge_parent.size());
+
+    if (level.addresses.empty())
+        return false;
+
+    size_t middle = visited.size();
+    visited.insert(visited.end(), level.addresses.begin(), level.addresses.end());
+    std::inplace_merge(visited.begin(), visited.begin() + middle, visited.end());
+    return true;
+}
+
+bool PointerChainSearch::outputChains(int l, uint32_t node, uintptr_t base, std::vector<int>& offsets, size_t max_results, size_t& result_count, std::vector<PointerChain>& batch, const std::function<void(std::vector<PointerChain>&)>& output)
+{
+    if (l == 0) {
+        batch.push_back(std::make_pair(base, offsets));
+        if (batch.size() >= BATCH_SIZE) {
+            output(batch);
+            batch.clear();
+        }
+        return (++result_count < max_results);
+    }
+
+    const Level& level = levels[l];
+    for (size_t e = level.edge_start[node]; e < level.edge_start[node+1]; e++) {
+        offsets[l-1] = level.edge_offset[e];
+        if (!outputChains(l-1, level.edge_parent[e], base, offsets, max_results, result_count, batch, output))
+            return false;
+    }
+    return true;
+}
+
+void PointerChainSearch::run(uintptr_t target, int max_level, int max_offset, size_t max_results, const std::function<void(std::vector<PointerChain>&)>& output, const std::function<void(int)>& progress)
+{
+    levels.clear();
+    if ((max_level < 1) || (max_results == 0))
+        return;
+
+    /* The first level is the target address alone */
+    levels.emplace_back();
+    levels[0].addresses.push_back(target);
+    levels[0].edge_start.assign(2, 0);
+
+    std::vector<uintptr_t> visited(1, target);
+    std::vector<PointerChain> batch;
+    size_t result_count = 0;
+
+    for (int l = 0; l < max_level; l++) {
+        /* Each level is searched twice, for static then for other pointers */
+        size_t level_size = levels[l].addresses.size();
+        auto level_progress = [&] (int pass) {
+            return [&, pass] (size_t done) {
+                progress(static_cast<int>((100 * (2*l + pass) + 100 * done / level_size) / (2*max_level)));
+            };
+        };
+
+        /* Output the chains starting from a static pointer */
+        std::vector<Hit> hits = findHits(l, max_offset, true, level_progress(0));
+        if (pool.canceled())
+            return;
+
+        std::vector<int> offsets(l+1);
+        for (const Hit& hit : hits) {
+            offsets[l] = hit.offset;
+            if (!outputChains(l, hit.parent, hit.address, offsets, max_results, result_count, batch, output)) {
+                output(batch);
+                return;
+            }
+        }
+
+        if (!batch.empty()) {
+            output(batch);
+            batch.clear();
+        }
+
+        /* Stop if we reached the last level */
+        if (l == (max_level-1))
+            break;
+
+        /* Build the next level from the other pointers */
+        hits = findHits(l, max_offset, false, level_progress(1));
+        if (pool.canceled())
+            return;
+
+        if (!addLevel(hits, visited))
+            break;
+    }
+
+    progress(100);
+}
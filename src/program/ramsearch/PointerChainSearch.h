@@ -0,0 +1,94 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBTAS_POINTERCHAINSEARCH_H_INCLUDED
+#define LIBTAS_POINTERCHAINSEARCH_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <functional>
+
+class PointerIndex;
+class WorkerPool;
+
+/* Base address of a static pointer, and offsets of the chain from the
+ * target address to the base address */
+typedef std::pair<uintptr_t, std::vector<int>> PointerChain;
+
+/* Find chains of pointers from static addresses to a target address, one
+ * level at a time. Each level is the list of addresses that point to an
+ * address of the previous level, plus an offset. An address is only
+ * expanded once, at the first level it is reached: all ways to reach it at
+ * that level are kept, and longer chains through it are pruned. */
+class PointerChainSearch {
+    public:
+        PointerChainSearch(const PointerIndex& index, WorkerPool& pool);
+
+        /* Find chains ending at `target` with at most `max_level` pointers
+         * and offsets in [0, max_offset]. Chains are passed to `output` in
+         * batches as soon as they are found, until `max_results` chains were
+         * found. `progress` is called from the calling thread with the
+         * percentage of the search. */
+        void run(uintptr_t target, int max_level, int max_offset, size_t max_results, const std::function<void(std::vector<PointerChain>&)>& output, const std::function<void(int)>& progress);
+
+    private:
+        /* Addresses of a level, sorted, with the list of edges to the
+         * addresses of the previous level they point to */
+        struct Level {
+            std::vector<uintptr_t> addresses;
+
+            /* Edges of address i are from edge_start[i] to edge_start[i+1] */
+            std::vector<size_t> edge_start;
+            std::vector<uint32_t> edge_parent;
+            std::vector<int> edge_offset;
+        };
+
+        /* Pointer found from an address of a level */
+        struct Hit {
+            uintptr_t address;
+            uint32_t parent;
+            int offset;
+        };
+
+        const PointerIndex& index;
+        WorkerPool& pool;
+
+        std::vector<Level> levels;
+
+        /* Find the pointers to each address of level `l` in the index, in
+         * parallel, and return them in the order of the level addresses.
+         * `progress` is called from the calling thread with the number of
+         * processed addresses. */
+        std::vector<Hit> findHits(int l, int max_offset, bool is_static, const std::function<void(size_t)>& progress);
+
+        /* Build the next level from the pointers to the current level,
+         * skipping addresses already reached. Returns false if the new
+         * level is empty. */
+        bool addLevel(std::vector<Hit>& hits, std::vector<uintptr_t>& visited);
+
+        /* Output all chains from the static pointer `base` to the address
+         * `node` of level `l`, by following all edges back to the target.
+         * Returns false once `max_results` chains were found. */
+        bool outputChains(int l, uint32_t node, uintptr_t base, std::vector<int>& offsets, size_t max_results, size_t& result_count, std::vector<PointerChain>& batch, const std::function<void(std::vector<PointerChain>&)>& output);
+};
+
+#endif
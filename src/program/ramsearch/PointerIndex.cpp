@@ -0,0 +1,205 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PointerIndex.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+
+/* Sort pointers by value with a parallel LSD radix sort. Values are in
+ * [min_value, max_value], so only the bits that can differ are sorted. The
+ * sort is stable, so pointers with the same value keep their order. */
+static void radixSort(std::vector<PointerIndex::Pointer>& pointers, uintptr_t min_value, uintptr_t max_value, WorkerPool& pool)
+{
+    /* Comparison sort is faster for small arrays */
+    if (pointers.size() < 64*1024) {
+        std::stable_sort(pointers.begin(), pointers.end(), [] (const PointerIndex::Pointer& a, const PointerIndex::Pointer& b) {
+            return a.value < b.value;
+        });
+        return;
+    }
+
+    static const int RADIX_BITS = 11;
+    static const size_t BUCKETS = 1 << RADIX_BITS;
+    int bits = 64 - __builtin_clzll((max_value - min_value) | 1);
+
+    /* Each slice is processed by one task, and keeps its own bucket counts */
+    size_t slices = pool.threadCount();
+    size_t slice_size = (pointers.size() + slices - 1) / slices;
+    std::vector<size_t> counts(slices * BUCKETS);
+    std::vector<PointerIndex::Pointer> buffer(pointers.size());
+
+    for (int shift = 0; shift < bits; shift += RADIX_BITS) {
+        auto bucket = [&] (const PointerIndex::Pointer& p) {
+            return ((p.value - min_value) >> shift) & (BUCKETS - 1);
+        };
+
+        std::fill(counts.begin(), counts.end(), 0);
+        pool.run(slices, [&] (size_t s, int) {
+            size_t end = std::min(pointers.size(), (s+1)*slice_size);
+            for (size_t i = s*slice_size; i < end; i++)
+                counts[s*BUCKETS + bucket(pointers[i])]++;
+        });
+
+        /* Each slice writes its pointers of a bucket after the ones of the
+         * previous slices */
+        size_t offset = 0;
+        for (size_t b = 0; b < BUCKETS; b++) {
+            for (size_t s = 0; s < slices; s++) {
+                size_t count = counts[s*BUCKETS + b];
+                counts[s*BUCKETS + b] = offset;
+                offset += count;
+            }
+        }
+
+        pool.run(slices, [&] (size_t s, int) {
+            size_t end = std::min(pointers.size(), (s+1)*slice_size);
+            for (size_t i = s*slice_size; i < end; i++)
+                buffer[counts[s*BUCKETS + bucket(pointers[i])]++] = pointers[i];
+        });
+
+        pointers.swap(buffer);
+    }
+}
+
+void PointerIndex::build(const MemReader& reader, const std::vector<MemSection>& sections, WorkerPool& pool, const std::function<void(size_t)>& progress)
+{
+    clear();
+
+    /* Build the sorted list of ranges that pointers can point to, merging
+     * contiguous sections */
+    std::vector<std::pair<uintptr_t, uintptr_t>> targets;
+    for (const MemSection& section : sections) {
+        /* If pointing to a static section, we can skip it */
+        if (section.type & (MemSection::MemDataRW | MemSection::MemBSS))
+            continue;
+
+        if (!targets.empty() && (targets.back().second == section.addr))
+            targets.back().second = section.endaddr;
+        else
+            targets.emplace_back(section.addr, section.endaddr);
+    }
+
+    if (targets.empty())
+        return;
+
+    uintptr_t min_value = targets.front().first;
+    uintptr_t max_value = targets.back().second - 1;
+
+    /* Split sections into tasks of at most CHUNK_SIZE bytes */
+    static const size_t CHUNK_SIZE = 1024*1024;
+    struct Task {
+        uintptr_t addr;
+        uintptr_t endaddr;
+        bool is_static;
+    };
+    std::vector<Task> tasks;
+    for (const MemSection& section : sections) {
+        bool is_static = section.type & (MemSection::MemDataRW | MemSection::MemBSS);
+        for (uintptr_t addr = section.addr; addr < section.endaddr; addr += CHUNK_SIZE) {
+            uintptr_t endaddr = (section.endaddr - addr > CHUNK_SIZE) ? (addr + CHUNK_SIZE) : section.endaddr;
+            tasks.push_back({addr, endaddr, is_static});
+        }
+    }
+
+    /* Each task stores its pointers separately, so that they are merged in
+     * address order */
+    std::vector<std::vector<uintptr_t>> chunks(pool.threadCount());
+    std::vector<std::vector<Pointer>> results(tasks.size());
+    std::atomic<size_t> read_size(0);
+
+    pool.run(tasks.size(), [&] (size_t t, int thread) {
+        std::vector<uintptr_t>& chunk = chunks[thread];
+        chunk.resize(CHUNK_SIZE/sizeof(uintptr_t));
+
+        for (uintptr_t addr = tasks[t].addr; addr < tasks[t].endaddr; ) {
+            size_t size = tasks[t].endaddr - addr;
+            size_t readValues = reader.read(addr, chunk.data(), size);
+
+            /* Only keep whole pages, and skip the page that could not be
+             * read, if any */
+            readValues -= readValues % 4096;
+            uintptr_t next_addr = addr + readValues;
+            if (readValues < size)
+                next_addr += 4096;
+
+            for (size_t i = 0; i < readValues/sizeof(uintptr_t); i++) {
+                uintptr_t value = chunk[i];
+
+                /* Check if the value could be a pointer */
+                if ((value < min_value) || (value > max_value))
+                    continue;
+
+                auto it = std::upper_bound(targets.begin(), targets.end(), value, [] (uintptr_t v, const std::pair<uintptr_t, uintptr_t>& target) {
+                    return v < target.first;
+                });
+                if (value < (it-1)->second)
+                    results[t].push_back({value, addr + i*sizeof(uintptr_t)});
+            }
+
+            read_size += next_addr - addr;
+            addr = next_addr;
+        }
+
+        if (thread == 0)
+            progress(read_size);
+    });
+
+    if (pool.canceled())
+        return;
+
+    /* Gather the pointers of all tasks, releasing memory as we go */
+    size_t count = 0, static_count = 0;
+    for (size_t t = 0; t < tasks.size(); t++)
+        (tasks[t].is_static ? static_count : count) += results[t].size();
+
+    pointers.reserve(count);
+    static_pointers.reserve(static_count);
+    for (size_t t = 0; t < tasks.size(); t++) {
+        std::vector<Pointer>& dest = tasks[t].is_static ? static_pointers : pointers;
+        dest.insert(dest.end(), results[t].begin(), results[t].end());
+        std::vector<Pointer>().swap(results[t]);
+    }
+
+    radixSort(pointers, min_value, max_value, pool);
+    radixSort(static_pointers, min_value, max_value, pool);
+
+    if (pool.canceled())
+        clear();
+}
+
+void PointerIndex::clear()
+{
+    std::vector<Pointer>().swap(pointers);
+    std::vector<Pointer>().swap(static_pointers);
+}
+
+std::pair<PointerIndex::const_iterator, PointerIndex::const_iterator> PointerIndex::find(uintptr_t low, uintptr_t high, bool is_static) const
+{
+    const std::vector<Pointer>& list = is_static ? static_pointers : pointers;
+
+    auto first = std::lower_bound(list.begin(), list.end(), low, [] (const Pointer& p, uintptr_t v) {
+        return p.value < v;
+    });
+    auto last = std::upper_bound(first, list.end(), high, [] (uintptr_t v, const Pointer& p) {
+        return v < p.value;
+    });
+    return std::make_pair(first, last);
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBTAS_POINTERINDEX_H_INCLUDED
+#define LIBTAS_POINTERINDEX_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "MemSection.h"
+#include "MemReader.h"
+
+class WorkerPool;
+
+/* Index of all values of the game memory that could be pointers, sorted by
+ * the address they point to. Each pointer is stored as a pair of addresses,
+ * in a flat array. */
+class PointerIndex {
+    public:
+        /* A pointer located at `address`, pointing to `value` */
+        struct Pointer {
+            uintptr_t value;
+            uintptr_t address;
+        };
+
+        typedef std::vector<Pointer>::const_iterator const_iterator;
+
+        /* Read all `sections` from `reader` in parallel on `pool`, and
+         * index all aligned values pointing inside a non-static section.
+         * Pointers located inside a static section (data or bss) are
+         * indexed separately.
+         * `progress` is called from the calling thread with the number of
+         * bytes read. */
+        void build(const MemReader& reader, const std::vector<MemSection>& sections, WorkerPool& pool, const std::function<void(size_t)>& progress);
+
+        void clear();
+
+        size_t size() const {return pointers.size() + static_pointers.size();}
+
+        /* Get the pointers with a value in [low, high], sorted by value then
+         * by address */
+        std::pair<const_iterator, const_iterator> find(uintptr_t low, uintptr_t high, bool is_static) const;
+
+    private:
+        std::vector<Pointer> pointers;
+        std::vector<Pointer> static_pointers;
+};
+
+#endif
@@ -0,0 +1,409 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RamCandidates.h"
+#include "CompareKernels.h"
+#include "MemSnapshot.h"
+#include "WorkerPool.h"
+#include <inttypes.h>
+#include <cstdio>
+#include <type_traits>
+#include <algorithm>
+
+template <typename T> static inline const char* fmt_from_type(bool hex) {return hex?"%x":(std::is_unsigned<T>::value?"%u":"%d");}
+template <> inline const char* fmt_from_type<float>(bool hex) {return hex?"%a":"%g";}
+template <> inline const char* fmt_from_type<double>(bool hex) {return hex?"%la":"%lg";}
+template <> inline const char* fmt_from_type<int64_t>(bool hex) {return hex?"%" PRIx64:"%" PRId64;}
+template <> inline const char* fmt_from_type<uint64_t>(bool hex) {return hex?"%" PRIx64:"%" PRIu64;}
+
+template <class T>
+static const char* formatTyped(const char* value, bool hex)
+{
+    static char str[30];
+    T v;
+    memcpy(&v, value, sizeof(T));
+    /* Use snprintf instead of ostringstream for a good speedup */
+    snprintf(str, 30, fmt_from_type<T>(hex), v);
+    return str;
+}
+
+static const char* formatValue(int type, const char* value, bool hex)
+{
+    switch (type) {
+        case 0:
+            return formatTyped<unsigned char>(value, hex);
+        case 1:
+            return formatTyped<char>(value, hex);
+        case 2:
+            return formatTyped<unsigned short>(value, hex);
+        case 3:
+            return formatTyped<short>(value, hex);
+        case 4:
+            return formatTyped<unsigned int>(value, hex);
+        case 5:
+            return formatTyped<int>(value, hex);
+        case 6:
+            return formatTyped<uint64_t>(value, hex);
+        case 7:
+            return formatTyped<int64_t>(value, hex);
+        case 8:
+            return formatTyped<float>(value, hex);
+        case 9:
+            return formatTyped<double>(value, hex);
+    }
+    return "";
+}
+
+void RamCandidates::Region::countSurvivors()
+{
+    block_counts.resize((survivors.size() + BLOCK_WORDS - 1) / BLOCK_WORDS);
+    survivor_count = 0;
+    for (size_t w = 0; w < survivors.size(); w++) {
+        if (w % BLOCK_WORDS == 0)
+            block_counts[w / BLOCK_WORDS] = survivor_count;
+        survivor_count += __builtin_popcountll(survivors[w]);
+    }
+}
+
+size_t RamCandidates::Region::position(size_t i) const
+{
+    /* Find the block containing the candidate, then the word */
+    size_t block = std::upper_bound(block_counts.begin(), block_counts.end(), i) - block_counts.begin() - 1;
+    i -= block_counts[block];
+
+    size_t w = block * BLOCK_WORDS;
+    for (size_t c = __builtin_popcountll(survivors[w]); i >= c; c = __builtin_popcountll(survivors[w])) {
+        i -= c;
+        w++;
+    }
+
+    /* Remove the lower bits of the word until the candidate */
+    uint64_t word = survivors[w];
+    for (; i > 0; i--)
+        word &= word - 1;
+
+    return w*64 + __builtin_ctzll(word);
+}
+
+size_t RamCandidates::Region::memorySize(int value_size) const
+{
+    return count*value_size + survivors.size()*sizeof(uint64_t) + block_counts.size()*sizeof(uint32_t);
+}
+
+RamCandidates::RamCandidates() : value_type(0), value_size(1), region_size(0) {}
+
+void RamCandidates::reset(int type, int size)
+{
+    value_type = type;
+    value_size = size;
+
+    /* Release the memory of the previous search */
+    std::vector<uintptr_t>().swap(addresses);
+    std::vector<char>().swap(values);
+    std::vector<Region>().swap(regions);
+    region_size = 0;
+}
+
+void RamCandidates::updateIndex()
+{
+    region_size = 0;
+    for (auto& region : regions) {
+        region.first_index = region_size;
+        region_size += region.survivor_count;
+    }
+}
+
+const RamCandidates::Region& RamCandidates::locate(size_t i, size_t& position) const
+{
+    /* Find the last region starting before the candidate. Regions without
+     * candidates share their first index with the next region, so we take
+     * the last one. */
+    auto it = std::upper_bound(regions.begin(), regions.end(), i, [] (size_t index, const Region& region) {
+        return index < region.first_index;
+    });
+    const Region& region = *(it - 1);
+    position = region.position(i - region.first_index);
+    return region;
+}
+
+uintptr_t RamCandidates::address(size_t i) const
+{
+    if (regions.empty())
+        return addresses[i];
+
+    size_t position;
+    const Region& region = locate(i, position);
+    return region.addr + position*value_size;
+}
+
+const char* RamCandidates::value(size_t i) const
+{
+    if (regions.empty())
+        return &values[i*value_size];
+
+    size_t position;
+    const Region& region = locate(i, position);
+    return &region.values[position*value_size];
+}
+
+void RamCandidates::compactRegions()
+{
+    size_t region_memory = 0;
+    for (const auto& region : regions)
+        region_memory += region.memorySize(value_size);
+
+    if (region_size*(sizeof(uintptr_t) + value_size) >= region_memory)
+        return;
+
+    std::vector<Region> old_regions;
+    old_regions.swap(regions);
+    reserve(region_size);
+    region_size = 0;
+
+    for (const auto& region : old_regions) {
+        for (size_t w = 0; w < region.survivors.size(); w++) {
+            for (uint64_t word = region.survivors[w]; word; word &= word - 1) {
+                size_t i = w*64 + __builtin_ctzll(word);
+                addresses.push_back(region.addr + i*value_size);
+                values.insert(values.end(), &region.values[i*value_size], &region.values[(i+1)*value_size]);
+            }
+        }
+    }
+}
+
+void RamCandidates::reserve(size_t count)
+{
+    addresses.reserve(addresses.size() + count);
+    values.reserve(values.size() + count*value_size);
+}
+
+const char* RamCandidates::tostring(size_t i, bool hex) const
+{
+    return formatValue(value_type, value(i), hex);
+}
+
+const char* RamCandidates::tostring_current(size_t i, bool hex, const MemReader& reader) const
+{
+    char value[8] = {0};
+    if (reader.read(address(i), value, value_size) != static_cast<size_t>(value_size))
+        return "";
+
+    return formatValue(value_type, value, hex);
+}
+
+void RamCandidates::merge(std::vector<RamCandidates>& parts)
+{
+    size_t total = 0;
+    for (const auto& part : parts)
+        total += part.size();
+    reserve(total);
+
+    for (auto& part : parts) {
+        addresses.insert(addresses.end(), part.addresses.begin(), part.addresses.end());
+        values.insert(values.end(), part.values.begin(), part.values.end());
+
+        /* Regions are moved without copying their snapshots */
+        for (auto& region : part.regions)
+            regions.push_back(std::move(region));
+
+        part.reset(part.value_type, part.value_size);
+    }
+
+    updateIndex();
+}
+
+template <class T>
+void RamCandidates::searchBlock(const MemReader& reader, size_t first, size_t count, CompareType compare_type, CompareOperator compare_operator, double compare_value, RamCandidates& results) const
+{
+    /* Candidates are read from a snapshot of the ranges of memory containing
+     * them, which may include a few bytes between them */
+    static const size_t MAX_GAP = 256;
+    static const size_t MAX_RANGE_SIZE = 64*1024;
+    MemSnapshot snapshot(reader);
+    std::vector<size_t> candidate_ranges(count);
+
+    std::vector<T> current(count);
+    std::vector<uint64_t> matches((count+63)/64);
+    const T* previous = reinterpret_cast<const T*>(values.data()) + first;
+
+    /* Queue the memory ranges containing the candidates. Close candidates
+     * share the same range. */
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t addr = addresses[first + i];
+        size_t r = snapshot.rangeCount();
+        if ((r > 0) && (addr <= snapshot.rangeEnd(r-1) + MAX_GAP) &&
+            (addr + sizeof(T) <= snapshot.rangeAddr(r-1) + MAX_RANGE_SIZE)) {
+            if (addr + sizeof(T) > snapshot.rangeEnd(r-1))
+                snapshot.extend(addr + sizeof(T));
+            candidate_ranges[i] = r-1;
+        }
+        else {
+            candidate_ranges[i] = snapshot.add(addr, sizeof(T));
+        }
+    }
+
+    snapshot.read();
+
+    /* Get the current values, remembering the ones that could not be read */
+    std::vector<size_t> unreadable;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t addr = addresses[first + i];
+        size_t r = candidate_ranges[i];
+        size_t offset = addr - snapshot.rangeAddr(r);
+        if (offset + sizeof(T) <= snapshot.readSize(r))
+            memcpy(&current[i], snapshot.rangeData(r) + offset, sizeof(T));
+        else if (!snapshot.readValue(addr, &current[i], sizeof(T)))
+            unreadable.push_back(i);
+    }
+
+    compareValues(current.data(), previous, static_cast<T>(compare_value), count, compare_type, compare_operator, matches.data());
+
+    for (size_t i : unreadable)
+        matches[i/64] &= ~(1ull << (i%64));
+
+    /* Keep the matching candidates with their current value */
+    results.reset<T>();
+    for (size_t w = 0; w < (count+63)/64; w++) {
+        for (uint64_t word = matches[w]; word; word &= word - 1) {
+            size_t i = w*64 + __builtin_ctzll(word);
+            results.add(addresses[first + i], current[i]);
+        }
+    }
+}
+
+template <class T>
+void RamCandidates::searchRegion(const MemReader& reader, const Region& region, CompareType compare_type, CompareOperator compare_operator, double compare_value, Region& result) const
+{
+    result.addr = region.addr;
+    result.count = region.count;
+    result.survivors = region.survivors;
+    result.values.resize(region.count*sizeof(T));
+
+    /* Read the whole region, and remove the candidates of the pages that
+     * could not be read */
+    size_t size = region.count*sizeof(T);
+    for (size_t offset = 0; offset < size; ) {
+        size_t ret = reader.read(region.addr + offset, &result.values[offset], size - offset);
+        offset += ret - ret % 4096;
+
+        if (offset < size) {
+            size_t end = (offset + 4096 < size) ? (offset + 4096) : size;
+            for (size_t i = offset/sizeof(T); i < end/sizeof(T); i++)
+                result.survivors[i/64] &= ~(1ull << (i%64));
+            offset = end;
+        }
+    }
+
+    std::vector<uint64_t> matches(result.survivors.size());
+    const T* current = reinterpret_cast<const T*>(result.values.data());
+    const T* previous = reinterpret_cast<const T*>(region.values.data());
+    compareValues(current, previous, static_cast<T>(compare_value), region.count, compare_type, compare_operator, matches.data());
+
+    for (size_t w = 0; w < matches.size(); w++)
+        result.survivors[w] &= matches[w];
+
+    result.countSurvivors();
+}
+
+template <class T>
+void RamCandidates::searchTyped(const MemReader& reader, CompareType compare_type, CompareOperator compare_operator, double compare_value, WorkerPool& pool, const std::function<void(size_t)>& progress)
+{
+    if (!regions.empty()) {
+        /* Each region is searched into a new region, so that candidates are
+         * unchanged if the search is canceled */
+        std::vector<Region> results(regions.size());
+
+        pool.run(regions.size(), [&] (size_t r, int) {
+            if (regions[r].survivor_count > 0)
+                searchRegion<T>(reader, regions[r], compare_type, compare_operator, compare_value, results[r]);
+            else
+                results[r].survivor_count = 0;
+            progress(regions[r].survivor_count);
+        });
+
+        if (pool.canceled())
+            return;
+
+        /* Drop the regions without candidates */
+        std::vector<Region>().swap(regions);
+        for (auto& region : results) {
+            if (region.survivor_count > 0)
+                regions.push_back(std::move(region));
+        }
+        updateIndex();
+
+        compactRegions();
+        return;
+    }
+
+    /* Candidates are processed in blocks, each block storing its matching
+     * candidates separately, so that they are merged in address order */
+    static const size_t BLOCK_SIZE = 64*1024;
+    size_t block_count = (addresses.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    std::vector<RamCandidates> results(block_count);
+
+    pool.run(block_count, [&] (size_t block, int) {
+        size_t first = block * BLOCK_SIZE;
+        size_t count = (addresses.size() - first < BLOCK_SIZE) ? (addresses.size() - first) : BLOCK_SIZE;
+        searchBlock<T>(reader, first, count, compare_type, compare_operator, compare_value, results[block]);
+        progress(count);
+    });
+
+    if (pool.canceled())
+        return;
+
+    reset(value_type, value_size);
+    merge(results);
+}
+
+void RamCandidates::search(const MemReader& reader, CompareType compare_type, CompareOperator compare_operator, double compare_value, WorkerPool& pool, const std::function<void(size_t)>& progress)
+{
+    switch (value_type) {
+        case 0:
+            searchTyped<unsigned char>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 1:
+            searchTyped<char>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 2:
+            searchTyped<unsigned short>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 3:
+            searchTyped<short>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 4:
+            searchTyped<unsigned int>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 5:
+            searchTyped<int>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 6:
+            searchTyped<uint64_t>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 7:
+            searchTyped<int64_t>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 8:
+            searchTyped<float>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+        case 9:
+            searchTyped<double>(reader, compare_type, compare_operator, compare_value, pool, progress);
+            break;
+    }
+}
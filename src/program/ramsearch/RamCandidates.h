@@ -0,0 +1,201 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_RAMCANDIDATES_H_INCLUDED
+#define LIBTAS_RAMCANDIDATES_H_INCLUDED
+
+#include <cstdint>
+#include "CompareEnums.h"
+#include "TypeIndex.h"
+#include "MemReader.h"
+#include <cstring>
+#include <cmath> // std::isfinite
+#include <vector>
+#include <functional>
+
+class WorkerPool;
+
+/* Candidate addresses of a RAM search with their previous values. Instead
+ * of one watch object per address, addresses and values are stored in two
+ * contiguous arrays, values being the raw bytes of the searched type, so
+ * that a candidate only costs its address and its value.
+ *
+ * When all values of a memory range are candidates, like in the first
+ * passes of an unknown value search, they are rather stored as regions: a
+ * snapshot of the range with a bitmap of the remaining candidates, which
+ * avoids storing addresses. Regions are converted to arrays once they take
+ * more memory than the arrays would. Candidates are either all in regions
+ * or all in arrays, in address order. */
+class RamCandidates {
+    public:
+        RamCandidates();
+
+        /* Remove all candidates, and set the type of the next ones */
+        template <class T>
+        void reset()
+        {
+            reset(type_index<T>(), sizeof(T));
+        }
+
+        size_t size() const {return regions.empty() ? addresses.size() : region_size;}
+
+        /* Type index of the values, from TypeIndex.h */
+        int type() const {return value_type;}
+
+        uintptr_t address(size_t i) const;
+
+        /* Reserve room for `count` more candidates */
+        void reserve(size_t count);
+
+        template <class T>
+        void add(uintptr_t addr, T value)
+        {
+            addresses.push_back(addr);
+            const char* bytes = reinterpret_cast<const char*>(&value);
+            values.insert(values.end(), bytes, bytes + sizeof(T));
+        }
+
+        /* Add the `count` contiguous values located at `addr` whose bit is
+         * set in the bitmap `matches` */
+        template <class T>
+        void addMatches(uintptr_t addr, const T* chunk, size_t count, const uint64_t* matches)
+        {
+            for (size_t w = 0; w < (count+63)/64; w++) {
+                for (uint64_t word = matches[w]; word; word &= word - 1) {
+                    size_t i = w*64 + __builtin_ctzll(word);
+                    add(addr + i*sizeof(T), chunk[i]);
+                }
+            }
+        }
+
+        /* Add the `count` contiguous values located at `addr` as a region.
+         * All values are candidates, except NaN/Inf values. */
+        template <class T>
+        void addRegion(uintptr_t addr, const T* chunk, size_t count)
+        {
+            Region region;
+            region.addr = addr;
+            region.count = count;
+            const char* bytes = reinterpret_cast<const char*>(chunk);
+            region.values.assign(bytes, bytes + count*sizeof(T));
+            region.survivors.assign((count+63)/64, 0);
+            for (size_t i = 0; i < count; i++) {
+                if (std::isfinite(chunk[i]))
+                    region.survivors[i/64] |= 1ull << (i%64);
+            }
+            region.countSurvivors();
+
+            region.first_index = region_size;
+            region_size += region.survivor_count;
+            regions.push_back(std::move(region));
+        }
+
+        /* Append the candidates of all `parts` in order, which must have the
+         * same type, and release them */
+        void merge(std::vector<RamCandidates>& parts);
+
+        /* Format the previous value of a candidate */
+        const char* tostring(size_t i, bool hex) const;
+
+        /* Read the current value of a candidate from `reader` and format
+         * it */
+        const char* tostring_current(size_t i, bool hex, const MemReader& reader) const;
+
+        /* Read the current values of all candidates from `reader`, only
+         * keep the ones matching the comparison, and store their current
+         * values as previous values. Candidates that cannot be read are
+         * removed. Blocks of candidates or regions are searched in parallel
+         * on `pool`, and `progress` is called from the worker threads with
+         * the number of candidates of each processed block or region. If the
+         * pool is canceled, candidates are left unchanged. */
+        void search(const MemReader& reader, CompareType compare_type, CompareOperator compare_operator, double compare_value, WorkerPool& pool, const std::function<void(size_t)>& progress);
+
+    private:
+        /* Snapshot of a range of memory, with one bit per value set if the
+         * value is still a candidate */
+        struct Region {
+            uintptr_t addr;
+
+            /* Number of values in the range */
+            size_t count;
+
+            std::vector<char> values;
+            std::vector<uint64_t> survivors;
+
+            /* Number of candidates before each block of BLOCK_WORDS words of
+             * the bitmap, to quickly find the i-th candidate */
+            static const size_t BLOCK_WORDS = 8;
+            std::vector<uint32_t> block_counts;
+
+            size_t survivor_count;
+
+            /* Index of the first candidate of the region among all candidates */
+            size_t first_index;
+
+            /* Update the candidate counts after modifying the bitmap */
+            void countSurvivors();
+
+            /* Position in the region of its i-th candidate */
+            size_t position(size_t i) const;
+
+            size_t memorySize(int value_size) const;
+        };
+
+        int value_type;
+        int value_size;
+
+        std::vector<uintptr_t> addresses;
+        std::vector<char> values;
+
+        std::vector<Region> regions;
+
+        /* Number of candidates in regions */
+        size_t region_size;
+
+        void reset(int type, int size);
+
+        /* Recompute the index of the first candidate of each region */
+        void updateIndex();
+
+        /* Get the region and the position in the region of a candidate */
+        const Region& locate(size_t i, size_t& position) const;
+
+        /* Previous value of a candidate */
+        const char* value(size_t i) const;
+
+        /* Move all candidates from regions to arrays, if arrays would take
+         * less memory */
+        void compactRegions();
+
+        template <class T>
+        void searchTyped(const MemReader& reader, CompareType compare_type, CompareOperator compare_operator, double compare_value, WorkerPool& pool, const std::function<void(size_t)>& progress);
+
+        /* Compare the values of a region with their current values, and
+         * store the remaining candidates with their current values in
+         * `result` */
+        template <class T>
+        void searchRegion(const MemReader& reader, const Region& region, CompareType compare_type, CompareOperator compare_operator, double compare_value, Region& result) const;
+
+        /* Search the candidates from `first` to `first+count`, and add the
+         * matching ones to `results` */
+        template <class T>
+        void searchBlock(const MemReader& reader, size_t first, size_t count, CompareType compare_type, CompareOperator compare_operator, double compare_value, RamCandidates& results) const;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "RamWatchBatch.h"
+#include "MemSnapshot.h"
+#include <cstring>
+
+void readRamWatches(const MemReader& reader, const std::vector<std::unique_ptr<IRamWatchDetailed>>& watches, std::vector<uintptr_t>& addresses, std::vector<std::string>& values)
+{
+    size_t count = watches.size();
+    addresses.resize(count);
+    values.assign(count, std::string("??????"));
+
+    /* Watches that were not invalidated by a pointer that could not be read */
+    std::vector<char> valid(count, 1);
+
+    /* Pointer watches that still have pointers to follow */
+    std::vector<size_t> active;
+    for (size_t w = 0; w < count; w++) {
+        const IRamWatchDetailed& watch = *watches[w];
+        if (watch.isPointer) {
+            addresses[w] = watch.base_address;
+            if (!watch.pointer_offsets.empty())
+                active.push_back(w);
+        }
+        else {
+            addresses[w] = watch.address;
+        }
+    }
+
+    MemSnapshot snapshot(reader);
+
+    for (size_t level = 0; !active.empty(); level++) {
+        snapshot.clear();
+        for (size_t w : active)
+            snapshot.add(addresses[w], sizeof(uintptr_t));
+        snapshot.read();
+
+        size_t remaining = 0;
+        for (size_t i = 0; i < active.size(); i++) {
+            size_t w = active[i];
+            const std::vector<int>& offsets = watches[w]->pointer_offsets;
+
+            if (snapshot.readSize(i) < sizeof(uintptr_t)) {
+                valid[w] = 0;
+                continue;
+            }
+
+            uintptr_t next_address;
+            memcpy(&next_address, snapshot.rangeData(i), sizeof(uintptr_t));
+            addresses[w] = next_address + offsets[level];
+
+            if (level + 1 < offsets.size())
+                active[remaining++] = w;
+        }
+        active.resize(remaining);
+    }
+
+    /* Pointer watches keep the address of their value, which is used when
+     * editing, poking or scanning the watch. If a pointer could not be read,
+     * this is the last address that was resolved, like get_value() does. */
+    for (size_t w = 0; w < count; w++) {
+        if (watches[w]->isPointer)
+            watches[w]->address = addresses[w];
+    }
+
+    /* Read all values */
+    snapshot.clear();
+    std::vector<size_t> ranges(count);
+    for (size_t w = 0; w < count; w++) {
+        if (valid[w])
+            ranges[w] = snapshot.add(addresses[w], watches[w]->size());
+    }
+    snapshot.read();
+
+    for (size_t w = 0; w < count; w++) {
+        if (valid[w] && (snapshot.readSize(ranges[w]) == static_cast<size_t>(watches[w]->size())))
+            values[w] = watches[w]->format_value(snapshot.rangeData(ranges[w]));
+    }
+}
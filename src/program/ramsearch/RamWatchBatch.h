@@ -0,0 +1,40 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_RAMWATCHBATCH_H_INCLUDED
+#define LIBTAS_RAMWATCHBATCH_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "IRamWatchDetailed.h"
+#include "MemReader.h"
+
+/* Read the values of all `watches` from `reader`, and store in `addresses`
+ * the address of each value, and in `values` each value formatted, or
+ * "??????" if it could not be read. The address of pointer watches is also
+ * updated. Instead of reading each pointer and value separately, the
+ * pointers of a same level of all pointer watches are read at once, then all
+ * values are read at once, so that the number of reads only depends on the
+ * longest pointer chain. */
+void readRamWatches(const MemReader& reader, const std::vector<std::unique_ptr<IRamWatchDetailed>>& watches, std::vector<uintptr_t>& addresses, std::vector<std::string>& values);
+
+#endif
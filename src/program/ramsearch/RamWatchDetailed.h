@@ -25,6 +25,8 @@
 #include <sstream>
 #include <iostream>
 #include <sys/uio.h>
+#include <cstring>
+#include <cerrno>
 
 template <class T>
 class RamWatchDetailed : public IRamWatchDetailed {
@@ -64,22 +66,32 @@ public:
 
     std::string value_str()
     {
+        T value = get_value();
+        if (!isValid)
+            return std::string("??????");
+
+        return format_value(reinterpret_cast<const char*>(&value));
+    }
+
+    std::string format_value(const char* bytes)
+    {
+        T value;
+        memcpy(&value, bytes, sizeof(T));
+
         std::ostringstream oss;
         if (hex) oss << std::hex;
         /* Output char and unsigned char as integer values. There might be a
          * more elegant solution.
          */
         if (std::is_same<T, char>::value) {
-            oss << static_cast<int>(get_value());
+            oss << static_cast<int>(value);
         }
         else if (std::is_same<T, unsigned char>::value) {
-            oss << static_cast<unsigned int>(get_value());
+            oss << static_cast<unsigned int>(value);
         }
         else {
-            oss << get_value();
+            oss << value;
         }
-        if (!isValid)
-            return std::string("??????");
 
         return oss.str();
     }
@@ -107,6 +119,16 @@ public:
             iss >> value;
         }
 
+        /* The address of pointer watches may be outdated, so we follow the
+         * pointers again before writing */
+        if (isPointer) {
+            get_value();
+            if (!isValid) {
+                errno = EFAULT;
+                return -1;
+            }
+        }
+
         /* Write value into the game process address */
         struct iovec local, remote;
         local.iov_base = static_cast<void*>(&value);
@@ -122,6 +144,11 @@ public:
         return type_index<T>();
     }
 
+    int size()
+    {
+        return sizeof(T);
+    }
+
 };
 
 #endif
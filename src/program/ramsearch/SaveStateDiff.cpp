@@ -0,0 +1,82 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SaveStateDiff.h"
+#include "MemSection.h"
+#include <cstring>
+
+SaveStateDiff::SaveStateDiff(Context* c) : first(c), second(c), opened(false) {}
+
+bool SaveStateDiff::open(int first_slot, int second_slot, std::string& error)
+{
+    opened = first.open(first_slot, error) && second.open(second_slot, error);
+    return opened;
+}
+
+int SaveStateDiff::pageCount(int type_filter)
+{
+    if (!opened)
+        return 0;
+
+    int count = 0;
+    for (const MemSection& section : second.sections()) {
+        if (type_filter & section.type)
+            count += section.size / 4096;
+    }
+    return count;
+}
+
+int SaveStateDiff::diffPages(int type_filter, const std::function<void(uintptr_t addr, const char* first_page, const char* second_page)>& callback)
+{
+    if (!opened)
+        return 0;
+
+    int count = 0;
+    char first_page[4096];
+    char second_page[4096];
+
+    for (const MemSection& section : second.sections()) {
+        /* Filter based on type */
+        if (!(type_filter & section.type))
+            continue;
+
+        for (uintptr_t addr = section.addr; addr < section.endaddr; addr += 4096) {
+            SaveStateMemory::PageRef second_ref, first_ref;
+            if (!second.resolvePage(addr, second_ref))
+                continue;
+            if (!first.resolvePage(addr, first_ref))
+                continue;
+
+            /* Pages stored at the same location are identical */
+            if (SaveStateMemory::samePage(first_ref, second_ref))
+                continue;
+
+            if (!first.readPage(first_ref, first_page) || !second.readPage(second_ref, second_page))
+                continue;
+
+            if (memcmp(first_page, second_page, 4096) == 0)
+                continue;
+
+            callback(addr, first_page, second_page);
+            count++;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SAVESTATEDIFF_H_INCLUDED
+#define LIBTAS_SAVESTATEDIFF_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+#include "SaveStateMemory.h"
+#include "../Context.h"
+
+/* Compare the memory stored in two savestates of the game, without loading
+ * them.
+ *
+ * Pages are first compared by their location in the savestates, so that
+ * pages shared by both savestates are never read.
+ */
+class SaveStateDiff {
+    public:
+        SaveStateDiff(Context* c);
+
+        /* Open the savestates of two slots. Returns false and fills `error`
+         * if one of them cannot be read. */
+        bool open(int first_slot, int second_slot, std::string& error);
+
+        /* Number of pages of the second savestate located in memory sections
+         * of types `type_filter` */
+        int pageCount(int type_filter);
+
+        /* Call `callback` with the address and the content in both
+         * savestates of each page located in memory sections of types
+         * `type_filter` whose content differs. Pages missing from one
+         * savestate are ignored. Returns the number of differing pages. */
+        int diffPages(int type_filter, const std::function<void(uintptr_t addr, const char* first_page, const char* second_page)>& callback);
+
+    private:
+        SaveStateMemory first;
+        SaveStateMemory second;
+        bool opened;
+};
+
+#endif
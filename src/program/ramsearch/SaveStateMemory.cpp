@@ -0,0 +1,544 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SaveStateMemory.h"
+#include "../../library/checkpoint/StateHeader.h"
+#include "../../library/checkpoint/StateSlots.h"
+#include "../../library/checkpoint/StateChain.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <algorithm>
+#ifdef LIBTAS_HAS_LZ4
+#include <lz4.h>
+#endif
+
+using libtas::Area;
+
+/* Savestate read into memory, except for the content of its pages */
+struct SaveStateMemory::State {
+    int pmfd = -1;
+    int pfd = -1;
+
+    /* Pagemap memfd of the savestate in the game, or 0 if stored on disk */
+    int game_pmfd = 0;
+
+    /* Identity of the pages file, to compare page locations between
+     * savestates opened separately */
+    dev_t pages_dev = 0;
+    ino_t pages_ino = 0;
+
+    /* Parent savestate in the delta chain, or nullptr */
+    const State* parent = nullptr;
+
+    libtas::StateHeader header;
+
+    /* Areas containing pages, sorted by address, with the index of their
+     * first page in the arrays below */
+    std::vector<Area> areas;
+    std::vector<size_t> first_pages;
+
+    /* Flag, position in the pages file and stored size of each page */
+    std::vector<char> flags;
+    std::vector<off_t> offsets;
+    std::vector<uint16_t> sizes;
+
+    /* Content of the pages file of deduplicated savestates */
+    std::vector<uint32_t> ids;
+
+    ~State()
+    {
+        if (pmfd != -1)
+            ::close(pmfd);
+        if (pfd != -1)
+            ::close(pfd);
+    }
+};
+
+static bool readFile(int fd, std::vector<char>& content)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return false;
+
+    content.resize(st.st_size);
+    size_t done = 0;
+    while (done < content.size()) {
+        ssize_t ret = pread(fd, content.data() + done, content.size() - done, done);
+        if (ret <= 0)
+            return false;
+        done += ret;
+    }
+    return true;
+}
+
+static bool readAt(int fd, void* buf, size_t size, off_t offset)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = pread(fd, static_cast<char*>(buf) + done, size - done, offset + done);
+        if (ret <= 0)
+            return false;
+        done += ret;
+    }
+    return true;
+}
+
+/* Fill a memory section from a savestate area */
+static void fillSection(const Area& area, MemSection& section)
+{
+    section.addr = reinterpret_cast<uintptr_t>(area.addr);
+    section.endaddr = reinterpret_cast<uintptr_t>(area.endAddr);
+    section.size = area.size;
+    section.readflag = area.prot & PROT_READ;
+    section.writeflag = area.prot & PROT_WRITE;
+    section.execflag = area.prot & PROT_EXEC;
+    section.sharedflag = area.flags & MAP_SHARED;
+    section.offset = area.offset;
+    section.inode = area.inodenum;
+    section.filename = area.name;
+    section.detectType();
+}
+
+SaveStateMemory::SaveStateMemory(Context* c) : context(c), slots_fd(-1), chain_fd(-1), pool_fd(-1) {}
+
+SaveStateMemory::~SaveStateMemory()
+{
+    close();
+}
+
+void SaveStateMemory::close()
+{
+    state.reset();
+    base.reset();
+    ancestors.clear();
+    memory_sections.clear();
+
+    if (slots_fd != -1)
+        ::close(slots_fd);
+    if (chain_fd != -1)
+        ::close(chain_fd);
+    if (pool_fd != -1)
+        ::close(pool_fd);
+    slots_fd = -1;
+    chain_fd = -1;
+    pool_fd = -1;
+}
+
+int SaveStateMemory::openGameFd(int fd)
+{
+    std::string path = "/proc/" + std::to_string(context->game_pid) + "/fd/" + std::to_string(fd);
+    return ::open(path.c_str(), O_RDONLY);
+}
+
+int SaveStateMemory::openGameMemfd(const char* name)
+{
+    std::string dirpath = "/proc/" + std::to_string(context->game_pid) + "/fd";
+    std::string target = std::string("/memfd:") + name + " (deleted)";
+
+    DIR* dir = opendir(dirpath.c_str());
+    if (!dir)
+        return -1;
+
+    int fd = -1;
+    char link[256];
+    struct dirent* entry;
+    while ((fd == -1) && (entry = readdir(dir))) {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        std::string path = dirpath + '/' + entry->d_name;
+        ssize_t len = readlink(path.c_str(), link, sizeof(link) - 1);
+        if (len <= 0)
+            continue;
+        link[len] = '\0';
+
+        if (target.compare(link) == 0)
+            fd = ::open(path.c_str(), O_RDONLY);
+    }
+
+    closedir(dir);
+    return fd;
+}
+
+bool SaveStateMemory::open(int slot, std::string& error)
+{
+    close();
+
+    if (context->config.sc.savestates_in_ram) {
+        slots_fd = openGameMemfd("stateslots");
+        chain_fd = openGameMemfd("statechain");
+        pool_fd = openGameMemfd("pagestore");
+    }
+
+    state = openSlot(slot, error);
+    if (!state)
+        return false;
+
+    /* Open the whole delta chain, and the base savestate if a savestate of
+     * the chain refers to it */
+    bool needs_base = false;
+    State* s = state.get();
+    for (int d = 0; (s != nullptr) && (d <= libtas::StateChain::MAX_DEPTH); d++) {
+        if (std::find(s->flags.begin(), s->flags.end(), Area::BASE_PAGE) != s->flags.end())
+            needs_base = true;
+
+        std::unique_ptr<State> parent = openParent(s);
+        if (!parent || ancestors.count(parent->game_pmfd))
+            break;
+
+        s->parent = parent.get();
+        s = parent.get();
+        ancestors[parent->game_pmfd] = std::move(parent);
+    }
+
+    if (needs_base) {
+        std::string base_error;
+        base = openSlot(0, base_error);
+    }
+
+    MemSection::reset();
+    for (const Area& area : state->areas) {
+        MemSection section;
+        fillSection(area, section);
+        memory_sections.push_back(section);
+    }
+
+    return true;
+}
+
+std::unique_ptr<SaveStateMemory::State> SaveStateMemory::openSlot(int slot, std::string& error)
+{
+    int pmfd = -1;
+    int pfd = -1;
+    int game_pmfd = 0;
+
+    if (context->config.sc.savestates_in_ram) {
+        libtas::SlotFds slot_fds = {0, 0};
+        if ((slots_fd == -1) ||
+            !readAt(slots_fd, &slot_fds, sizeof(slot_fds), slot * sizeof(slot_fds)) ||
+            !slot_fds.pagemap_fd) {
+            error = "State " + std::to_string(slot) + " does not exist";
+            return nullptr;
+        }
+
+        game_pmfd = slot_fds.pagemap_fd;
+        pmfd = openGameFd(slot_fds.pagemap_fd);
+        pfd = openGameFd(slot_fds.pages_fd);
+    }
+    else {
+        std::string savestatepath = context->config.savestatedir + '/';
+        savestatepath += context->gamename;
+        savestatepath += ".state" + std::to_string(slot);
+
+        pmfd = ::open((savestatepath + ".pm").c_str(), O_RDONLY);
+        pfd = ::open((savestatepath + ".p").c_str(), O_RDONLY);
+    }
+
+    if ((pmfd == -1) || (pfd == -1)) {
+        if (pmfd != -1)
+            ::close(pmfd);
+        if (pfd != -1)
+            ::close(pfd);
+        error = "State " + std::to_string(slot) + " could not be opened";
+        return nullptr;
+    }
+
+    std::unique_ptr<State> state = openFds(pmfd, pfd, error);
+    if (!state) {
+        error = "State " + std::to_string(slot) + error;
+        return nullptr;
+    }
+
+    state->game_pmfd = game_pmfd;
+    return state;
+}
+
+std::unique_ptr<SaveStateMemory::State> SaveStateMemory::openFds(int pmfd, int pfd, std::string& error)
+{
+    std::unique_ptr<State> state(new State);
+    state->pmfd = pmfd;
+    state->pfd = pfd;
+
+    struct stat st;
+    if (fstat(pfd, &st) == 0) {
+        state->pages_dev = st.st_dev;
+        state->pages_ino = st.st_ino;
+    }
+
+    std::vector<char> pagemap;
+    if (!readFile(pmfd, pagemap) || (pagemap.size() < sizeof(libtas::StateHeader))) {
+        error = " is empty";
+        return nullptr;
+    }
+
+    libtas::StateHeader& sh = state->header;
+    memcpy(&sh, pagemap.data(), sizeof(sh));
+    if ((sh.magic != STATEMAGIC) || (sh.version != STATEVERSION)) {
+        error = " was saved by another version of libTAS";
+        return nullptr;
+    }
+
+#ifndef LIBTAS_HAS_LZ4
+    if (sh.compressed) {
+        error = " is compressed, which is not supported by this build";
+        return nullptr;
+    }
+#endif
+
+    if (sh.deduplicated && (pool_fd == -1)) {
+        error = " has its pages stored in a page store that could not be opened";
+        return nullptr;
+    }
+
+    /* Walk through all areas up to the null area */
+    size_t pos = sizeof(sh);
+    while (true) {
+        if (pos + sizeof(Area) > pagemap.size()) {
+            error = " is incomplete";
+            return nullptr;
+        }
+
+        Area area;
+        memcpy(&area, pagemap.data() + pos, sizeof(Area));
+        pos += sizeof(Area);
+
+        if (area.addr == nullptr)
+            break;
+
+        if (area.skip)
+            continue;
+
+        size_t nb_pages = area.size / 4096;
+        size_t sizes_pos = pos + nb_pages;
+        size_t end_pos = sizes_pos + (sh.compressed ? nb_pages * sizeof(uint16_t) : 0);
+        if (end_pos > pagemap.size()) {
+            error = " is incomplete";
+            return nullptr;
+        }
+
+        state->areas.push_back(area);
+        state->first_pages.push_back(state->flags.size());
+
+        off_t offset = area.page_offset;
+        for (size_t p = 0; p < nb_pages; p++) {
+            char flag = pagemap[pos + p];
+            uint16_t size = 0;
+            if (flag == Area::FULL_PAGE) {
+                if (sh.compressed)
+                    memcpy(&size, pagemap.data() + sizes_pos + p * sizeof(uint16_t), sizeof(uint16_t));
+                else if (sh.deduplicated)
+                    size = sizeof(uint32_t);
+                else
+                    size = 4096;
+            }
+            state->flags.push_back(flag);
+            state->offsets.push_back(offset);
+            state->sizes.push_back(size);
+            offset += size;
+        }
+
+        pos = end_pos;
+    }
+
+    /* Page ids are small enough to be all read at once */
+    if (sh.deduplicated) {
+        std::vector<char> pages;
+        if (!readFile(pfd, pages)) {
+            error = " is incomplete";
+            return nullptr;
+        }
+        state->ids.resize(pages.size() / sizeof(uint32_t));
+        memcpy(state->ids.data(), pages.data(), state->ids.size() * sizeof(uint32_t));
+    }
+
+    return state;
+}
+
+std::unique_ptr<SaveStateMemory::State> SaveStateMemory::openParent(const State* state)
+{
+    if (!state->game_pmfd || (chain_fd == -1))
+        return nullptr;
+
+    libtas::ChainNode node;
+    if (!readAt(chain_fd, &node, sizeof(node), state->game_pmfd * sizeof(node)) || !node.parent)
+        return nullptr;
+
+    libtas::ChainNode parent_node;
+    if (!readAt(chain_fd, &parent_node, sizeof(parent_node), node.parent * sizeof(parent_node)))
+        return nullptr;
+
+    int pmfd = openGameFd(node.parent);
+    int pfd = openGameFd(parent_node.pages_fd);
+    if ((pmfd == -1) || (pfd == -1)) {
+        if (pmfd != -1)
+            ::close(pmfd);
+        if (pfd != -1)
+            ::close(pfd);
+        return nullptr;
+    }
+
+    std::string error;
+    std::unique_ptr<State> parent = openFds(pmfd, pfd, error);
+    if (parent)
+        parent->game_pmfd = node.parent;
+    return parent;
+}
+
+bool SaveStateMemory::resolvePage(uintptr_t addr, PageRef& ref) const
+{
+    /* A page is found after following at most the delta chain and the base
+     * savestate */
+    const State* s = state.get();
+    for (int d = 0; (s != nullptr) && (d <= libtas::StateChain::MAX_DEPTH + 1); d++) {
+        auto it = std::upper_bound(s->areas.begin(), s->areas.end(), addr,
+            [](uintptr_t a, const Area& area) { return a < reinterpret_cast<uintptr_t>(area.addr); });
+        if (it == s->areas.begin())
+            return false;
+        --it;
+        if (addr >= reinterpret_cast<uintptr_t>(it->endAddr))
+            return false;
+
+        size_t page = s->first_pages[it - s->areas.begin()] +
+            (addr - reinterpret_cast<uintptr_t>(it->addr)) / 4096;
+
+        switch (s->flags[page]) {
+            case Area::NO_PAGE:
+                /* Anonymous pages that were never touched are filled with zeros */
+                if (!(it->flags & MAP_ANONYMOUS))
+                    return false;
+                /* Fall through */
+            case Area::ZERO_PAGE:
+                ref.state = nullptr;
+                ref.flag = Area::ZERO_PAGE;
+                return true;
+            case Area::FULL_PAGE:
+                ref.state = s;
+                ref.flag = Area::FULL_PAGE;
+                ref.offset = s->offsets[page];
+                ref.size = s->sizes[page];
+                ref.id = 0;
+                if (s->header.deduplicated) {
+                    size_t i = ref.offset / sizeof(uint32_t);
+                    if (i >= s->ids.size())
+                        return false;
+                    ref.id = s->ids[i];
+                }
+                return true;
+            case Area::BASE_PAGE:
+                s = base.get();
+                break;
+            case Area::PARENT_PAGE:
+                s = s->parent;
+                break;
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool SaveStateMemory::readPage(const PageRef& ref, char* page) const
+{
+    if (ref.flag == Area::ZERO_PAGE) {
+        memset(page, 0, 4096);
+        return true;
+    }
+
+    if (ref.state->header.deduplicated)
+        return readAt(pool_fd, page, 4096, static_cast<off_t>(ref.id) * 4096);
+
+    if (ref.size == 4096)
+        return readAt(ref.state->pfd, page, 4096, ref.offset);
+
+#ifdef LIBTAS_HAS_LZ4
+    char compressed[4096];
+    if (!readAt(ref.state->pfd, compressed, ref.size, ref.offset))
+        return false;
+    return LZ4_decompress_safe(compressed, page, ref.size, 4096) == 4096;
+#else
+    return false;
+#endif
+}
+
+bool SaveStateMemory::samePage(const PageRef& first, const PageRef& second)
+{
+    if ((first.flag == Area::ZERO_PAGE) && (second.flag == Area::ZERO_PAGE))
+        return true;
+
+    if ((first.flag != Area::FULL_PAGE) || (second.flag != Area::FULL_PAGE))
+        return false;
+
+    if (first.state->header.deduplicated && second.state->header.deduplicated)
+        return first.id == second.id;
+
+    return (first.state->pages_dev == second.state->pages_dev) &&
+        (first.state->pages_ino == second.state->pages_ino) &&
+        (first.offset == second.offset);
+}
+
+size_t SaveStateMemory::readv(void* local, const struct iovec* remote, size_t count) const
+{
+    char* dest = static_cast<char*>(local);
+    size_t done = 0;
+
+    /* Last page read, as consecutive ranges often share pages */
+    char page[4096];
+    uintptr_t page_addr = 0;
+    bool has_page = false;
+
+    for (size_t r = 0; r < count; r++) {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(remote[r].iov_base);
+        uintptr_t endaddr = addr + remote[r].iov_len;
+
+        while (addr < endaddr) {
+            uintptr_t cur_page_addr = addr & ~static_cast<uintptr_t>(4095);
+            size_t size = std::min(endaddr, cur_page_addr + 4096) - addr;
+
+            if (!has_page || (page_addr != cur_page_addr)) {
+                PageRef ref;
+                if (!resolvePage(cur_page_addr, ref) || !readPage(ref, page))
+                    return done;
+                page_addr = cur_page_addr;
+                has_page = true;
+            }
+
+            memcpy(dest + done, page + (addr - cur_page_addr), size);
+            done += size;
+            addr += size;
+        }
+    }
+
+    return done;
+}
+
+std::unique_ptr<MemReader> openMemReader(Context* context, int slot, std::string& error)
+{
+    if (slot < 0)
+        return std::unique_ptr<MemReader>(new ProcessMemReader(context->game_pid));
+
+    std::unique_ptr<SaveStateMemory> savestate(new SaveStateMemory(context));
+    if (!savestate->open(slot, error))
+        return nullptr;
+
+    return std::unique_ptr<MemReader>(savestate.release());
+}
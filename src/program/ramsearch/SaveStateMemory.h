@@ -0,0 +1,117 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SAVESTATEMEMORY_H_INCLUDED
+#define LIBTAS_SAVESTATEMEMORY_H_INCLUDED
+
+#include <cstdint>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "MemReader.h"
+#include "MemSection.h"
+#include "../Context.h"
+
+/* Memory of the game stored in a savestate, read without loading it.
+ * Savestates are read from their files on disk, or from the memfds of the
+ * game process when they are stored in RAM, following base savestates,
+ * delta chains and the page store.
+ *
+ * All savestates needed to resolve pages are opened with the savestate, so
+ * that memory can then be read from multiple threads. */
+class SaveStateMemory : public MemReader {
+    public:
+        struct State;
+
+        /* Location of the content of a page */
+        struct PageRef {
+            const State* state;
+            char flag;
+            off_t offset;
+            uint16_t size;
+            uint32_t id;
+        };
+
+        SaveStateMemory(Context* c);
+        ~SaveStateMemory();
+
+        /* Open the savestate of a slot. Returns false and fills `error` if
+         * it cannot be read. */
+        bool open(int slot, std::string& error);
+
+        void close();
+
+        /* Memory sections stored in the savestate */
+        std::vector<MemSection> sections() const override {return memory_sections;}
+
+        /* Find where the page at `addr` is stored. Returns false if the
+         * savestate does not contain the page. */
+        bool resolvePage(uintptr_t addr, PageRef& ref) const;
+
+        /* Read the content of a page */
+        bool readPage(const PageRef& ref, char* page) const;
+
+        /* Both pages are stored at the same location, and are identical */
+        static bool samePage(const PageRef& first, const PageRef& second);
+
+        size_t readv(void* local, const struct iovec* remote, size_t count) const override;
+
+    private:
+        Context *context;
+
+        std::unique_ptr<State> state;
+
+        /* Base savestate, and ancestors of the delta chain indexed by their
+         * pagemap memfd in the game, if needed */
+        std::unique_ptr<State> base;
+        std::map<int, std::unique_ptr<State>> ancestors;
+
+        /* Memfds of the game holding the savestate table, the delta chain
+         * table and the page store, or -1 */
+        int slots_fd;
+        int chain_fd;
+        int pool_fd;
+
+        std::vector<MemSection> memory_sections;
+
+        /* Open a file descriptor of the game process */
+        int openGameFd(int fd);
+
+        /* Open the memfd of the game process created with name `name` */
+        int openGameMemfd(const char* name);
+
+        std::unique_ptr<State> openSlot(int slot, std::string& error);
+        std::unique_ptr<State> openFds(int pmfd, int pfd, std::string& error);
+
+        /* Open the parent of a savestate in the delta chain, or return
+         * nullptr if it has none */
+        std::unique_ptr<State> openParent(const State* state);
+
+        const State* getParent(const State* state) const;
+};
+
+/* Get a reader of the running game if `slot` is negative, or of the
+ * savestate of `slot`. Returns nullptr and fills `error` if the savestate
+ * cannot be opened. */
+std::unique_ptr<MemReader> openMemReader(Context* context, int slot, std::string& error);
+
+#endif
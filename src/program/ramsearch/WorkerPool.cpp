@@ -0,0 +1,68 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "WorkerPool.h"
+#include <thread>
+#include <vector>
+
+WorkerPool::WorkerPool() : cancel_flag(false)
+{
+    thread_count = std::thread::hardware_concurrency();
+    if (thread_count < 1)
+        thread_count = 1;
+}
+
+void WorkerPool::run(size_t task_count, const std::function<void(size_t, int)>& task)
+{
+    std::atomic<size_t> next_task(0);
+
+    auto worker = [&] (int thread) {
+        size_t i;
+        while (!cancel_flag && ((i = next_task++) < task_count))
+            task(i, thread);
+    };
+
+    /* Don't start more threads than tasks */
+    size_t count = (task_count < static_cast<size_t>(thread_count)) ? task_count : thread_count;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < count; t++)
+        threads.emplace_back(worker, t);
+
+    worker(0);
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void WorkerPool::cancel()
+{
+    cancel_flag = true;
+}
+
+bool WorkerPool::canceled() const
+{
+    return cancel_flag;
+}
+
+void WorkerPool::reset()
+{
+    cancel_flag = false;
+}
@@ -0,0 +1,54 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBTAS_WORKERPOOL_H_INCLUDED
+#define LIBTAS_WORKERPOOL_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+/* Run independent tasks on all processor cores. Tasks are picked by the
+ * threads in increasing order, so that each thread can use its own buffers,
+ * indexed by the thread number passed to the task. */
+class WorkerPool {
+    public:
+        WorkerPool();
+
+        int threadCount() const {return thread_count;}
+
+        /* Call `task(i, thread)` for each task `i` in [0, task_count), and
+         * return when all tasks are done or when the pool was canceled.
+         * The calling thread also runs tasks, as thread 0. */
+        void run(size_t task_count, const std::function<void(size_t, int)>& task);
+
+        /* Stop starting new tasks. Can be called from any thread. */
+        void cancel();
+        bool canceled() const;
+
+        /* Clear the canceled state before a new operation */
+        void reset();
+
+    private:
+        int thread_count;
+        std::atomic<bool> cancel_flag;
+};
+
+#endif
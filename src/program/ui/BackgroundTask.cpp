@@ -0,0 +1,49 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <QEventLoop>
+#include <QTimer>
+#include <atomic>
+#include <thread>
+
+#include "BackgroundTask.h"
+
+void runInBackground(const std::function<void()>& work, const std::function<void()>& update)
+{
+    std::atomic<bool> done(false);
+    std::thread worker([&] {
+        work();
+        done = true;
+    });
+
+    QEventLoop loop;
+    QTimer timer;
+    QObject::connect(&timer, &QTimer::timeout, [&] {
+        /* Check before updating, so that the last update sees all work */
+        bool finished = done;
+        update();
+        if (finished)
+            loop.quit();
+    });
+    timer.start(50);
+    loop.exec();
+
+    worker.join();
+}
@@ -17,7 +17,15 @@
     along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "IRamWatch.h"
 
-bool IRamWatch::isValid;
-pid_t IRamWatch::game_pid;
+#ifndef LIBTAS_BACKGROUNDTASK_H_INCLUDED
+#define LIBTAS_BACKGROUNDTASK_H_INCLUDED
+
+#include <functional>
+
+/* Run `work` in a separate thread, while the UI keeps processing events.
+ * `update` is called from the UI thread periodically and once `work` is
+ * done, and the function returns after that. */
+void runInBackground(const std::function<void()>& work, const std::function<void()>& update);
+
+#endif
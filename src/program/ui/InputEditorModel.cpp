@@ -616,6 +616,10 @@ void InputEditorModel::resetInputs()
  */
 void InputEditorModel::registerSavestate(int slot, unsigned long frame)
 {
+    /* Only hotkey savestates are displayed */
+    if ((slot < 0) || (slot >= static_cast<int>(savestate_frames.size())))
+        return;
+
     if (frame > 0)
         savestate_frames[slot] = frame;
     int old_savestate = last_savestate;
@@ -58,6 +58,7 @@ MainWindow::MainWindow(Context* c) : QMainWindow(), context(c)
     connect(gameLoop, &GameLoop::frameCountChanged, this, &MainWindow::updateFrameCountTime);
     connect(gameLoop, &GameLoop::sharedConfigChanged, this, &MainWindow::updateSharedConfigChanged);
     connect(gameLoop, &GameLoop::fpsChanged, this, &MainWindow::updateFps);
+    connect(gameLoop, &GameLoop::savestateDurable, this, &MainWindow::updateSavestateDurable);
     connect(gameLoop, &GameLoop::askToShow, this, &MainWindow::alertOffer);
 
     /* Create other windows */
@@ -72,6 +73,7 @@ MainWindow::MainWindow(Context* c) : QMainWindow(), context(c)
     osdWindow = new OsdWindow(c, this);
     annotationsWindow = new AnnotationsWindow(c, this);
     autoSaveWindow = new AutoSaveWindow(c, this);
+    savestateStatsWindow = new SavestateStatsWindow(this);
 
     connect(inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::frameCountChanged, this, &MainWindow::updateFrameCountTime);
     connect(gameLoop, &GameLoop::inputsToBeChanged, inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::beginModifyInputs);
@@ -542,6 +544,22 @@ void MainWindow::createActions()
     addActionCheckable(slowdownGroup, tr("25%"), 4);
     addActionCheckable(slowdownGroup, tr("12%"), 8);
 
+    savestateThreadsGroup = new QActionGroup(this);
+    connect(savestateThreadsGroup, &QActionGroup::triggered, this, &MainWindow::slotSavestateThreads);
+
+    addActionCheckable(savestateThreadsGroup, tr("1 thread"), 1);
+    addActionCheckable(savestateThreadsGroup, tr("2 threads"), 2);
+    addActionCheckable(savestateThreadsGroup, tr("4 threads"), 4);
+    addActionCheckable(savestateThreadsGroup, tr("8 threads"), 8);
+
+    savestateChainGroup = new QActionGroup(this);
+    connect(savestateChainGroup, &QActionGroup::triggered, this, &MainWindow::slotSavestateChain);
+
+    addActionCheckable(savestateChainGroup, tr("Disabled"), 0);
+    addActionCheckable(savestateChainGroup, tr("4 savestates"), 4);
+    addActionCheckable(savestateChainGroup, tr("8 savestates"), 8);
+    addActionCheckable(savestateChainGroup, tr("16 savestates"), 16);
+
     fastforwardGroup = new QActionGroup(this);
     fastforwardGroup->setExclusive(false);
     connect(fastforwardGroup, &QActionGroup::triggered, this, &MainWindow::slotFastforwardMode);
@@ -680,6 +698,32 @@ void MainWindow::createMenus()
     backtrackStateAction->setCheckable(true);
     disabledActionsOnStart.append(backtrackStateAction);
 
+#ifdef LIBTAS_HAS_LZ4
+    compressStateAction = savestateMenu->addAction(tr("Compress savestates"), this, &MainWindow::slotCompressState);
+    compressStateAction->setCheckable(true);
+#else
+    compressStateAction = savestateMenu->addAction(tr("Compress savestates (unavailable)"), this, &MainWindow::slotCompressState);
+    compressStateAction->setEnabled(false);
+    context->config.sc.savestates_compression = false;
+#endif
+
+    dedupStateAction = savestateMenu->addAction(tr("Deduplicate pages of savestates in RAM"), this, &MainWindow::slotDedupState);
+    dedupStateAction->setCheckable(true);
+
+    asyncStateAction = savestateMenu->addAction(tr("Write savestates on disk in background"), this, &MainWindow::slotAsyncState);
+    asyncStateAction->setCheckable(true);
+
+    lazyStateAction = savestateMenu->addAction(tr("Load savestates lazily"), this, &MainWindow::slotLazyState);
+    lazyStateAction->setCheckable(true);
+
+    QMenu *savestateThreadsMenu = savestateMenu->addMenu(tr("Writer threads"));
+    savestateThreadsMenu->addActions(savestateThreadsGroup->actions());
+    savestateThreadsMenu->installEventFilter(this);
+
+    QMenu *savestateChainMenu = savestateMenu->addMenu(tr("Delta chains of savestates in RAM"));
+    savestateChainMenu->addActions(savestateChainGroup->actions());
+    savestateChainMenu->installEventFilter(this);
+
     saveScreenAction = runtimeMenu->addAction(tr("Save screen"), this, &MainWindow::slotSaveScreen);
     saveScreenAction->setCheckable(true);
     preventSavefileAction = runtimeMenu->addAction(tr("Backup savefiles in memory"), this, &MainWindow::slotPreventSavefile);
@@ -728,6 +772,7 @@ void MainWindow::createMenus()
     toolsMenu->addSeparator();
 
     toolsMenu->addAction(tr("Game information..."), gameInfoWindow, &GameInfoWindow::exec);
+    toolsMenu->addAction(tr("Savestate statistics..."), savestateStatsWindow, &SavestateStatsWindow::show);
 
     toolsMenu->addSeparator();
 
@@ -928,6 +973,11 @@ void MainWindow::updateFps(float fps, float lfps)
     }
 }
 
+void MainWindow::updateSavestateDurable(int slot)
+{
+    statusBar()->showMessage(QString("Savestate %1 written on disk").arg(slot), 2000);
+}
+
 void MainWindow::updateRam()
 {
     if (ramSearchWindow->isVisible()) {
@@ -1053,6 +1103,8 @@ void MainWindow::updateUIFromConfig()
     setCheckboxesFromMask(loggingExcludeGroup, context->config.sc.excludeFlags);
 
     setRadioFromList(slowdownGroup, context->config.sc.speed_divisor);
+    setRadioFromList(savestateThreadsGroup, context->config.sc.savestate_threads);
+    setRadioFromList(savestateChainGroup, context->config.sc.savestates_chain_length);
 
     keyboardAction->setChecked(context->config.sc.keyboard_support);
     mouseAction->setChecked(context->config.sc.mouse_support);
@@ -1086,6 +1138,10 @@ void MainWindow::updateUIFromConfig()
     incrementalStateAction->setChecked(context->config.sc.incremental_savestates);
     ramStateAction->setChecked(context->config.sc.savestates_in_ram);
     backtrackStateAction->setChecked(context->config.sc.backtrack_savestate);
+    compressStateAction->setChecked(context->config.sc.savestates_compression);
+    dedupStateAction->setChecked(context->config.sc.savestates_deduplication);
+    asyncStateAction->setChecked(context->config.sc.savestates_async);
+    lazyStateAction->setChecked(context->config.sc.savestates_lazy);
 
     setCheckboxesFromMask(fastforwardGroup, context->config.sc.fastforward_mode);
 
@@ -1427,6 +1483,18 @@ void MainWindow::slotSlowdown()
     context->config.sc_modified = true;
 }
 
+void MainWindow::slotSavestateThreads()
+{
+    setListFromRadio(savestateThreadsGroup, context->config.sc.savestate_threads);
+    context->config.sc_modified = true;
+}
+
+void MainWindow::slotSavestateChain()
+{
+    setListFromRadio(savestateChainGroup, context->config.sc.savestates_chain_length);
+    context->config.sc_modified = true;
+}
+
 void MainWindow::slotFastforwardMode()
 {
     setMaskFromCheckboxes(fastforwardGroup, context->config.sc.fastforward_mode);
@@ -1467,6 +1535,10 @@ void MainWindow::slotMovieEnd()
 BOOLSLOT(slotIncrementalState, context->config.sc.incremental_savestates)
 BOOLSLOT(slotRamState, context->config.sc.savestates_in_ram)
 BOOLSLOT(slotBacktrackState, context->config.sc.backtrack_savestate)
+BOOLSLOT(slotCompressState, context->config.sc.savestates_compression)
+BOOLSLOT(slotDedupState, context->config.sc.savestates_deduplication)
+BOOLSLOT(slotAsyncState, context->config.sc.savestates_async)
+BOOLSLOT(slotLazyState, context->config.sc.savestates_lazy)
 BOOLSLOT(slotAutoRestart, context->config.auto_restart)
 
 void MainWindow::alertOffer(QString alert_msg, void* promise)
@@ -44,6 +44,7 @@
 #include "OsdWindow.h"
 #include "AnnotationsWindow.h"
 #include "AutoSaveWindow.h"
+#include "SavestateStatsWindow.h"
 #include "../GameLoop.h"
 #include "../Context.h"
 
@@ -72,6 +73,7 @@ public:
     OsdWindow* osdWindow;
     AnnotationsWindow* annotationsWindow;
     AutoSaveWindow* autoSaveWindow;
+    SavestateStatsWindow* savestateStatsWindow;
 
     QList<QWidget*> disabledWidgetsOnStart;
     QList<QAction*> disabledActionsOnStart;
@@ -106,6 +108,12 @@ public:
     QAction *incrementalStateAction;
     QAction *ramStateAction;
     QAction *backtrackStateAction;
+    QAction *compressStateAction;
+    QAction *dedupStateAction;
+    QAction *asyncStateAction;
+    QAction *lazyStateAction;
+    QActionGroup *savestateThreadsGroup;
+    QActionGroup *savestateChainGroup;
     QAction *steamAction;
 
     QActionGroup *debugStateGroup;
@@ -224,6 +232,9 @@ private slots:
     /* Update fps values */
     void updateFps(float fps, float lfps);
 
+    /* Notify that a savestate written in background is on disk */
+    void updateSavestateDurable(int slot);
+
     /* Update ramsearch and ramwatch values if window is shown */
     void updateRam();
 
@@ -260,6 +271,8 @@ private slots:
     void slotLoggingPrint();
     void slotLoggingExclude();
     void slotSlowdown();
+    void slotSavestateThreads();
+    void slotSavestateChain();
     void slotFastforwardMode();
     void slotScreenRes();
 #ifdef LIBTAS_ENABLE_HUD
@@ -273,6 +286,10 @@ private slots:
     void slotIncrementalState(bool checked);
     void slotRamState(bool checked);
     void slotBacktrackState(bool checked);
+    void slotCompressState(bool checked);
+    void slotDedupState(bool checked);
+    void slotAsyncState(bool checked);
+    void slotLazyState(bool checked);
     void slotRecycleThreads(bool checked);
     void slotSteam(bool checked);
     void slotCalibrateMouse();
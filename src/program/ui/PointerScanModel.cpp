@@ -17,34 +17,36 @@
     along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <mutex>
+#include <iterator>
+#include <algorithm>
+
 #include "PointerScanModel.h"
+#include "BackgroundTask.h"
+#include "../ramsearch/PointerChainFile.h"
+#include "../ramsearch/PointerChainResolver.h"
+#include "../ramsearch/SaveStateMemory.h"
 
-PointerScanModel::PointerScanModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c) {}
+PointerScanModel::PointerScanModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c), progress(0), busy(false), source_slot(-1) {}
 
-void PointerScanModel::locatePointers()
+bool PointerScanModel::setSource(int slot, std::string& error)
 {
-    pointer_map.clear();
-    static_pointer_map.clear();
-
-    /* Compose the filename for the /proc memory map, and open it. */
-    std::ostringstream oss;
-    oss << "/proc/" << context->game_pid << "/maps";
-    std::ifstream mapsfile(oss.str());
-    if (!mapsfile) {
-        std::cerr << "Could not open " << oss.str() << std::endl;
-        return;
-    }
-
-    std::string line;
-    MemSection::reset();
+    std::unique_ptr<MemReader> source = openMemReader(context, slot, error);
+    if (!source)
+        return false;
 
-    std::vector<MemSection> memory_sections;
-    int total_size = 0;
-    while (std::getline(mapsfile, line)) {
+    reader = std::move(source);
+    source_slot = slot;
+    return true;
+}
 
-        MemSection section;
-        section.readMap(line);
+void PointerScanModel::locatePointers()
+{
+    pointer_index.clear();
 
+    std::vector<MemSection> memory_sections;
+    uint64_t total_size = 0;
+    for (const MemSection& section : reader->sections()) {
         /* Only store sections that could contain pointers */
         if (section.type & (MemSection::MemDataRW | MemSection::MemBSS | MemSection::MemHeap | MemSection::MemAnonymousMappingRW)) {
         // if (section.type & (MemSection::MemDataRW | MemSection::MemBSS | MemSection::MemHeap)) {
@@ -53,116 +55,131 @@ void PointerScanModel::locatePointers()
         }
     }
 
-    /* Read all memory and store all pointers */
-    int cur_size = 0;
-    for (const MemSection &section : memory_sections) {
-
-        struct iovec local, remote;
-        for (uintptr_t addr = section.addr; addr < section.endaddr; addr += 4096) {
-
-            /* Read values in chunks of 4096 bytes so we lower the number
-             * of `process_vm_readv` calls.
-             */
-            uintptr_t chunk[4096/sizeof(uintptr_t)];
-            local.iov_base = static_cast<void*>(chunk);
-            local.iov_len = 4096;
-            remote.iov_base = reinterpret_cast<void*>(addr);
-            remote.iov_len = 4096;
-
-            int readValues = process_vm_readv(context->game_pid, &local, 1, &remote, 1, 0);
-            if (readValues < 0) {
-                continue;
-            }
+    if (total_size == 0)
+        return;
 
-            for (unsigned int i = 0; i < readValues/sizeof(uintptr_t); i++, cur_size += sizeof(uintptr_t)) {
-
-                /* Update progress bar */
-                if (!(cur_size & 0xfff)) {
-                    emit signalProgress((int)(100 * ((float)cur_size / total_size)));
-                }
-
-                /* Check if the value could be a pointer */
-                bool isPointer = false;
-
-                for (const MemSection &ms : memory_sections) {
-                    /* If pointing to a static section, we can skip it */
-                    if (ms.type & (MemSection::MemDataRW | MemSection::MemBSS)) {
-                        continue;
-                    }
-
-                    /* We take advantage of the fact that sections are ordered */
-                    if (chunk[i] < ms.addr) {
-                        break;
-                    }
-                    if (chunk[i] < ms.endaddr) {
-                        isPointer = true;
-                        break;
-                    }
-                }
-
-                if (isPointer) {
-                    uintptr_t stored_addr = addr + i*sizeof(uintptr_t);
-                    if (section.type & (MemSection::MemDataRW | MemSection::MemBSS)) {
-                        static_pointer_map.insert(std::make_pair(chunk[i], stored_addr));
-                    }
-                    else {
-                        pointer_map.insert(std::make_pair(chunk[i], stored_addr));
-                    }
-                }
-            }
-        }
-    }
+    /* Read all memory and store all pointers */
+    pointer_index.build(*reader, memory_sections, pool, [this, total_size] (size_t cur_size) {
+        progress = static_cast<int>(100 * cur_size / total_size);
+    });
 }
 
 
-void PointerScanModel::findPointerChain(uintptr_t addr, int ml, int max_offset)
+void PointerScanModel::findPointerChain(uintptr_t addr, int ml, int max_offset, int max_results)
 {
     static unsigned long last_scan_frame = 1 << 30;
-    /* Don't locate pointers again if this is the same frame */
-    if (last_scan_frame != context->framecount) {
-        locatePointers();
-        last_scan_frame = context->framecount;
-    }
+    static int last_scan_slot = -1;
+    /* Don't locate pointers again if this is the same frame and memory */
+    bool locate = (last_scan_frame != context->framecount) || (last_scan_slot != source_slot);
 
     beginResetModel();
-
     max_level = ml;
     pointer_chains.clear();
-    int offsets[10];
-
-    // std::cout << "max offset " << max_offset << std::endl;
+    endResetModel();
 
-    recursiveFind(addr, 0, offsets, max_offset);
+    busy = true;
+    pool.reset();
+    progress = 0;
+
+    /* Chains found by the search thread, not yet added to the model */
+    std::vector<PointerChain> pending_chains;
+    std::mutex pending_mutex;
+
+    runInBackground([&] {
+        if (locate) {
+            locatePointers();
+            if (pool.canceled())
+                return;
+            last_scan_frame = context->framecount;
+            last_scan_slot = source_slot;
+        }
 
-    endResetModel();
+        PointerChainSearch search(pointer_index, pool);
+        search.run(addr, ml, max_offset, max_results, [&] (std::vector<PointerChain>& chains) {
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            std::move(chains.begin(), chains.end(), std::back_inserter(pending_chains));
+        }, [this] (int p) {
+            progress = p;
+        });
+    }, [&] {
+        emit signalProgress(progress);
+
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (pending_chains.empty())
+            return;
+
+        beginInsertRows(QModelIndex(), pointer_chains.size(), pointer_chains.size() + pending_chains.size() - 1);
+        std::move(pending_chains.begin(), pending_chains.end(), std::back_inserter(pointer_chains));
+        endInsertRows();
+        pending_chains.clear();
+    });
+
+    busy = false;
 }
 
-void PointerScanModel::recursiveFind(uintptr_t addr, int level, int offsets[], int max_offset)
+void PointerScanModel::rescan(uintptr_t addr)
 {
-    /* Search inside static data */
-    auto iter = static_pointer_map.lower_bound(addr - max_offset);
-    while ((iter != static_pointer_map.end()) && (iter->first <= addr)) {
-        offsets[level] = addr - iter->first;
-        uintptr_t base_address = iter->second;
-        // std::cout << "Found static chain with last offset " << std::dec << offsets[level] << " and base address " << std::hex << base_address << std::endl;
-        std::vector<int> offset_vec(offsets, offsets + level + 1);
-        pointer_chains.push_back(std::make_pair(base_address,offset_vec));
-        iter++;
-    }
-
-    /* Stop if we reached the last level */
-    if (level == (max_level-1))
+    if (pointer_chains.empty())
         return;
 
-    /* Search inside dynamic data */
-    iter = pointer_map.lower_bound(addr - max_offset);
-    while ((iter != pointer_map.end()) && (iter->first <= addr)) {
-        offsets[level] = addr - iter->first;
-        uintptr_t base_address = iter->second;
-        // std::cout << "Found chain with offset " << std::dec << offsets[level] << " and base address " << std::hex << base_address << std::endl;
-        recursiveFind(base_address, level+1, offsets, max_offset);
-        iter++;
+    busy = true;
+    pool.reset();
+    progress = 0;
+
+    std::vector<uintptr_t> addresses;
+    std::atomic<size_t> resolved_count(0);
+    size_t total_count = pointer_chains.size();
+
+    runInBackground([&] {
+        resolvePointerChains(*reader, pointer_chains, pool, addresses, [&] (size_t count) {
+            progress = static_cast<int>(100 * (resolved_count += count) / total_count);
+        });
+    }, [this] {
+        emit signalProgress(progress);
+    });
+
+    /* Keep all chains if the rescan was canceled */
+    if (!pool.canceled()) {
+        beginResetModel();
+        size_t kept = 0;
+        for (size_t i = 0; i < pointer_chains.size(); i++) {
+            if (addresses[i] == addr) {
+                if (kept != i)
+                    pointer_chains[kept] = std::move(pointer_chains[i]);
+                kept++;
+            }
+        }
+        pointer_chains.resize(kept);
+        endResetModel();
     }
+
+    busy = false;
+}
+
+bool PointerScanModel::saveChains(const std::string& path, std::string& error)
+{
+    return savePointerChains(path, pointer_chains, reader->sections(), error);
+}
+
+bool PointerScanModel::loadChains(const std::string& path, std::string& error)
+{
+    std::vector<PointerChain> chains;
+    if (!loadPointerChains(path, reader->sections(), chains, error))
+        return false;
+
+    beginResetModel();
+    pointer_chains = std::move(chains);
+    max_level = 0;
+    for (const PointerChain& chain : pointer_chains)
+        max_level = std::max(max_level, static_cast<int>(chain.second.size()));
+    endResetModel();
+
+    return true;
+}
+
+void PointerScanModel::cancel()
+{
+    pool.cancel();
 }
 
 int PointerScanModel::rowCount(const QModelIndex & /*parent*/) const
@@ -22,19 +22,21 @@
 
 #include <QAbstractTableModel>
 #include <vector>
-#include <map>
 // #include <pair>
 #include <memory>
 #include <sys/types.h>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <atomic>
 
 #include "../Context.h"
-// #include "../ramsearch/IRamWatch.h"
 // #include "../ramsearch/CompareEnums.h"
-// #include "../ramsearch/RamWatch.h"
 #include "../ramsearch/MemSection.h"
+#include "../ramsearch/MemReader.h"
+#include "../ramsearch/PointerIndex.h"
+#include "../ramsearch/PointerChainSearch.h"
+#include "../ramsearch/WorkerPool.h"
 
 class PointerScanModel : public QAbstractTableModel {
     Q_OBJECT
@@ -42,32 +44,68 @@ class PointerScanModel : public QAbstractTableModel {
 public:
     PointerScanModel(Context* c, QObject *parent = Q_NULLPTR);
 
-    /* Map of pointers (key) and addresses (value) */
-    std::multimap<uintptr_t,uintptr_t> pointer_map;
-
-    /* Map of pointers (key) and addresses (value) that are in a static area */
-    std::multimap<uintptr_t,uintptr_t> static_pointer_map;
+    /* Index of pointers, sorted by the address they point to */
+    PointerIndex pointer_index;
 
     /* Results of pointer scan */
-    std::vector<std::pair<uintptr_t, std::vector<int>>> pointer_chains;
+    std::vector<PointerChain> pointer_chains;
 
     /* Max size of pointer chain */
     int max_level = 5;
 
-    /* Store all pointers from the game memory into a map */
+    /* Scan the memory of the savestate of `slot`, or of the running game if
+     * `slot` is negative. Must be called before each operation below, as
+     * the memory is read again by each of them. Returns false and fills
+     * `error` if the savestate cannot be opened. */
+    bool setSource(int slot, std::string& error);
+
+    /* Store all pointers from the scanned memory into the index */
     void locatePointers();
 
     /* Find all chains of pointers that start from a static address and
      * end with the specified address, in maximum `ml` levels and with a maximum
-     * offset of `max_offset`
+     * offset of `max_offset`, up to `max_results` chains. The search runs
+     * in the background, and results are added to the model as they are
+     * found.
      */
-    void findPointerChain(uintptr_t addr, int ml, int max_offset);
+    void findPointerChain(uintptr_t addr, int ml, int max_offset, int max_results);
+
+    /* Follow all chains in the scanned memory, and only keep the ones that
+     * end at `addr`. Rescanning with other savestates keeps the chains that
+     * are valid in all of them. The chains are resolved in the
+     * background. */
+    void rescan(uintptr_t addr);
+
+    /* Save the chains to a file, with base addresses relative to the game
+     * executable or libraries of the scanned memory. Returns false and
+     * fills `error` on failure. */
+    bool saveChains(const std::string& path, std::string& error);
+
+    /* Replace the chains with the ones saved in a file, using the addresses
+     * of the game executable and libraries in the scanned memory. Returns
+     * false and fills `error` on failure. */
+    bool loadChains(const std::string& path, std::string& error);
+
+    /* Stop the current search, keeping the results found so far */
+    void cancel();
+
+    /* A search is running */
+    bool isBusy() const {return busy;}
 
 private:
     Context *context;
 
-    /* Recursive call for the pointer chain search */
-    void recursiveFind(uintptr_t addr, int level, int offsets[], int max_offset);
+    /* Threads used to read the game memory, sort pointers and search chains */
+    WorkerPool pool;
+
+    /* Progress of the current search, updated by the worker threads */
+    std::atomic<int> progress;
+
+    bool busy;
+
+    /* Memory being scanned, and its savestate slot or -1 */
+    std::unique_ptr<MemReader> reader;
+    int source_slot;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
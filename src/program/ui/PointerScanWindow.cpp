@@ -27,6 +27,7 @@
 #include <QHeaderView>
 #include <QMessageBox>
 #include <QSortFilterProxyModel>
+#include <QFileDialog>
 
 #include "PointerScanWindow.h"
 #include "MainWindow.h"
@@ -60,12 +61,20 @@ PointerScanWindow::PointerScanWindow(Context* c, QWidget *parent, Qt::WindowFlag
     searchProgress->setRange(0, 100);
     connect(pointerScanModel, &PointerScanModel::signalProgress, searchProgress, &QProgressBar::setValue);
 
+    cancelButton = new QPushButton(tr("Cancel"));
+    connect(cancelButton, &QAbstractButton::clicked, pointerScanModel, &PointerScanModel::cancel);
+
     scanCount = new QLabel();
     searchProgress->hide();
+    cancelButton->hide();
+
+    QHBoxLayout *progressLayout = new QHBoxLayout;
+    progressLayout->addWidget(searchProgress, 1);
+    progressLayout->addWidget(cancelButton);
 
     QVBoxLayout *scanLayout = new QVBoxLayout;
     scanLayout->addWidget(pointerScanView);
-    scanLayout->addWidget(searchProgress);
+    scanLayout->addLayout(progressLayout);
     scanLayout->addWidget(scanCount);
 
     /* Form */
@@ -77,21 +86,44 @@ PointerScanWindow::PointerScanWindow(Context* c, QWidget *parent, Qt::WindowFlag
     maxOffsetInput = new QSpinBox();
     maxOffsetInput->setMaximum(10000);
     maxOffsetInput->setValue(1000);
+    maxResultsInput = new QSpinBox();
+    maxResultsInput->setRange(1, 10000000);
+    maxResultsInput->setValue(100000);
+
+    /* Scan the running game, or the memory stored in a savestate */
+    sourceBox = new QComboBox();
+    sourceBox->addItem("Game", -1);
+    for (int slot = 0; slot <= 10; slot++)
+        sourceBox->addItem(QString("State %1").arg(slot), slot);
 
     QFormLayout *formLayout = new QFormLayout;
     formLayout->addRow(new QLabel(tr("Address:")), addressInput);
     formLayout->addRow(new QLabel(tr("Max level:")), maxLevelInput);
     formLayout->addRow(new QLabel(tr("Max offset:")), maxOffsetInput);
+    formLayout->addRow(new QLabel(tr("Max results:")), maxResultsInput);
+    formLayout->addRow(new QLabel(tr("Scan in:")), sourceBox);
 
     /* Buttons */
     QPushButton *searchButton = new QPushButton(tr("Search"));
     connect(searchButton, &QAbstractButton::clicked, this, &PointerScanWindow::slotSearch);
 
+    QPushButton *rescanButton = new QPushButton(tr("Rescan"));
+    connect(rescanButton, &QAbstractButton::clicked, this, &PointerScanWindow::slotRescan);
+
+    QPushButton *saveButton = new QPushButton(tr("Save"));
+    connect(saveButton, &QAbstractButton::clicked, this, &PointerScanWindow::slotSave);
+
+    QPushButton *loadButton = new QPushButton(tr("Load"));
+    connect(loadButton, &QAbstractButton::clicked, this, &PointerScanWindow::slotLoad);
+
     QPushButton *addButton = new QPushButton(tr("Add Watch"));
     connect(addButton, &QAbstractButton::clicked, this, &PointerScanWindow::slotAdd);
 
     QDialogButtonBox *buttonBox = new QDialogButtonBox();
     buttonBox->addButton(searchButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(rescanButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(saveButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(loadButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(addButton, QDialogButtonBox::ActionRole);
 
     /* Create the options layout */
@@ -108,24 +140,44 @@ PointerScanWindow::PointerScanWindow(Context* c, QWidget *parent, Qt::WindowFlag
     setLayout(mainLayout);
 }
 
+bool PointerScanWindow::setSource()
+{
+    std::string error;
+    if (!pointerScanModel->setSource(sourceBox->currentData().toInt(), error)) {
+        QMessageBox::critical(nullptr, "Error", QString(error.c_str()));
+        return false;
+    }
+    return true;
+}
+
 void PointerScanWindow::slotSearch()
 {
+    /* The UI is still responsive during a search, don't start another one */
+    if (pointerScanModel->isBusy())
+        return;
+
     bool ok;
     uintptr_t addr = addressInput->text().toULong(&ok, 16);
 
     if (!ok)
         return;
 
+    if (!setSource())
+        return;
+
     int max_level = maxLevelInput->value();
     int max_offset = maxOffsetInput->value();
+    int max_results = maxResultsInput->value();
 
     scanCount->hide();
     searchProgress->show();
+    cancelButton->show();
 
-    pointerScanModel->findPointerChain(addr, max_level, max_offset);
+    pointerScanModel->findPointerChain(addr, max_level, max_offset, max_results);
 
     /* Update address count */
     searchProgress->hide();
+    cancelButton->hide();
     scanCount->show();
     scanCount->setText(QString("%1 results").arg(pointerScanModel->pointer_chains.size()));
 
@@ -135,6 +187,72 @@ void PointerScanWindow::slotSearch()
     }
 }
 
+void PointerScanWindow::slotRescan()
+{
+    if (pointerScanModel->isBusy())
+        return;
+
+    bool ok;
+    uintptr_t addr = addressInput->text().toULong(&ok, 16);
+
+    if (!ok)
+        return;
+
+    if (!setSource())
+        return;
+
+    scanCount->hide();
+    searchProgress->show();
+    cancelButton->show();
+
+    pointerScanModel->rescan(addr);
+
+    searchProgress->hide();
+    cancelButton->hide();
+    scanCount->show();
+    scanCount->setText(QString("%1 results").arg(pointerScanModel->pointer_chains.size()));
+}
+
+void PointerScanWindow::slotSave()
+{
+    if (pointerScanModel->isBusy())
+        return;
+
+    if (!setSource())
+        return;
+
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save pointer scan results"), QString(), tr("Pointer scan files (*.ptr)"));
+    if (filename.isNull())
+        return;
+
+    std::string error;
+    if (!pointerScanModel->saveChains(filename.toStdString(), error))
+        QMessageBox::critical(nullptr, "Error", QString(error.c_str()));
+}
+
+void PointerScanWindow::slotLoad()
+{
+    if (pointerScanModel->isBusy())
+        return;
+
+    if (!setSource())
+        return;
+
+    QString filename = QFileDialog::getOpenFileName(this, tr("Load pointer scan results"), QString(), tr("Pointer scan files (*.ptr)"));
+    if (filename.isNull())
+        return;
+
+    std::string error;
+    if (!pointerScanModel->loadChains(filename.toStdString(), error)) {
+        QMessageBox::critical(nullptr, "Error", QString(error.c_str()));
+        return;
+    }
+
+    maxLevelInput->setValue(pointerScanModel->max_level);
+    scanCount->show();
+    scanCount->setText(QString("%1 results").arg(pointerScanModel->pointer_chains.size()));
+}
+
 void PointerScanWindow::slotAdd()
 {
     const QModelIndex index = pointerScanView->selectionModel()->currentIndex();
@@ -28,6 +28,7 @@
 #include <QComboBox>
 #include <QProgressBar>
 #include <QLabel>
+#include <QPushButton>
 #include <memory>
 
 #include "PointerScanModel.h"
@@ -46,13 +47,23 @@ private:
 
     PointerScanModel *pointerScanModel;
     QProgressBar *searchProgress;
+    QPushButton *cancelButton;
     QLabel *scanCount;
 
     QSpinBox *maxLevelInput;
     QSpinBox *maxOffsetInput;
+    QSpinBox *maxResultsInput;
+    QComboBox *sourceBox;
+
+    /* Set the memory to scan from the source box. Returns false if the
+     * savestate could not be opened. */
+    bool setSource();
 
 private slots:
     void slotSearch();
+    void slotRescan();
+    void slotSave();
+    void slotLoad();
     void slotAdd();
 
 };
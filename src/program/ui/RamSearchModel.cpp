@@ -18,12 +18,17 @@
  */
 
 #include "RamSearchModel.h"
+#include "BackgroundTask.h"
 
-RamSearchModel::RamSearchModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c) {}
+RamSearchModel::RamSearchModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c), progress(0), busy(false) {}
 
 int RamSearchModel::rowCount(const QModelIndex & /*parent*/) const
 {
-   return ramwatches.size();
+    /* Candidates are being modified by other threads */
+    if (busy)
+        return 0;
+
+    return candidates.size();
 }
 
 int RamSearchModel::columnCount(const QModelIndex & /*parent*/) const
@@ -51,14 +56,16 @@ QVariant RamSearchModel::headerData(int section, Qt::Orientation orientation, in
 QVariant RamSearchModel::data(const QModelIndex &index, int role) const
 {
     if (role == Qt::DisplayRole) {
-        const std::unique_ptr<IRamWatch> &watch = ramwatches.at(index.row());
+        int row = index.row();
         switch(index.column()) {
             case 0:
-                return QString("%1").arg(watch->address, 0, 16);
+                return QString("%1").arg(candidates.address(row), 0, 16);
             case 1:
-                return QString(watch->tostring_current(hex));
+                if (!reader)
+                    return QString();
+                return QString(candidates.tostring_current(row, hex, *reader));
             case 2:
-                return QString(watch->tostring(hex));
+                return QString(candidates.tostring(row, hex));
             default:
                 return QString();
         }
@@ -66,38 +73,45 @@ QVariant RamSearchModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
-int RamSearchModel::predictWatchCount(int type_filter)
+bool RamSearchModel::setSource(int slot, std::string& error)
 {
-    /* Compose the filename for the /proc memory map, and open it. */
-    std::ostringstream oss;
-    oss << "/proc/" << context->game_pid << "/maps";
-    std::ifstream mapsfile(oss.str());
-    if (!mapsfile) {
-        std::cerr << "Could not open " << oss.str() << std::endl;
-        return 0;
-    }
+    std::unique_ptr<MemReader> source = openMemReader(context, slot, error);
+    if (!source)
+        return false;
 
-    std::string line;
-    MemSection::reset();
+    reader = std::move(source);
+    return true;
+}
 
-    int total_size = 0;
-    while (std::getline(mapsfile, line)) {
-        MemSection section;
-        section.readMap(line);
+std::vector<MemSection> RamSearchModel::readSections(int type_filter)
+{
+    std::vector<MemSection> sections;
+    if (!reader)
+        return sections;
 
+    for (const MemSection& section : reader->sections()) {
         /* Filter based on type */
         if (!(type_filter & section.type))
             continue;
 
-        total_size += section.size;
+        sections.push_back(section);
     }
 
+    return sections;
+}
+
+int RamSearchModel::predictWatchCount(int type_filter)
+{
+    int total_size = 0;
+    for (const auto& section : readSections(type_filter))
+        total_size += section.size;
+
     return total_size;
 }
 
 int RamSearchModel::watchCount()
 {
-    return ramwatches.size();
+    return candidates.size();
 }
 
 void RamSearchModel::searchWatches(CompareType ct, CompareOperator co, double cv)
@@ -107,21 +121,36 @@ void RamSearchModel::searchWatches(CompareType ct, CompareOperator co, double cv
     compare_value = cv;
 
     beginResetModel();
+    busy = true;
+    endResetModel();
 
-    int count = 0;
-    ramwatches.erase(
-        std::remove_if(ramwatches.begin(), ramwatches.end(),
-            [this, &count] (std::unique_ptr<IRamWatch> &watch) {
-                if (!(count++ & 0xfff)) {
-                    emit signalProgress(count);
-                }
-                return watch->check_update(compare_type, compare_operator, compare_value);
-            }),
-        ramwatches.end());
+    runInBackground([this] {
+        candidates.search(*reader, compare_type, compare_operator, compare_value, pool, [this] (size_t count) {
+            progress += count;
+        });
+    });
 
+    beginResetModel();
+    busy = false;
     endResetModel();
 }
 
+void RamSearchModel::cancel()
+{
+    pool.cancel();
+}
+
+void RamSearchModel::runInBackground(const std::function<void()>& work)
+{
+    pool.reset();
+    progress = 0;
+
+    /* Report progress periodically */
+    ::runInBackground(work, [this] {
+        emit signalProgress(progress);
+    });
+}
+
 void RamSearchModel::update()
 {
     emit dataChanged(createIndex(0,1), createIndex(rowCount(),1));
@@ -24,15 +24,24 @@
 #include <vector>
 #include <memory>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <atomic>
+#include <functional>
+#include <utility>
 
 #include "../Context.h"
-#include "../ramsearch/IRamWatch.h"
 #include "../ramsearch/CompareEnums.h"
-#include "../ramsearch/RamWatch.h"
+#include "../ramsearch/CompareKernels.h"
+#include "../ramsearch/RamCandidates.h"
 #include "../ramsearch/MemSection.h"
+#include "../ramsearch/MemReader.h"
+#include "../ramsearch/SaveStateDiff.h"
+#include "../ramsearch/WorkerPool.h"
 
 class RamSearchModel : public QAbstractTableModel {
     Q_OBJECT
@@ -42,8 +51,13 @@ public:
 
     void update();
 
-    /* List of watches */
-    std::vector<std::unique_ptr<IRamWatch>> ramwatches;
+    /* Search the memory of the savestate of `slot`, or of the running game
+     * if `slot` is negative. The memory is read again by each operation.
+     * Returns false and fills `error` if the savestate cannot be opened. */
+    bool setSource(int slot, std::string& error);
+
+    /* Candidate addresses */
+    RamCandidates candidates;
 
     /* Flag if we display values in hex or decimal */
     bool hex;
@@ -63,89 +77,121 @@ public:
         compare_value = cv;
 
         beginResetModel();
+        candidates.reset<T>();
+        busy = true;
+        endResetModel();
 
-        ramwatches.clear();
-        ramwatches.reserve(0);
-
-        IRamWatch::game_pid = context->game_pid;
-
-        /* Compose the filename for the /proc memory map, and open it. */
-        std::ostringstream oss;
-        oss << "/proc/" << context->game_pid << "/maps";
-        std::ifstream mapsfile(oss.str());
-        if (!mapsfile) {
-            std::cerr << "Could not open " << oss.str() << std::endl;
-            return;
+        std::vector<MemSection> sections = readSections(type_filter);
+
+        /* Split sections into tasks of at most CHUNK_SIZE bytes, so that
+         * each task reads its values with one call to the reader, in most
+         * cases. */
+        static const size_t CHUNK_SIZE = 1024*1024;
+        std::vector<std::pair<uintptr_t, uintptr_t>> tasks;
+        for (const auto& section : sections) {
+            for (uintptr_t addr = section.addr; addr < section.endaddr; addr += CHUNK_SIZE) {
+                uintptr_t endaddr = section.endaddr - addr > CHUNK_SIZE ? addr + CHUNK_SIZE : section.endaddr;
+                tasks.emplace_back(addr, endaddr);
+            }
         }
 
-        std::string line;
-        MemSection::reset();
+        /* Each thread reads in its own buffers, and each task stores its
+         * candidates separately, so that they are merged in address order */
+        std::vector<std::vector<T>> chunks(pool.threadCount());
+        std::vector<std::vector<uint64_t>> matches(pool.threadCount());
+        std::vector<RamCandidates> results(tasks.size());
 
-        int cur_size = 0;
-        while (std::getline(mapsfile, line)) {
+        runInBackground([&] {
+            pool.run(tasks.size(), [&] (size_t task, int thread) {
+                std::vector<T>& chunk = chunks[thread];
+                chunk.resize(CHUNK_SIZE/sizeof(T));
+                matches[thread].resize(CHUNK_SIZE/sizeof(T)/64);
 
-            MemSection section;
-            section.readMap(line);
+                RamCandidates& task_candidates = results[task];
+                task_candidates.reset<T>();
 
-            /* Filter based on type */
-            if (!(type_filter & section.type))
-                continue;
+                /* For now we only store aligned addresses */
+                for (uintptr_t addr = tasks[task].first; addr < tasks[task].second; ) {
 
-            /* Reserve the vector space so we avoid multiple reallocations */
-            ramwatches.reserve(ramwatches.size() + section.size/sizeof(T));
+                    size_t size = tasks[task].second - addr;
+                    size_t readValues = reader->read(addr, chunk.data(), size);
 
-            /* For now we only store aligned addresses */
-            std::unique_ptr<RamWatch<T>> watch(nullptr);
+                    /* Only keep whole pages, and skip the page that could not
+                     * be read, if any */
+                    readValues -= readValues % 4096;
+                    uintptr_t next_addr = addr + readValues;
+                    if (readValues < size)
+                        next_addr += 4096;
 
-            struct iovec local, remote;
+                    int count = readValues/sizeof(T);
+                    progress += next_addr - addr;
 
-            for (uintptr_t addr = section.addr; addr < section.endaddr; addr += 4096) {
+                    /* If only insert watches that match the compare */
+                    if (compare_type == CompareType::Value) {
+                        compareValues(chunk.data(), static_cast<T*>(nullptr), static_cast<T>(compare_value), count, compare_type, compare_operator, matches[thread].data());
+                        task_candidates.addMatches(addr, chunk.data(), count, matches[thread].data());
+                    }
 
-                /* Read values in chunks of 4096 bytes so we lower the number
-                 * of `process_vm_readv` calls.
-                 */
-                T chunk[4096/sizeof(T)];
-                local.iov_base = static_cast<void*>(chunk);
-                local.iov_len = 4096;
-                remote.iov_base = reinterpret_cast<void*>(addr);
-                remote.iov_len = 4096;
+                    /* Insert all watches as a region, which does not store
+                     * addresses, still checking for non NaN/Inf values */
+                    else if (count > 0) {
+                        task_candidates.addRegion(addr, chunk.data(), count);
+                    }
 
-                int readValues = process_vm_readv(context->game_pid, &local, 1, &remote, 1, 0);
-                if (readValues < 0) {
-                    continue;
+                    addr = next_addr;
                 }
+            });
+        });
 
-                for (unsigned int i = 0; i < readValues/sizeof(T); i++, cur_size += sizeof(T)) {
+        beginResetModel();
+        if (!pool.canceled())
+            candidates.merge(results);
+        busy = false;
+        endResetModel();
+    }
 
-                    if (!(cur_size & 0xfff)) {
-                        emit signalProgress(cur_size);
-                    }
+    /* Create watches from the values that differ between two savestates.
+     * Values of the second savestate are compared to values of the first
+     * savestate or to a specific value, and become the previous values. */
+    template <class T>
+    void newWatchesFromDiff(SaveStateDiff& diff, int type_filter, CompareType ct, CompareOperator co, double cv)
+    {
+        compare_type = ct;
+        compare_operator = co;
+        compare_value = cv;
+
+        beginResetModel();
+        candidates.reset<T>();
+        busy = true;
+        endResetModel();
 
-                    if (! watch)
-                        watch = std::unique_ptr<RamWatch<T>>(new RamWatch<T>(addr+i*sizeof(T)));
-                    else
-                        /* Reusing a watch object that wasn't inserted */
-                        watch->address = addr+i*sizeof(T);
+        RamCandidates diff_candidates;
+        diff_candidates.reset<T>();
 
-                    watch->previous_value = chunk[i];
+        runInBackground([&] {
+            diff.diffPages(type_filter, [&](uintptr_t addr, const char* first_page, const char* second_page) {
+                /* Pages are processed in a single thread, so only skip the
+                 * remaining pages */
+                if (pool.canceled())
+                    return;
 
-                    /* If only insert watches that match the compare */
-                    if (compare_type == CompareType::Value) {
-                        if (!watch->check(chunk[i], compare_type, compare_operator, compare_value)) {
-                            ramwatches.push_back(std::move(watch));
-                        }
-                    }
+                T first_chunk[4096/sizeof(T)];
+                T second_chunk[4096/sizeof(T)];
+                uint64_t matches[(4096/sizeof(T)+63)/64];
+                memcpy(first_chunk, first_page, 4096);
+                memcpy(second_chunk, second_page, 4096);
 
-                    /* Insert all watches, still checking for non NaN/Inf values */
-                    else {
-                        if (std::isfinite(chunk[i])) {
-                            ramwatches.push_back(std::move(watch));
-                        }
-                    }
-                }
-            }
-        }
+                progress++;
+
+                compareValues(second_chunk, first_chunk, static_cast<T>(compare_value), 4096/sizeof(T), compare_type, compare_operator, matches);
+                diff_candidates.addMatches(addr, second_chunk, 4096/sizeof(T), matches);
+            });
+        });
 
+        beginResetModel();
+        if (!pool.canceled())
+            std::swap(candidates, diff_candidates);
+        busy = false;
         endResetModel();
     }
 
@@ -153,9 +199,34 @@ public:
     int watchCount();
     void searchWatches(CompareType ct, CompareOperator co, double cv);
 
+    /* Stop the current operation. Candidates are left empty if they were
+     * being created, and unchanged if they were being searched. */
+    void cancel();
+
+    /* An operation is running, and candidates are hidden */
+    bool isBusy() const {return busy;}
+
 private:
     Context *context;
 
+    /* Memory being searched */
+    std::unique_ptr<MemReader> reader;
+
+    /* Threads used to search the game memory */
+    WorkerPool pool;
+
+    /* Progress of the current operation, updated by the worker threads */
+    std::atomic<int> progress;
+
+    bool busy;
+
+    /* Get the sections of the searched memory matching the type filter */
+    std::vector<MemSection> readSections(int type_filter);
+
+    /* Run `work` in a separate thread, while processing the events of the
+     * UI and reporting progress, and return when it is done */
+    void runInBackground(const std::function<void()>& work);
+
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -52,13 +52,21 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     searchProgress = new QProgressBar();
     connect(ramSearchModel, &RamSearchModel::signalProgress, searchProgress, &QProgressBar::setValue);
 
+    cancelButton = new QPushButton(tr("Cancel"));
+    connect(cancelButton, &QAbstractButton::clicked, ramSearchModel, &RamSearchModel::cancel);
+
     watchCount = new QLabel();
     // watchCount->setHeight(searchProgress->height());
     searchProgress->hide();
+    cancelButton->hide();
+
+    QHBoxLayout *progressLayout = new QHBoxLayout;
+    progressLayout->addWidget(searchProgress, 1);
+    progressLayout->addWidget(cancelButton);
 
     QVBoxLayout *watchLayout = new QVBoxLayout;
     watchLayout->addWidget(ramSearchView);
-    watchLayout->addWidget(searchProgress);
+    watchLayout->addLayout(progressLayout);
     watchLayout->addWidget(watchCount);
 
 
@@ -87,6 +95,16 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     memLayout->addWidget(memStackBox, 3, 1);
     memLayout->addWidget(memSpecialBox, 4, 1);
 
+    /* Search the running game, or the memory stored in a savestate */
+    sourceBox = new QComboBox();
+    sourceBox->addItem("Game", -1);
+    for (int slot = 0; slot <= 10; slot++)
+        sourceBox->addItem(QString("State %1").arg(slot), slot);
+
+    QFormLayout *sourceLayout = new QFormLayout;
+    sourceLayout->addRow(new QLabel(tr("Search in:")), sourceBox);
+    memLayout->addLayout(sourceLayout, 5, 0, 1, 2);
+
     memGroupBox->setLayout(memLayout);
 
     /* Comparisons */
@@ -140,6 +158,24 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     formatLayout->addRow(new QLabel(tr("Display:")), displayBox);
     formatGroupBox->setLayout(formatLayout);
 
+    /* Savestates */
+    firstStateBox = new QSpinBox();
+    firstStateBox->setRange(0, 10);
+    firstStateBox->setValue(1);
+    secondStateBox = new QSpinBox();
+    secondStateBox->setRange(0, 10);
+    secondStateBox->setValue(2);
+
+    QPushButton *diffButton = new QPushButton(tr("Diff States"));
+    connect(diffButton, &QAbstractButton::clicked, this, &RamSearchWindow::slotDiff);
+
+    QGroupBox *stateGroupBox = new QGroupBox(tr("Compare Savestates"));
+    QFormLayout *stateLayout = new QFormLayout;
+    stateLayout->addRow(new QLabel(tr("From state:")), firstStateBox);
+    stateLayout->addRow(new QLabel(tr("To state:")), secondStateBox);
+    stateLayout->addRow(diffButton);
+    stateGroupBox->setLayout(stateLayout);
+
     /* Buttons */
     QPushButton *newButton = new QPushButton(tr("New"));
     connect(newButton, &QAbstractButton::clicked, this, &RamSearchWindow::slotNew);
@@ -161,6 +197,7 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     optionLayout->addWidget(compareGroupBox);
     optionLayout->addWidget(operatorGroupBox);
     optionLayout->addWidget(formatGroupBox);
+    optionLayout->addWidget(stateGroupBox);
     optionLayout->addStretch(1);
     optionLayout->addWidget(buttonBox);
 
@@ -177,6 +214,42 @@ void RamSearchWindow::update()
     ramSearchModel->update();
 }
 
+int RamSearchWindow::getMemRegions()
+{
+    int memregions = 0;
+    if (memTextBox->isChecked())
+        memregions |= MemSection::MemText;
+    if (memDataROBox->isChecked())
+        memregions |= MemSection::MemDataRO;
+    if (memDataRWBox->isChecked())
+        memregions |= MemSection::MemDataRW;
+    if (memBSSBox->isChecked())
+        memregions |= MemSection::MemBSS;
+    if (memHeapBox->isChecked())
+        memregions |= MemSection::MemHeap;
+    if (memFileMappingBox->isChecked())
+        memregions |= MemSection::MemFileMapping;
+    if (memAnonymousMappingROBox->isChecked())
+        memregions |= MemSection::MemAnonymousMappingRO;
+    if (memAnonymousMappingRWBox->isChecked())
+        memregions |= MemSection::MemAnonymousMappingRW;
+    if (memStackBox->isChecked())
+        memregions |= MemSection::MemStack;
+    if (memSpecialBox->isChecked())
+        memregions |= MemSection::MemSpecial;
+    return memregions;
+}
+
+bool RamSearchWindow::setSource()
+{
+    std::string error;
+    if (!ramSearchModel->setSource(sourceBox->currentData().toInt(), error)) {
+        QMessageBox::critical(nullptr, "Error", QString(error.c_str()));
+        return false;
+    }
+    return true;
+}
+
 void RamSearchWindow::getCompareParameters(CompareType& compare_type, CompareOperator& compare_operator, double& compare_value)
 {
     compare_type = CompareType::Previous;
@@ -203,28 +276,15 @@ void RamSearchWindow::slotNew()
     if (context->status != Context::ACTIVE)
         return;
 
+    /* The UI is still responsive during a search, don't start another one */
+    if (ramSearchModel->isBusy())
+        return;
+
+    if (!setSource())
+        return;
+
     /* Build the memory region flag variable */
-    int memregions = 0;
-    if (memTextBox->isChecked())
-        memregions |= MemSection::MemText;
-    if (memDataROBox->isChecked())
-        memregions |= MemSection::MemDataRO;
-    if (memDataRWBox->isChecked())
-        memregions |= MemSection::MemDataRW;
-    if (memBSSBox->isChecked())
-        memregions |= MemSection::MemBSS;
-    if (memHeapBox->isChecked())
-        memregions |= MemSection::MemHeap;
-    if (memFileMappingBox->isChecked())
-        memregions |= MemSection::MemFileMapping;
-    if (memAnonymousMappingROBox->isChecked())
-        memregions |= MemSection::MemAnonymousMappingRO;
-    if (memAnonymousMappingRWBox->isChecked())
-        memregions |= MemSection::MemAnonymousMappingRW;
-    if (memStackBox->isChecked())
-        memregions |= MemSection::MemStack;
-    if (memSpecialBox->isChecked())
-        memregions |= MemSection::MemSpecial;
+    int memregions = getMemRegions();
 
     /* Get the comparison parameters */
     CompareType compare_type;
@@ -236,6 +296,7 @@ void RamSearchWindow::slotNew()
 
     watchCount->hide();
     searchProgress->show();
+    cancelButton->show();
     searchProgress->setMaximum(ramSearchModel->predictWatchCount(memregions));
 
     /* Call the RamSearch new function using the right type as template */
@@ -273,6 +334,7 @@ void RamSearchWindow::slotNew()
     }
 
     searchProgress->hide();
+    cancelButton->hide();
     watchCount->show();
 
     /* Update address count */
@@ -281,6 +343,12 @@ void RamSearchWindow::slotNew()
 
 void RamSearchWindow::slotSearch()
 {
+    if (ramSearchModel->isBusy())
+        return;
+
+    if (!setSource())
+        return;
+
     CompareType compare_type;
     CompareOperator compare_operator;
     double compare_value;
@@ -289,16 +357,92 @@ void RamSearchWindow::slotSearch()
     searchProgress->setMaximum(ramSearchModel->watchCount());
     watchCount->hide();
     searchProgress->show();
+    cancelButton->show();
 
     ramSearchModel->searchWatches(compare_type, compare_operator, compare_value);
 
     /* Update address count */
     searchProgress->hide();
+    cancelButton->hide();
     watchCount->show();
     watchCount->setText(QString("%1 addresses").arg(ramSearchModel->watchCount()));
 
 }
 
+void RamSearchWindow::slotDiff()
+{
+    if (context->status != Context::ACTIVE)
+        return;
+
+    if (ramSearchModel->isBusy())
+        return;
+
+    SaveStateDiff diff(context);
+    std::string error;
+    if (!diff.open(firstStateBox->value(), secondStateBox->value(), error)) {
+        QMessageBox::critical(nullptr, "Error", QString(error.c_str()));
+        return;
+    }
+
+    int memregions = getMemRegions();
+
+    /* Get the comparison parameters */
+    CompareType compare_type;
+    CompareOperator compare_operator;
+    double compare_value;
+    getCompareParameters(compare_type, compare_operator, compare_value);
+
+    ramSearchModel->hex = (displayBox->currentIndex() == 1);
+
+    /* Progress is counted in pages that differ, which are at most all
+     * pages of the second savestate */
+    watchCount->hide();
+    searchProgress->show();
+    cancelButton->show();
+    searchProgress->setMaximum(diff.pageCount(memregions));
+
+    /* Call the RamSearch diff function using the right type as template */
+    switch (typeBox->currentIndex()) {
+        case 0:
+            ramSearchModel->newWatchesFromDiff<unsigned char>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 1:
+            ramSearchModel->newWatchesFromDiff<char>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 2:
+            ramSearchModel->newWatchesFromDiff<unsigned short>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 3:
+            ramSearchModel->newWatchesFromDiff<short>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 4:
+            ramSearchModel->newWatchesFromDiff<unsigned int>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 5:
+            ramSearchModel->newWatchesFromDiff<int>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 6:
+            ramSearchModel->newWatchesFromDiff<uint64_t>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 7:
+            ramSearchModel->newWatchesFromDiff<int64_t>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 8:
+            ramSearchModel->newWatchesFromDiff<float>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+        case 9:
+            ramSearchModel->newWatchesFromDiff<double>(diff, memregions, compare_type, compare_operator, compare_value);
+            break;
+    }
+
+    searchProgress->hide();
+    cancelButton->hide();
+    watchCount->show();
+
+    /* Update address count */
+    watchCount->setText(QString("%1 addresses").arg(ramSearchModel->watchCount()));
+}
+
 void RamSearchWindow::slotAdd()
 {
     const QModelIndex index = ramSearchView->selectionModel()->currentIndex();
@@ -316,7 +460,7 @@ void RamSearchWindow::slotAdd()
 
     MainWindow *mw = qobject_cast<MainWindow*>(parent());
     if (mw) {
-        mw->ramWatchWindow->editWindow->fill(ramSearchModel->ramwatches.at(row));
+        mw->ramWatchWindow->editWindow->fill(ramSearchModel->candidates.address(row), ramSearchModel->candidates.type());
         mw->ramWatchWindow->slotAdd();
     }
 }
@@ -28,6 +28,8 @@
 #include <QComboBox>
 #include <QProgressBar>
 #include <QLabel>
+#include <QSpinBox>
+#include <QPushButton>
 #include <memory>
 
 #include "RamSearchModel.h"
@@ -47,6 +49,7 @@ private:
 
     RamSearchModel *ramSearchModel;
     QProgressBar *searchProgress;
+    QPushButton *cancelButton;
     QLabel *watchCount;
 
     QCheckBox *memTextBox;
@@ -74,11 +77,23 @@ private:
     QComboBox *typeBox;
     QComboBox *displayBox;
 
+    QSpinBox *firstStateBox;
+    QSpinBox *secondStateBox;
+
+    QComboBox *sourceBox;
+
+    int getMemRegions();
+
+    /* Set the memory to search from the source box. Returns false if the
+     * savestate could not be opened. */
+    bool setSource();
+
     void getCompareParameters(CompareType& compare_type, CompareOperator& compare_operator, double& compare_value);
 
 private slots:
     void slotNew();
     void slotSearch();
+    void slotDiff();
     void slotAdd();
 
 };
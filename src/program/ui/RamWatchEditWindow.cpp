@@ -124,12 +124,15 @@ void RamWatchEditWindow::clear()
 
 void RamWatchEditWindow::fill(std::unique_ptr<IRamWatchDetailed> &watch)
 {
+    /* Reading the value first updates the address of pointer watches */
+    std::string value = watch->value_str();
+
     /* Fill address */
     addressInput->setText(QString("%1").arg(watch->address, 0, 16));
     addressInput->setEnabled(!watch->isPointer);
 
     /* Fill value */
-    valueInput->setText(watch->value_str().c_str());
+    valueInput->setText(value.c_str());
 
     /* Fill label */
     labelInput->setText(watch->label.c_str());
@@ -167,15 +170,15 @@ void RamWatchEditWindow::fill(std::unique_ptr<IRamWatchDetailed> &watch)
     }
 }
 
-void RamWatchEditWindow::fill(std::unique_ptr<IRamWatch> &watch)
+void RamWatchEditWindow::fill(uintptr_t address, int type)
 {
     clear();
 
     /* Fill address */
-    addressInput->setText(QString("%1").arg(watch->address, 0, 16));
+    addressInput->setText(QString("%1").arg(address, 0, 16));
 
-    /* Fill type using virtual function */
-    typeBox->setCurrentIndex(watch->type());
+    /* Fill type from its index */
+    typeBox->setCurrentIndex(type);
 }
 
 void RamWatchEditWindow::slotPointer(bool checked)
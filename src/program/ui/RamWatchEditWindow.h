@@ -28,8 +28,8 @@
 #include <QCheckBox>
 #include <QDialogButtonBox>
 #include <memory> // std::unique_ptr
+#include <cstdint>
 
-#include "../ramsearch/IRamWatch.h"
 #include "../ramsearch/IRamWatchDetailed.h"
 
 class RamWatchEditWindow : public QDialog {
@@ -40,7 +40,7 @@ public:
 
     void clear();
     void fill(std::unique_ptr<IRamWatchDetailed> &watch);
-    void fill(std::unique_ptr<IRamWatch> &watch);
+    void fill(uintptr_t address, int type);
 
     std::unique_ptr<IRamWatchDetailed> ramwatch;
 
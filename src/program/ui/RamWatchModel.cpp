@@ -18,6 +18,7 @@
  */
 
 #include "RamWatchModel.h"
+#include "../ramsearch/RamWatchBatch.h"
 
 RamWatchModel::RamWatchModel(QObject *parent) : QAbstractTableModel(parent) {}
 
@@ -52,13 +53,18 @@ QVariant RamWatchModel::data(const QModelIndex &index, int role) const
 {
     if (role == Qt::DisplayRole) {
         const std::unique_ptr<IRamWatchDetailed> &watch = ramwatches.at(index.row());
+
+        /* Watches added since the last update are read separately */
+        bool updated = static_cast<size_t>(index.row()) < values.size();
         switch(index.column()) {
             case 0:
                 if (watch->isPointer)
-                    return QString("P->%1").arg(watch->address, 0, 16);
+                    return QString("P->%1").arg(updated ? addresses[index.row()] : watch->address, 0, 16);
                 else
                     return QString("%1").arg(watch->address, 0, 16);
             case 1:
+                if (updated)
+                    return QString(values[index.row()].c_str());
                 return QString(watch->value_str().c_str());
             case 2:
                 return QString(watch->label.c_str());
@@ -80,11 +86,17 @@ void RamWatchModel::removeWatch(int row)
 {
     beginRemoveRows(QModelIndex(), row, row);
     ramwatches.erase(ramwatches.begin() + row);
+    if (static_cast<size_t>(row) < values.size()) {
+        values.erase(values.begin() + row);
+        addresses.erase(addresses.begin() + row);
+    }
     endRemoveRows();
 }
 
 
-void RamWatchModel::update()
+void RamWatchModel::update(const MemReader& reader)
 {
+    readRamWatches(reader, ramwatches, addresses, values);
+
     emit dataChanged(createIndex(0,0), createIndex(rowCount(),1));
 }
@@ -25,6 +25,7 @@
 #include <memory>
 
 #include "../ramsearch/IRamWatchDetailed.h"
+#include "../ramsearch/MemReader.h"
 
 class RamWatchModel : public QAbstractTableModel {
     Q_OBJECT
@@ -46,7 +47,14 @@ public:
     void addWatch(std::unique_ptr<IRamWatchDetailed> ramwatch);
     void removeWatch(int row);
 
-    void update();
+    /* Read the values of all watches at once from `reader`, and refresh
+     * the table */
+    void update(const MemReader& reader);
+
+private:
+    /* Values and addresses of the watches read by the last update */
+    std::vector<std::string> values;
+    std::vector<uintptr_t> addresses;
 };
 
 #endif
@@ -24,6 +24,7 @@
 #include <QHeaderView>
 
 #include "RamWatchWindow.h"
+#include "../ramsearch/RamWatchBatch.h"
 
 RamWatchWindow::RamWatchWindow(Context* c, QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags), context(c)
 {
@@ -76,7 +77,9 @@ RamWatchWindow::RamWatchWindow(Context* c, QWidget *parent, Qt::WindowFlags flag
 void RamWatchWindow::update()
 {
     IRamWatchDetailed::game_pid = context->game_pid;
-    ramWatchModel->update();
+
+    ProcessMemReader reader(context->game_pid);
+    ramWatchModel->update(reader);
 }
 
 void RamWatchWindow::slotAdd()
@@ -93,16 +96,22 @@ void RamWatchWindow::slotGet(std::string &watch)
 {
     static unsigned int index = 0;
 
-    if (index >= ramWatchModel->ramwatches.size()) {
+    /* Read all watches at once when the first one is asked */
+    if (index == 0) {
+        ProcessMemReader reader(context->game_pid);
+        readRamWatches(reader, ramWatchModel->ramwatches, watch_addresses, watch_values);
+        for (size_t w = 0; w < watch_values.size(); w++)
+            watch_values[w] = ramWatchModel->ramwatches[w]->label + ": " + watch_values[w];
+    }
+
+    if (index >= watch_values.size()) {
         /* We sent all watches, returning NULL */
         watch = "";
         index = 0;
         return;
     }
 
-    watch = ramWatchModel->ramwatches[index]->label;
-    watch += ": ";
-    watch += ramWatchModel->ramwatches[index]->value_str();
+    watch = watch_values[index];
 
     index++;
 }
@@ -22,6 +22,8 @@
 
 #include <QDialog>
 #include <QTableView>
+#include <vector>
+#include <string>
 
 #include "RamWatchModel.h"
 #include "RamWatchEditWindow.h"
@@ -44,6 +46,11 @@ private:
     QTableView *ramWatchView;
     RamWatchModel *ramWatchModel;
 
+    /* Labels and values of the watches sent to the game, read all at once
+     * each frame */
+    std::vector<std::string> watch_values;
+    std::vector<uintptr_t> watch_addresses;
+
 public slots:
     void slotAdd();
     void slotGet(std::string &watch);
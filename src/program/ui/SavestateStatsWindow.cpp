@@ -0,0 +1,144 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QPushButton>
+#include <QDialogButtonBox>
+#include <QVBoxLayout>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <fstream>
+
+#include "SavestateStatsWindow.h"
+#include "MainWindow.h"
+
+static const char* const columnNames[] = {"Operation", "Slot", "Total (ms)",
+    "Suspend (ms)", "Maps (ms)", "Pagemap (ms)", "Scan (ms)", "Write (ms)",
+    "Restore (ms)", "Resume (ms)", "No pages", "Zero pages", "Base pages",
+    "Full pages", "Parent pages", "Unmodified pages", "Size (kB)"};
+
+static const int columnCount = sizeof(columnNames) / sizeof(columnNames[0]);
+
+SavestateStatsWindow::SavestateStatsWindow(QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags)
+{
+    setWindowTitle("Savestate statistics");
+
+    /* Table */
+    statsTable = new QTableWidget(0, columnCount, this);
+    QStringList header;
+    for (int c = 0; c < columnCount; c++)
+        header << columnNames[c];
+    statsTable->setHorizontalHeaderLabels(header);
+    statsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    statsTable->setShowGrid(false);
+    statsTable->setAlternatingRowColors(true);
+    statsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    statsTable->horizontalHeader()->setHighlightSections(false);
+    statsTable->verticalHeader()->hide();
+    statsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    /* Buttons */
+    QPushButton *clearButton = new QPushButton(tr("Clear"));
+    connect(clearButton, &QAbstractButton::clicked, this, &SavestateStatsWindow::slotClear);
+
+    QPushButton *exportButton = new QPushButton(tr("Export CSV..."));
+    connect(exportButton, &QAbstractButton::clicked, this, &SavestateStatsWindow::slotExport);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox();
+    buttonBox->addButton(clearButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(exportButton, QDialogButtonBox::ActionRole);
+
+    /* Create the main layout */
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+
+    mainLayout->addWidget(statsTable);
+    mainLayout->addWidget(buttonBox);
+
+    setLayout(mainLayout);
+
+    qRegisterMetaType<SavestateStats>("SavestateStats");
+
+    /* We need connections to the game loop, so we access it through our parent */
+    MainWindow *mw = qobject_cast<MainWindow*>(parent);
+    if (mw) {
+        connect(mw->gameLoop, &GameLoop::savestateStatsReceived, this, &SavestateStatsWindow::update);
+    }
+}
+
+void SavestateStatsWindow::update(SavestateStats stats)
+{
+    stats_list.push_back(stats);
+
+    int r = statsTable->rowCount();
+    statsTable->insertRow(r);
+
+    QStringList values;
+    values << ((stats.operation == SavestateStats::SAVE) ? "Save" : "Load");
+    values << QString::number(stats.index);
+    for (double time : {stats.total_time, stats.suspend_time, stats.maps_time,
+        stats.pagemap_time, stats.scan_time, stats.write_time,
+        stats.restore_time, stats.resume_time})
+        values << QString::number(time * 1000, 'f', 2);
+    for (uint64_t count : {stats.no_pages, stats.zero_pages, stats.base_pages,
+        stats.full_pages, stats.parent_pages, stats.unmodified_pages})
+        values << QString::number(count);
+    values << QString::number(stats.size / 1024);
+
+    for (int c = 0; c < columnCount; c++)
+        statsTable->setItem(r, c, new QTableWidgetItem(values[c]));
+
+    statsTable->scrollToBottom();
+}
+
+void SavestateStatsWindow::slotClear()
+{
+    stats_list.clear();
+    statsTable->setRowCount(0);
+}
+
+void SavestateStatsWindow::slotExport()
+{
+    QString filename = QFileDialog::getSaveFileName(this, tr("Export savestate statistics"), "", tr("CSV files (*.csv)"));
+    if (filename.isNull())
+        return;
+
+    std::ofstream file(filename.toStdString());
+    if (!file) {
+        QMessageBox::warning(this, "Error", QString("Could not open file %1").arg(filename));
+        return;
+    }
+
+    /* Export raw values, with times in seconds and size in bytes */
+    file << "operation,slot,total_time,suspend_time,maps_time,pagemap_time,"
+        "scan_time,write_time,restore_time,resume_time,no_pages,zero_pages,"
+        "base_pages,full_pages,parent_pages,unmodified_pages,size\n";
+
+    for (const SavestateStats &stats : stats_list) {
+        file << ((stats.operation == SavestateStats::SAVE) ? "save" : "load") << ',';
+        file << stats.index << ',';
+        file << stats.total_time << ',' << stats.suspend_time << ',';
+        file << stats.maps_time << ',' << stats.pagemap_time << ',';
+        file << stats.scan_time << ',' << stats.write_time << ',';
+        file << stats.restore_time << ',' << stats.resume_time << ',';
+        file << stats.no_pages << ',' << stats.zero_pages << ',';
+        file << stats.base_pages << ',' << stats.full_pages << ',';
+        file << stats.parent_pages << ',' << stats.unmodified_pages << ',';
+        file << stats.size << '\n';
+    }
+}
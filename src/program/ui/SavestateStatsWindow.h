@@ -0,0 +1,49 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SAVESTATESTATSWINDOW_H_INCLUDED
+#define LIBTAS_SAVESTATESTATSWINDOW_H_INCLUDED
+
+#include <QDialog>
+#include <QTableWidget>
+#include <vector>
+
+#include "../../shared/SavestateStats.h"
+
+class SavestateStatsWindow : public QDialog {
+    Q_OBJECT
+public:
+    SavestateStatsWindow(QWidget *parent = Q_NULLPTR, Qt::WindowFlags flags = 0);
+
+private:
+    QTableWidget *statsTable;
+
+    /* All received statistics, in order */
+    std::vector<SavestateStats> stats_list;
+
+public slots:
+    /* Append the statistics of a savestate or state loading */
+    void update(SavestateStats stats);
+
+private slots:
+    void slotClear();
+    void slotExport();
+};
+
+#endif
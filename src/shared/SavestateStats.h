@@ -0,0 +1,65 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SAVESTATESTATS_H_INCLUDED
+#define LIBTAS_SAVESTATESTATS_H_INCLUDED
+
+#include <cstdint>
+
+/*
+ * Structure that holds statistics about the last savestate or state loading,
+ * gathered by the game and sent to the program, so that settings can be
+ * tuned for each game.
+ */
+struct SavestateStats {
+    enum Operation {
+        SAVE,
+        LOAD,
+    };
+
+    int operation = SAVE;
+
+    /* Index of the savestate slot */
+    int index = 0;
+
+    /* Time spent in each phase, in seconds. Phases that don't apply to the
+     * operation have a zero time */
+    double suspend_time = 0; // suspending all other threads
+    double maps_time = 0; // parsing /proc/self/maps
+    double pagemap_time = 0; // reading /proc/self/pagemap
+    double scan_time = 0; // checking for zero pages and hashing pages
+    double write_time = 0; // compressing and writing pages, and other work of writers
+    double restore_time = 0; // restoring memory from the savestate
+    double resume_time = 0; // resuming all other threads
+    double total_time = 0;
+
+    /* Number of pages of the savestate by flag. When loading, unmodified
+     * pages are full, base or parent pages that did not need to be read */
+    uint64_t no_pages = 0;
+    uint64_t zero_pages = 0;
+    uint64_t base_pages = 0;
+    uint64_t full_pages = 0;
+    uint64_t parent_pages = 0;
+    uint64_t unmodified_pages = 0;
+
+    /* Size of the written savestate, in bytes */
+    uint64_t size = 0;
+};
+
+#endif
@@ -175,6 +175,25 @@ struct SharedConfig {
     /* Storing savestates in RAM */
     bool savestates_in_ram = false;
 
+    /* Compressing memory pages of savestates */
+    bool savestates_compression = false;
+
+    /* Storing each distinct memory page once for all savestates in RAM */
+    bool savestates_deduplication = false;
+
+    /* Writing savestates on disk in background after the game resumes */
+    bool savestates_async = false;
+
+    /* Loading pages of savestates on first access */
+    bool savestates_lazy = false;
+
+    /* Maximum length of delta chains of savestates in RAM, after which the
+     * last savestate is compacted into a keyframe, or 0 to disable chains */
+    int savestates_chain_length = 0;
+
+    /* Number of threads used to write a savestate */
+    int savestate_threads = 1;
+
     /* Saving a backtrack savestate each time a thread is created/destroyed */
     bool backtrack_savestate = true;
 
@@ -131,12 +131,31 @@ enum {
      */
     MSGN_LOADSTATE,
 
+    /*
+     * Ask the game to drop a savestate
+     * Argument: none
+     */
+    MSGN_DROP_STATE,
+
     /*
      * Tells the program that the loading succeeded
      * Argument: none
      */
     MSGB_LOADING_SUCCEEDED,
 
+    /*
+     * Tells the program that a savestate written in background is now
+     * entirely on disk
+     * Argument: int (savestate index)
+     */
+    MSGB_SAVESTATE_DURABLE,
+
+    /*
+     * Send statistics of the last savestate or state loading
+     * Argument: SavestateStats
+     */
+    MSGB_SAVESTATE_STATS,
+
     /*
      * Send to the game the path of the savestate
      * Argument: size_t (string length) then char[len]
@@ -0,0 +1,112 @@
+// Benchmark of the page scanning functions used when savestating.
+// Usage: ./pagebench [size in MB]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "../src/library/Utils.h"
+
+using namespace libtas;
+
+static const size_t page_size = 4096;
+
+// Previous implementation of Utils::isZeroPage, used as a reference
+static bool isZeroPageReference(void *addr)
+{
+    long long *buf = (long long *)addr;
+    size_t end = page_size / sizeof(*buf);
+    long long res = 0;
+
+    for (size_t i = 0; i + 7 < end; i += 8) {
+        res = buf[i + 0] | buf[i + 1] | buf[i + 2] | buf[i + 3] |
+        buf[i + 4] | buf[i + 5] | buf[i + 6] | buf[i + 7];
+        if (res != 0) {
+            break;
+        }
+    }
+    return res == 0;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template<typename F>
+static void bench(const char* name, char* buf, size_t size, F func)
+{
+    // Run once to fault the pages in and warm up
+    uint64_t res = 0;
+    for (size_t off = 0; off < size; off += page_size)
+        res += func(buf + off);
+
+    double best = 1e9;
+    for (int run = 0; run < 5; run++) {
+        double start = now();
+        for (size_t off = 0; off < size; off += page_size)
+            res += func(buf + off);
+        double elapsed = now() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    printf("  %-28s %8.2f GB/s  (%llx)\n", name, size / best / 1e9, (unsigned long long)res);
+}
+
+static void benchAll(const char* title, char* buf, size_t size)
+{
+    printf("%s\n", title);
+    bench("isZeroPage (reference)", buf, size, [](char* p) -> uint64_t {
+        return isZeroPageReference(p);
+    });
+    bench("Utils::isZeroPage", buf, size, [](char* p) -> uint64_t {
+        return Utils::isZeroPage(p);
+    });
+    bench("Utils::hashPage", buf, size, [](char* p) -> uint64_t {
+        return Utils::hashPage(p);
+    });
+    bench("Utils::hashPage (zero check)", buf, size, [](char* p) -> uint64_t {
+        bool zero;
+        return Utils::hashPage(p, zero);
+    });
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = 1024;
+    if (argc > 1)
+        size = strtoul(argv[1], nullptr, 10);
+    size *= 1024 * 1024;
+
+    char* buf = static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    // Zero pages must be scanned entirely, this is the worst case
+    memset(buf, 0, size);
+    benchAll("Zero pages:", buf, size);
+
+    // Pages that are zero except for their last byte
+    for (size_t off = page_size - 1; off < size; off += page_size)
+        buf[off] = 1;
+    benchAll("Pages with a non-zero last byte:", buf, size);
+
+    // Random content, the zero check returns early
+    uint64_t x = 88172645463325252ULL;
+    uint64_t* words = reinterpret_cast<uint64_t*>(buf);
+    for (size_t i = 0; i < size / sizeof(uint64_t); i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        words[i] = x;
+    }
+    benchAll("Random pages:", buf, size);
+
+    munmap(buf, size);
+    return 0;
+}